@@ -1,5 +1,22 @@
 ifeq ($(USE_SENSOR_MEDIATION_HAL), true)
 LOCAL_PATH := $(call my-dir)
+
+IIO_CLIENT_SRC_FILES := custom-libiio-client/xml.c \
+                    custom-libiio-client/buffer.c \
+                    custom-libiio-client/context.c \
+                    custom-libiio-client/iiod-client.c \
+                    custom-libiio-client/lock.c \
+                    custom-libiio-client/channel.c \
+                    custom-libiio-client/backend.c \
+                    custom-libiio-client/device.c \
+                    custom-libiio-client/utilities.c \
+                    custom-libiio-client/network.c \
+                    custom-libiio-client/compress.c \
+                    custom-libiio-client/shm.c \
+                    custom-libiio-client/replay.c \
+                    custom-libiio-client/synth.c \
+                    custom-libiio-client/trace.c
+
 include $(CLEAR_VARS)
 
 LOCAL_MODULE := sensors.$(TARGET_BOARD_PLATFORM)
@@ -10,25 +27,107 @@ LOCAL_MODULE_RELATIVE_PATH := hw
 
 LOCAL_CFLAGS := -DLOG_TAG=\"SensorsHal\" -Wall
 
-LOCAL_SRC_FILES := sensor_hal.cpp iio-client.cpp \
-                    custom-libiio-client/xml.c \
-                    custom-libiio-client/buffer.c \
-                    custom-libiio-client/context.c \
-                    custom-libiio-client/iiod-client.c \
-                    custom-libiio-client/lock.c \
-                    custom-libiio-client/channel.c \
-                    custom-libiio-client/backend.c \
-                    custom-libiio-client/device.c \
-                    custom-libiio-client/utilities.c \
-                    custom-libiio-client/network.c
+LOCAL_SRC_FILES := sensor_hal.cpp iio-client.cpp $(IIO_CLIENT_SRC_FILES)
 
 LOCAL_SHARED_LIBRARIES := liblog libc libdl libxml2 libcutils
 LOCAL_HEADER_LIBRARIES += libutils_headers libhardware_headers
 
-LOCAL_CFLAGS += -Wno-unused-variable -Wno-unused-parameter -Wno-unused-function
-
 LOCAL_C_INCLUDES := $(LOCAL_PATH) $(LOCAL_PATH)/custom-libiio-client
 
 include $(BUILD_SHARED_LIBRARY)
 
+# The client library alone, for the tools and tests run on the build host
+# (the executables linking it add -lm, for synth.c)
+include $(CLEAR_VARS)
+LOCAL_MODULE := libiio-client-host
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_SRC_FILES := $(IIO_CLIENT_SRC_FILES)
+LOCAL_CFLAGS := -Wall
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/custom-libiio-client
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/custom-libiio-client
+LOCAL_SHARED_LIBRARIES := libxml2
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+# Time per operation of the client hot paths, one JSON object per line;
+# compared with a previous run given with -b
+include $(CLEAR_VARS)
+LOCAL_MODULE := iio-microbench
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_SRC_FILES := tools/iio-microbench.c
+LOCAL_CFLAGS := -O2 -Wall
+LOCAL_STATIC_LIBRARIES := libiio-client-host
+LOCAL_LDLIBS := -lm
+LOCAL_SHARED_LIBRARIES := libxml2
+include $(BUILD_HOST_EXECUTABLE)
+
+# N network clients polling one server
+include $(CLEAR_VARS)
+LOCAL_MODULE := iio-loadgen
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_SRC_FILES := tools/iio-loadgen.c
+LOCAL_CFLAGS := -Wall
+LOCAL_STATIC_LIBRARIES := libiio-client-host
+LOCAL_LDLIBS := -lm
+LOCAL_SHARED_LIBRARIES := libxml2
+include $(BUILD_HOST_EXECUTABLE)
+
+# Reference producer of the shm: backend
+include $(CLEAR_VARS)
+LOCAL_MODULE := iio-shm-producer
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_SRC_FILES := tools/iio-shm-producer.c
+LOCAL_CFLAGS := -Wall
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/custom-libiio-client
+include $(BUILD_HOST_EXECUTABLE)
+
+# Runs iio-shm-producer and reads its samples back through shm:
+include $(CLEAR_VARS)
+LOCAL_MODULE := iio-shm-test
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_SRC_FILES := tests/iio-shm-test.c
+LOCAL_CFLAGS := -Wall
+LOCAL_STATIC_LIBRARIES := libiio-client-host
+LOCAL_LDLIBS := -lm
+LOCAL_SHARED_LIBRARIES := libxml2
+LOCAL_REQUIRED_MODULES := iio-shm-producer
+include $(BUILD_HOST_EXECUTABLE)
+
+# Round trip of the compressed frames through the encoder and the decoder
+include $(CLEAR_VARS)
+LOCAL_MODULE := iio-compress-test
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_SRC_FILES := tests/iio-compress-test.c
+LOCAL_CFLAGS := -Wall
+LOCAL_STATIC_LIBRARIES := libiio-client-host
+LOCAL_LDLIBS := -lm
+LOCAL_SHARED_LIBRARIES := libxml2
+include $(BUILD_HOST_EXECUTABLE)
+
+# Local stand-in of iiod, with an injectable round-trip time and jitter
+include $(CLEAR_VARS)
+LOCAL_MODULE := iiod-standin
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_SRC_FILES := tools/iiod-standin.c
+LOCAL_CFLAGS := -Wall
+LOCAL_STATIC_LIBRARIES := libiio-client-host
+LOCAL_LDLIBS := -lm
+LOCAL_SHARED_LIBRARIES := libxml2
+include $(BUILD_HOST_EXECUTABLE)
+
+# Events per second, latency, syscalls and CPU of each acquisition mode;
+# tools/hal-bench.sh runs it against iiod-standin. C++20 for iio-coro.h.
+include $(CLEAR_VARS)
+LOCAL_MODULE := iio-hal-bench
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_SRC_FILES := tools/iio-hal-bench.cpp iio-client.cpp
+LOCAL_CFLAGS := -DLOG_TAG=\"SensorsHal\" -Wall
+LOCAL_CPPFLAGS := -std=c++20
+LOCAL_C_INCLUDES := $(LOCAL_PATH) $(LOCAL_PATH)/custom-libiio-client
+LOCAL_STATIC_LIBRARIES := libiio-client-host
+LOCAL_LDLIBS := -lm
+LOCAL_SHARED_LIBRARIES := liblog libcutils libxml2
+LOCAL_HEADER_LIBRARIES := libutils_headers libhardware_headers
+LOCAL_REQUIRED_MODULES := iiod-standin
+include $(BUILD_HOST_EXECUTABLE)
+
 endif
@@ -149,6 +149,50 @@ ssize_t iio_buffer_refill(struct iio_buffer *buffer)
     return read;
 }
 
+static void iio_buffer_refill_done(ssize_t ret, void *d)
+{
+    struct iio_buffer *buffer = d;
+    const struct iio_device *dev = buffer->dev;
+
+    if (ret >= 0) {
+        buffer->data_length = ret;
+        buffer->sample_size = iio_device_get_sample_size_mask(dev,
+                buffer->mask, dev->words);
+    }
+
+    buffer->refill_cb(buffer, ret, buffer->refill_data);
+}
+
+int iio_buffer_refill_async(struct iio_buffer *buffer,
+        void (*cb)(struct iio_buffer *buffer, ssize_t ret, void *d),
+        void *data)
+{
+    const struct iio_device *dev = buffer->dev;
+
+    if (iio_device_is_tx(dev))
+        return -EINVAL;
+    if (buffer->dev_is_high_speed || !dev->ctx->ops->read_async)
+        return -ENOSYS;
+
+    buffer->refill_cb = cb;
+    buffer->refill_data = data;
+
+    return dev->ctx->ops->read_async(dev, buffer->buffer, buffer->length,
+            buffer->mask, dev->words, iio_buffer_refill_done, buffer);
+}
+
+int iio_buffer_subscribe(struct iio_buffer *buffer, unsigned int period_us)
+{
+    const struct iio_device *dev = buffer->dev;
+
+    if (iio_device_is_tx(dev) || !period_us)
+        return -EINVAL;
+    if (buffer->dev_is_high_speed || !dev->ctx->ops->subscribe)
+        return -ENOSYS;
+
+    return dev->ctx->ops->subscribe(dev, buffer->length, period_us);
+}
+
 ssize_t iio_buffer_push(struct iio_buffer *buffer)
 {
     const struct iio_device *dev = buffer->dev;
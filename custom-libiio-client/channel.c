@@ -339,15 +339,48 @@ const char * iio_channel_get_attr(const struct iio_channel *chn,
 const char * iio_channel_find_attr(const struct iio_channel *chn,
         const char *name)
 {
-    unsigned int i;
-    for (i = 0; i < chn->nb_attrs; i++) {
-        const char *attr = chn->attrs[i].name;
+    unsigned int i, slot;
+    uint32_t hash;
+    int ret;
+
+    if (!chn->attrs_index.slots) {
+        for (i = 0; i < chn->nb_attrs; i++) {
+            const char *attr = chn->attrs[i].name;
+            if (!strcmp(attr, name))
+                return attr;
+        }
+        return NULL;
+    }
+
+    hash = iio_hash_str(name);
+    slot = hash;
+
+    while ((ret = iio_hash_index_next(&chn->attrs_index,
+                    hash, &slot)) >= 0) {
+        const char *attr = chn->attrs[ret].name;
         if (!strcmp(attr, name))
             return attr;
     }
     return NULL;
 }
 
+int iio_channel_build_index(struct iio_channel *chn)
+{
+    unsigned int i;
+    int ret;
+
+    if (!chn->nb_attrs)
+        return 0;
+
+    ret = iio_hash_index_init(&chn->attrs_index, chn->nb_attrs);
+    if (ret < 0)
+        return ret;
+
+    for (i = 0; i < chn->nb_attrs; i++)
+        iio_hash_index_add(&chn->attrs_index, chn->attrs[i].name, i);
+    return 0;
+}
+
 ssize_t iio_channel_attr_read(const struct iio_channel *chn,
         const char *attr, char *dst, size_t len)
 {
@@ -358,6 +391,23 @@ ssize_t iio_channel_attr_read(const struct iio_channel *chn,
         return -ENOSYS;
 }
 
+int iio_channel_attr_read_async(const struct iio_channel *chn,
+        const char *attr, char *dst, size_t len,
+        void (*cb)(ssize_t ret, void *d), void *data)
+{
+    if (chn->dev->ctx->ops->read_attr_async)
+        return chn->dev->ctx->ops->read_attr_async(chn->dev, chn, attr,
+                IIO_ATTR_TYPE_DEVICE, dst, len, cb, data);
+    else
+        return -ENOSYS;
+}
+
+struct iio_attr_handle * iio_channel_attr_prepare(
+        const struct iio_channel *chn, const char *attr)
+{
+    return iio_attr_handle_create(chn->dev, chn, attr, IIO_ATTR_TYPE_DEVICE);
+}
+
 ssize_t iio_channel_attr_write_raw(const struct iio_channel *chn,
         const char *attr, const void *src, size_t len)
 {
@@ -374,6 +424,17 @@ ssize_t iio_channel_attr_write(const struct iio_channel *chn,
     return iio_channel_attr_write_raw(chn, attr, src, strlen(src) + 1);
 }
 
+int iio_channel_attr_write_async(const struct iio_channel *chn,
+        const char *attr, const char *src,
+        void (*cb)(ssize_t ret, void *d), void *data)
+{
+    if (chn->dev->ctx->ops->write_attr_async)
+        return chn->dev->ctx->ops->write_attr_async(chn->dev, chn, attr,
+                IIO_ATTR_TYPE_DEVICE, src, strlen(src) + 1, cb, data);
+    else
+        return -ENOSYS;
+}
+
 void iio_channel_set_data(struct iio_channel *chn, void *data)
 {
     chn->userdata = data;
@@ -416,6 +477,8 @@ void iio_channel_disable(struct iio_channel *chn)
 void free_channel(struct iio_channel *chn)
 {
     size_t i;
+
+    iio_hash_index_free(&chn->attrs_index);
     for (i = 0; i < chn->nb_attrs; i++) {
         free(chn->attrs[i].name);
         free(chn->attrs[i].filename);
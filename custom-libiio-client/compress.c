@@ -0,0 +1,303 @@
+/*
+ * libiio - Library for interfacing industrial I/O (IIO) devices
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "compress.h"
+#include "iio-private.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LZ4_MIN_MATCH 4
+
+/* Constraints of the LZ4 block format on the end of a block */
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MF_LIMIT 12
+
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_BITS 12
+
+/* Reads the extra length bytes following a 15 in a token nibble */
+static int lz4_read_length(const uint8_t **ip, const uint8_t *end,
+        size_t *len)
+{
+    uint8_t b;
+
+    do {
+        if (*ip == end)
+            return -EIO;
+
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+
+    return 0;
+}
+
+/* Decodes a raw LZ4 block; returns the decoded length */
+static ssize_t lz4_decode_block(const uint8_t *ip, size_t len,
+        uint8_t *dst, size_t dst_len)
+{
+    const uint8_t *end = ip + len;
+    uint8_t *op = dst, *op_end = dst + dst_len;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+        size_t lit = token >> 4, match = token & 0xf, offset;
+        const uint8_t *ref;
+
+        if (lit == 15 && lz4_read_length(&ip, end, &lit) < 0)
+            return -EIO;
+        if (lit > (size_t) (end - ip) || lit > (size_t) (op_end - op))
+            return -EIO;
+
+        memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+
+        /* The last sequence has no match */
+        if (ip == end)
+            break;
+
+        if (end - ip < 2)
+            return -EIO;
+
+        offset = (size_t) ip[0] | (size_t) ip[1] << 8;
+        ip += 2;
+        if (!offset || offset > (size_t) (op - dst))
+            return -EIO;
+
+        if (match == 15 && lz4_read_length(&ip, end, &match) < 0)
+            return -EIO;
+        match += LZ4_MIN_MATCH;
+        if (match > (size_t) (op_end - op))
+            return -EIO;
+
+        ref = op - offset;
+        if (offset >= match) {
+            memcpy(op, ref, match);
+            op += match;
+        } else {
+            /* Overlapping copy: repeats the last 'offset' bytes */
+            while (match--)
+                *op++ = *ref++;
+        }
+    }
+
+    return (ssize_t) (op - dst);
+}
+
+static void delta_decode(uint8_t *buf, size_t len, size_t stride)
+{
+    size_t i;
+
+    for (i = stride; i < len; i++)
+        buf[i] += buf[i - stride];
+}
+
+static void delta_encode(uint8_t *dst, const uint8_t *src, size_t len,
+        size_t stride)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        dst[i] = i < stride ? src[i] : (uint8_t) (src[i] - src[i - stride]);
+}
+
+static uint32_t lz4_hash(const uint8_t *ptr)
+{
+    uint32_t value;
+
+    memcpy(&value, ptr, sizeof(value));
+    return (value * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+static uint8_t * lz4_write_length(uint8_t *op, size_t len)
+{
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (uint8_t) len;
+    return op;
+}
+
+/* Writes literals followed by a match, or by nothing if 'offset' is 0 */
+static uint8_t * lz4_write_sequence(uint8_t *op, const uint8_t *lit,
+        size_t lit_len, size_t offset, size_t match_len)
+{
+    uint8_t *token = op++;
+
+    *token = (uint8_t) ((lit_len < 15 ? lit_len : 15) << 4);
+    if (lit_len >= 15)
+        op = lz4_write_length(op, lit_len - 15);
+
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+
+    if (!offset)
+        return op;
+
+    *op++ = (uint8_t) offset;
+    *op++ = (uint8_t) (offset >> 8);
+
+    match_len -= LZ4_MIN_MATCH;
+    *token |= (uint8_t) (match_len < 15 ? match_len : 15);
+    if (match_len >= 15)
+        op = lz4_write_length(op, match_len - 15);
+
+    return op;
+}
+
+/* Encodes a raw LZ4 block, greedily; returns its length, which is at most
+ * IIO_FRAME_MAX_LEN(len) - IIO_FRAME_HEADER_LEN */
+static size_t lz4_encode_block(const uint8_t *src, size_t len, uint8_t *dst)
+{
+    uint32_t table[1 << LZ4_HASH_BITS];
+    const uint8_t *ip = src, *anchor = src, *end = src + len;
+    const uint8_t *mf_limit = len > LZ4_MF_LIMIT ? end - LZ4_MF_LIMIT : src;
+    uint8_t *op = dst;
+
+    /* Empty entries point to the start, checked like any other match */
+    memset(table, 0, sizeof(table));
+
+    while (ip < mf_limit) {
+        uint32_t hash = lz4_hash(ip);
+        const uint8_t *ref = src + table[hash], *match_end;
+
+        table[hash] = (uint32_t) (ip - src);
+
+        if (ref >= ip || ip - ref > LZ4_MAX_OFFSET ||
+                memcmp(ref, ip, LZ4_MIN_MATCH)) {
+            ip++;
+            continue;
+        }
+
+        match_end = ip + LZ4_MIN_MATCH;
+        while (match_end < end - LZ4_LAST_LITERALS &&
+                *match_end == ref[match_end - ip])
+            match_end++;
+
+        op = lz4_write_sequence(op, anchor, (size_t) (ip - anchor),
+                (size_t) (ip - ref), (size_t) (match_end - ip));
+        ip = anchor = match_end;
+    }
+
+    op = lz4_write_sequence(op, anchor, (size_t) (end - anchor), 0, 0);
+    return (size_t) (op - dst);
+}
+
+ssize_t iio_frame_encode(const void *src, size_t len,
+        void *dst, size_t dst_len, size_t stride)
+{
+    uint8_t *ptr = dst, *filtered = NULL;
+    const uint8_t *input = src;
+    size_t body;
+
+    if (len > UINT32_MAX || stride > UINT16_MAX ||
+            dst_len < IIO_FRAME_MAX_LEN(len))
+        return -EINVAL;
+
+    if (stride && len) {
+        filtered = malloc(len);
+        if (!filtered)
+            return -ENOMEM;
+
+        delta_encode(filtered, src, len, stride);
+        input = filtered;
+    }
+
+    ptr[4] = IIO_FRAME_LZ4;
+    body = lz4_encode_block(input, len, ptr + IIO_FRAME_HEADER_LEN);
+    if (body >= len) {
+        ptr[4] = IIO_FRAME_STORED;
+        memcpy(ptr + IIO_FRAME_HEADER_LEN, input, len);
+        body = len;
+    }
+
+    ptr[0] = (uint8_t) len;
+    ptr[1] = (uint8_t) (len >> 8);
+    ptr[2] = (uint8_t) (len >> 16);
+    ptr[3] = (uint8_t) (len >> 24);
+    ptr[5] = stride ? IIO_FRAME_DELTA : IIO_FRAME_NO_FILTER;
+    ptr[6] = (uint8_t) stride;
+    ptr[7] = (uint8_t) (stride >> 8);
+
+    free(filtered);
+    return (ssize_t) (IIO_FRAME_HEADER_LEN + body);
+}
+
+ssize_t iio_frame_decode(const void *src, size_t len,
+        void *dst, size_t dst_len, struct iio_compression_stats *stats)
+{
+    const uint8_t *ptr = src;
+    struct iio_frame_header hdr;
+    uint64_t start = stats ? iio_time_ns() : 0;
+    ssize_t ret;
+
+    if (len < IIO_FRAME_HEADER_LEN)
+        return -EIO;
+
+    hdr.raw_len = iio_frame_get_raw_len(ptr);
+    hdr.method = ptr[4];
+    hdr.filter = ptr[5];
+    hdr.stride = (uint16_t) (ptr[6] | ptr[7] << 8);
+
+    if (hdr.raw_len > dst_len)
+        return -EIO;
+
+    ptr += IIO_FRAME_HEADER_LEN;
+    len -= IIO_FRAME_HEADER_LEN;
+
+    switch (hdr.method) {
+    case IIO_FRAME_STORED:
+        if (len != hdr.raw_len)
+            return -EIO;
+        memcpy(dst, ptr, len);
+        ret = (ssize_t) len;
+        break;
+    case IIO_FRAME_LZ4:
+        ret = lz4_decode_block(ptr, len, dst, hdr.raw_len);
+        if (ret != (ssize_t) hdr.raw_len)
+            return -EIO;
+        break;
+    default:
+        return -EIO;
+    }
+
+    switch (hdr.filter) {
+    case IIO_FRAME_NO_FILTER:
+        break;
+    case IIO_FRAME_DELTA:
+        if (!hdr.stride)
+            return -EIO;
+        delta_decode(dst, hdr.raw_len, hdr.stride);
+        break;
+    default:
+        return -EIO;
+    }
+
+    if (stats) {
+        __atomic_fetch_add(&stats->frames, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats->wire_bytes,
+                len + IIO_FRAME_HEADER_LEN, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats->raw_bytes, hdr.raw_len,
+                __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats->decode_ns, iio_time_ns() - start,
+                __ATOMIC_RELAXED);
+    }
+
+    return ret;
+}
@@ -0,0 +1,98 @@
+/*
+ * libiio - Library for interfacing industrial I/O (IIO) devices
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+/*
+ * Compressed payloads, sent by the IIO Daemon after a COMPRESS command.
+ *
+ * Each payload (the XML of PRINT, each chunk of READBUF) becomes a frame,
+ * whose length is the one announced by the integer preceding it. A frame
+ * starts with an iio_frame_header, all its fields in little-endian order,
+ * followed by the body:
+ *
+ *  - IIO_FRAME_STORED: the payload itself, for data that doesn't compress;
+ *  - IIO_FRAME_LZ4: the payload as a single LZ4 block (no LZ4 frame header).
+ *
+ * With the IIO_FRAME_DELTA filter, the body holds the bytewise difference
+ * between each byte of the payload and the one 'stride' bytes before it,
+ * modulo 256. With 'stride' being the sample size, the slowly changing
+ * samples of a sensor turn into runs of small values, which compress much
+ * better. The server picks the method and the filter for each frame.
+ */
+
+#ifndef _IIO_COMPRESS_H
+#define _IIO_COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define IIO_FRAME_HEADER_LEN 8
+
+enum iio_frame_method {
+    IIO_FRAME_STORED = 0,
+    IIO_FRAME_LZ4 = 1,
+};
+
+enum iio_frame_filter {
+    IIO_FRAME_NO_FILTER = 0,
+    IIO_FRAME_DELTA = 1,
+};
+
+struct iio_frame_header {
+    uint32_t raw_len;   /* Length of the payload once decoded */
+    uint8_t method;
+    uint8_t filter;
+    uint16_t stride;
+};
+
+/* Largest frame the server may send for a payload of 'raw' bytes */
+#define IIO_FRAME_MAX_LEN(raw) \
+    (IIO_FRAME_HEADER_LEN + (raw) + (raw) / 255 + 16)
+
+/* Largest payload a frame of 'wire' bytes may decode to: each byte of an
+ * LZ4 match length adds at most 255 bytes */
+#define IIO_FRAME_MAX_RAW_LEN(wire) ((uint64_t) (wire) * 255)
+
+static inline uint32_t iio_frame_get_raw_len(const void *frame)
+{
+    const uint8_t *ptr = frame;
+
+    return (uint32_t) ptr[0] | (uint32_t) ptr[1] << 8 |
+        (uint32_t) ptr[2] << 16 | (uint32_t) ptr[3] << 24;
+}
+
+struct iio_compression_stats;
+
+/*
+ * Decodes the frame of 'len' bytes at 'src' into 'dst', which can hold up
+ * to 'dst_len' bytes, and accounts for it in 'stats' if not NULL.
+ * Returns the length of the decoded payload, or -EIO if the frame is
+ * malformed or doesn't fit.
+ */
+ssize_t iio_frame_decode(const void *src, size_t len,
+        void *dst, size_t dst_len, struct iio_compression_stats *stats);
+
+/*
+ * Encodes the payload of 'len' bytes at 'src' as a frame into 'dst', which
+ * must hold IIO_FRAME_MAX_LEN(len) bytes, as the server does. A non-zero
+ * 'stride' applies the IIO_FRAME_DELTA filter. The payload is stored as is
+ * when LZ4 doesn't make it smaller. Returns the length of the frame.
+ */
+ssize_t iio_frame_encode(const void *src, size_t len,
+        void *dst, size_t dst_len, size_t stride);
+
+#endif /* _IIO_COMPRESS_H */
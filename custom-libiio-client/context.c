@@ -29,7 +29,7 @@
 #define NETWORK_BACKEND 1
 #endif
 
-static const char xml_header[] = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+const char iio_xml_header[] = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
 "<!DOCTYPE context ["
 "<!ELEMENT context (device | context-attribute)*>"
 "<!ELEMENT context-attribute EMPTY>"
@@ -56,7 +56,7 @@ char * iio_context_create_xml(const struct iio_context *ctx)
     char *str, *ptr, **devices = NULL;
     unsigned int i;
 
-    len = strlen(ctx->name) + sizeof(xml_header) - 1 +
+    len = strlen(ctx->name) + sizeof(iio_xml_header) - 1 +
         sizeof("<context name=\"\" ></context>");
     if (ctx->description)
         len += strlen(ctx->description) +
@@ -97,10 +97,10 @@ char * iio_context_create_xml(const struct iio_context *ctx)
     if (ctx->description) {
         iio_snprintf(str, len, "%s<context name=\"%s\" "
                 "description=\"%s\" >",
-                xml_header, ctx->name, ctx->description);
+                iio_xml_header, ctx->name, ctx->description);
     } else {
         iio_snprintf(str, len, "%s<context name=\"%s\" >",
-                xml_header, ctx->name);
+                iio_xml_header, ctx->name);
     }
 
     ptr = strrchr(str, '\0');
@@ -132,7 +132,26 @@ err_free_devices_len:
 
 const char * iio_context_get_xml(const struct iio_context *ctx)
 {
-    return ctx->xml;
+    char *xml, *expected = NULL;
+
+    /* The XML string is only generated the first time it is requested */
+    xml = __atomic_load_n(&ctx->xml, __ATOMIC_ACQUIRE);
+    if (xml)
+        return xml;
+
+    xml = iio_context_create_xml(ctx);
+    if (!xml)
+        return NULL;
+
+    /* Another thread may have generated it concurrently */
+    if (!__atomic_compare_exchange_n(&((struct iio_context *) ctx)->xml,
+                &expected, xml, false,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free(xml);
+        xml = expected;
+    }
+
+    return xml;
 }
 
 const char * iio_context_get_name(const struct iio_context *ctx)
@@ -151,6 +170,9 @@ const char * iio_context_get_description(const struct iio_context *ctx)
 void iio_context_destroy(struct iio_context *ctx)
 {
     unsigned int i;
+    bool last_ref = !ctx->meta_refs ||
+        !__atomic_sub_fetch(ctx->meta_refs, 1, __ATOMIC_ACQ_REL);
+
     if (ctx->ops->shutdown)
         ctx->ops->shutdown(ctx);
 
@@ -162,10 +184,18 @@ void iio_context_destroy(struct iio_context *ctx)
         free(ctx->attrs);
         free(ctx->values);
     }
-    for (i = 0; i < ctx->nb_devices; i++)
-        free_device(ctx->devices[i]);
+    for (i = 0; i < ctx->nb_devices; i++) {
+        if (last_ref)
+            free_device(ctx->devices[i]);
+        else
+            free_device_clone(ctx->devices[i]);
+    }
     if (ctx->nb_devices)
         free(ctx->devices);
+    if (last_ref) {
+        iio_hash_index_free(&ctx->devices_index);
+        free(ctx->meta_refs);
+    }
     if (ctx->xml)
         free(ctx->xml);
     if (ctx->description)
@@ -187,14 +217,35 @@ struct iio_device * iio_context_get_device(const struct iio_context *ctx,
         return ctx->devices[index];
 }
 
+static bool device_matches(const struct iio_device *dev, const char *name)
+{
+    return !strcmp(dev->id, name) ||
+        (dev->name && !strcmp(dev->name, name));
+}
+
 struct iio_device * iio_context_find_device(const struct iio_context *ctx,
         const char *name)
 {
-    unsigned int i;
-    for (i = 0; i < ctx->nb_devices; i++) {
-        struct iio_device *dev = ctx->devices[i];
-        if (!strcmp(dev->id, name) ||
-                (dev->name && !strcmp(dev->name, name)))
+    unsigned int i, slot;
+    uint32_t hash;
+    int ret;
+
+    if (!ctx->devices_index.slots) {
+        for (i = 0; i < ctx->nb_devices; i++) {
+            struct iio_device *dev = ctx->devices[i];
+            if (device_matches(dev, name))
+                return dev;
+        }
+        return NULL;
+    }
+
+    hash = iio_hash_str(name);
+    slot = hash;
+
+    while ((ret = iio_hash_index_next(&ctx->devices_index,
+                    hash, &slot)) >= 0) {
+        struct iio_device *dev = ctx->devices[ret];
+        if (device_matches(dev, name))
             return dev;
     }
     return NULL;
@@ -231,20 +282,136 @@ static void reorder_channels(struct iio_device *dev)
         dev->channels[i]->number = i;
 }
 
+static int build_devices_index(struct iio_context *ctx)
+{
+    unsigned int i;
+    int ret;
+
+    if (!ctx->nb_devices)
+        return 0;
+
+    /* Both the ID and the name of each device are indexed */
+    ret = iio_hash_index_init(&ctx->devices_index, 2 * ctx->nb_devices);
+    if (ret < 0)
+        return ret;
+
+    for (i = 0; i < ctx->nb_devices; i++) {
+        struct iio_device *dev = ctx->devices[i];
+
+        iio_hash_index_add(&ctx->devices_index, dev->id, i);
+        if (dev->name)
+            iio_hash_index_add(&ctx->devices_index, dev->name, i);
+
+        ret = iio_device_build_index(dev);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 int iio_context_init(struct iio_context *ctx)
 {
     unsigned int i;
+    int ret;
 
     for (i = 0; i < ctx->nb_devices; i++)
         reorder_channels(ctx->devices[i]);
 
-    if (!ctx->xml) {
-        ctx->xml = iio_context_create_xml(ctx);
-        if (!ctx->xml)
-            return -ENOMEM;
+    ret = build_devices_index(ctx);
+    if (ret < 0)
+        goto err_free_index;
+
+    ctx->meta_refs = malloc(sizeof(*ctx->meta_refs));
+    if (!ctx->meta_refs) {
+        ret = -ENOMEM;
+        goto err_free_index;
     }
 
+    *ctx->meta_refs = 1;
+
+    /* Unless provided by the backend, the XML string is only generated
+     * the first time iio_context_get_xml() is called */
     return 0;
+
+err_free_index:
+    /* The devices' own indexes are released along with the devices */
+    iio_hash_index_free(&ctx->devices_index);
+    return ret;
+}
+
+/* Creates a new context sharing the metadata of the devices and channels of
+ * the given context, without going through the XML again. The backend is
+ * responsible for setting up the pdata of the new context and devices. */
+struct iio_context * iio_context_clone_metadata(const struct iio_context *ctx)
+{
+    struct iio_context *cpy;
+    unsigned int i;
+    int ret = -ENOMEM;
+
+    if (!ctx->meta_refs) {
+        ret = -EINVAL;
+        goto err_set_errno;
+    }
+
+    cpy = zalloc(sizeof(*cpy));
+    if (!cpy)
+        goto err_set_errno;
+
+    cpy->name = ctx->name;
+    cpy->ops = ctx->ops;
+
+    if (ctx->description) {
+        cpy->description = iio_strdup(ctx->description);
+        if (!cpy->description)
+            goto err_free_ctx;
+    }
+
+    for (i = 0; i < ctx->nb_attrs; i++) {
+        ret = iio_context_add_attr(cpy, ctx->attrs[i], ctx->values[i]);
+        if (ret < 0)
+            goto err_free_ctx;
+    }
+
+    if (ctx->nb_devices) {
+        cpy->devices = calloc(ctx->nb_devices, sizeof(*cpy->devices));
+        if (!cpy->devices) {
+            ret = -ENOMEM;
+            goto err_free_ctx;
+        }
+    }
+
+    for (; cpy->nb_devices < ctx->nb_devices; cpy->nb_devices++) {
+        struct iio_device *dev = iio_device_clone(
+                ctx->devices[cpy->nb_devices], cpy);
+        if (!dev) {
+            ret = -ENOMEM;
+            goto err_free_ctx;
+        }
+
+        cpy->devices[cpy->nb_devices] = dev;
+    }
+
+    cpy->devices_index = ctx->devices_index;
+    cpy->meta_refs = ctx->meta_refs;
+    __atomic_add_fetch(cpy->meta_refs, 1, __ATOMIC_RELAXED);
+    return cpy;
+
+err_free_ctx:
+    for (i = 0; i < cpy->nb_devices; i++)
+        free_device_clone(cpy->devices[i]);
+    free(cpy->devices);
+    for (i = 0; i < cpy->nb_attrs; i++) {
+        free(cpy->attrs[i]);
+        free(cpy->values[i]);
+    }
+    free(cpy->attrs);
+    free(cpy->values);
+    free(cpy->description);
+    free(cpy);
+err_set_errno:
+    errno = -ret;
+    return NULL;
 }
 
 int iio_context_get_version(const struct iio_context *ctx,
@@ -265,6 +432,62 @@ int iio_context_set_timeout(struct iio_context *ctx, unsigned int timeout)
         return -ENOSYS;
 }
 
+int iio_context_set_max_connections(struct iio_context *ctx, unsigned int nb)
+{
+    if (ctx->ops->set_max_connections)
+        return ctx->ops->set_max_connections(ctx, nb);
+    else
+        return -ENOSYS;
+}
+
+int iio_context_get_async_fd(const struct iio_context *ctx)
+{
+    if (ctx->ops->get_async_fd)
+        return ctx->ops->get_async_fd(ctx);
+    else
+        return -ENOSYS;
+}
+
+int iio_context_process_async(struct iio_context *ctx, int timeout_ms)
+{
+    if (ctx->ops->process_async)
+        return ctx->ops->process_async(ctx, timeout_ms);
+    else
+        return -ENOSYS;
+}
+
+int iio_context_cancel_async(struct iio_context *ctx)
+{
+    if (ctx->ops->cancel_async)
+        return ctx->ops->cancel_async(ctx);
+    else
+        return -ENOSYS;
+}
+
+int iio_context_get_compression_stats(const struct iio_context *ctx,
+        struct iio_compression_stats *stats)
+{
+    if (ctx->ops->get_compression_stats)
+        return ctx->ops->get_compression_stats(ctx, stats);
+    else
+        return -ENOSYS;
+}
+
+int iio_context_get_stats(const struct iio_context *ctx,
+        struct iio_context_stats *stats)
+{
+    if (ctx->ops->get_stats)
+        return ctx->ops->get_stats(ctx, stats);
+    else
+        return -ENOSYS;
+}
+
+void iio_context_get_profile(const struct iio_context *ctx,
+        struct iio_context_profile *profile)
+{
+    *profile = ctx->profile;
+}
+
 struct iio_context * iio_context_clone(const struct iio_context *ctx)
 {
     if (ctx->ops->clone) {
@@ -292,6 +515,31 @@ struct iio_context * iio_create_context_from_uri(const char *uri)
         return iio_create_network_context(uri+3);
 #endif
 
+#ifdef WITH_NETWORK_VSOCK
+    if (strncmp(uri, "vsock:", sizeof("vsock:") - 1) == 0)
+        return network_create_vsock_context(uri + sizeof("vsock:") - 1);
+#endif
+
+#ifdef WITH_NETWORK_UNIX
+    if (strncmp(uri, "unix:", sizeof("unix:") - 1) == 0)
+        return network_create_unix_context(uri + sizeof("unix:") - 1);
+#endif
+
+#ifdef WITH_SHM_BACKEND
+    if (strncmp(uri, "shm:", sizeof("shm:") - 1) == 0)
+        return shm_create_context(uri + sizeof("shm:") - 1);
+#endif
+
+#ifdef WITH_REPLAY_BACKEND
+    if (strncmp(uri, "replay:", sizeof("replay:") - 1) == 0)
+        return replay_create_context(uri + sizeof("replay:") - 1);
+#endif
+
+#ifdef WITH_SYNTH_BACKEND
+    if (strncmp(uri, "synth:", sizeof("synth:") - 1) == 0)
+        return synth_create_context(uri + sizeof("synth:") - 1);
+#endif
+
 #ifdef WITH_USB_BACKEND
     if (strncmp(uri, "usb:", sizeof("usb:") - 1) == 0)
         return usb_create_context_from_uri(uri);
@@ -93,4 +93,11 @@
 #define ERROR(...) do { } while (0)
 #endif
 
+/* Events of the hot path, recorded with iio_trace() by builds WITH_TRACE */
+#ifdef WITH_TRACE
+#define IIO_TRACE(event, arg) iio_trace(event, (uint32_t) (arg))
+#else
+#define IIO_TRACE(event, arg) do { } while (0)
+#endif
+
 #endif
@@ -246,17 +246,39 @@ struct iio_channel * iio_device_get_channel(const struct iio_device *dev,
         return dev->channels[index];
 }
 
+static bool channel_matches(const struct iio_channel *chn,
+        const char *name, bool output)
+{
+    if (iio_channel_is_output(chn) != output)
+        return false;
+
+    return !strcmp(chn->id, name) ||
+        (chn->name && !strcmp(chn->name, name));
+}
+
 struct iio_channel * iio_device_find_channel(const struct iio_device *dev,
         const char *name, bool output)
 {
-    unsigned int i;
-    for (i = 0; i < dev->nb_channels; i++) {
-        struct iio_channel *chn = dev->channels[i];
-        if (iio_channel_is_output(chn) != output)
-            continue;
+    unsigned int i, slot;
+    uint32_t hash;
+    int ret;
 
-        if (!strcmp(chn->id, name) ||
-                (chn->name && !strcmp(chn->name, name)))
+    if (!dev->channels_index.slots) {
+        for (i = 0; i < dev->nb_channels; i++) {
+            struct iio_channel *chn = dev->channels[i];
+            if (channel_matches(chn, name, output))
+                return chn;
+        }
+        return NULL;
+    }
+
+    hash = iio_hash_str(name);
+    slot = hash;
+
+    while ((ret = iio_hash_index_next(&dev->channels_index,
+                    hash, &slot)) >= 0) {
+        struct iio_channel *chn = dev->channels[ret];
+        if (channel_matches(chn, name, output))
             return chn;
     }
     return NULL;
@@ -276,18 +298,37 @@ const char * iio_device_get_attr(const struct iio_device *dev,
         return dev->attrs[index];
 }
 
-const char * iio_device_find_attr(const struct iio_device *dev,
-        const char *name)
+static const char * find_attr(char * const *attrs, unsigned int nb_attrs,
+        const struct iio_hash_index *idx, const char *name)
 {
-    unsigned int i;
-    for (i = 0; i < dev->nb_attrs; i++) {
-        const char *attr = dev->attrs[i];
-        if (!strcmp(attr, name))
-            return attr;
+    unsigned int i, slot;
+    uint32_t hash;
+    int ret;
+
+    if (!idx->slots) {
+        for (i = 0; i < nb_attrs; i++) {
+            if (!strcmp(attrs[i], name))
+                return attrs[i];
+        }
+        return NULL;
+    }
+
+    hash = iio_hash_str(name);
+    slot = hash;
+
+    while ((ret = iio_hash_index_next(idx, hash, &slot)) >= 0) {
+        if (!strcmp(attrs[ret], name))
+            return attrs[ret];
     }
     return NULL;
 }
 
+const char * iio_device_find_attr(const struct iio_device *dev,
+        const char *name)
+{
+    return find_attr(dev->attrs, dev->nb_attrs, &dev->attrs_index, name);
+}
+
 unsigned int iio_device_get_buffer_attrs_count(const struct iio_device *dev)
 {
     return dev->nb_buffer_attrs;
@@ -305,25 +346,15 @@ const char * iio_device_get_buffer_attr(const struct iio_device *dev,
 const char * iio_device_find_buffer_attr(const struct iio_device *dev,
         const char *name)
 {
-    unsigned int i;
-    for (i = 0; i < dev->nb_buffer_attrs; i++) {
-        const char *attr = dev->buffer_attrs[i];
-        if (!strcmp(attr, name))
-            return attr;
-    }
-    return NULL;
+    return find_attr(dev->buffer_attrs, dev->nb_buffer_attrs,
+            &dev->buffer_attrs_index, name);
 }
 
 const char * iio_device_find_debug_attr(const struct iio_device *dev,
         const char *name)
 {
-    unsigned int i;
-    for (i = 0; i < dev->nb_debug_attrs; i++) {
-        const char *attr = dev->debug_attrs[i];
-        if (!strcmp(attr, name))
-            return attr;
-    }
-    return NULL;
+    return find_attr(dev->debug_attrs, dev->nb_debug_attrs,
+            &dev->debug_attrs_index, name);
 }
 
 bool iio_device_is_tx(const struct iio_device *dev)
@@ -408,6 +439,96 @@ ssize_t iio_device_attr_read(const struct iio_device *dev,
         return -ENOSYS;
 }
 
+int iio_device_attr_read_async(const struct iio_device *dev,
+        const char *attr, char *dst, size_t len,
+        void (*cb)(ssize_t ret, void *d), void *data)
+{
+    if (dev->ctx->ops->read_attr_async)
+        return dev->ctx->ops->read_attr_async(dev, NULL, attr,
+                IIO_ATTR_TYPE_DEVICE, dst, len, cb, data);
+    else
+        return -ENOSYS;
+}
+
+struct iio_attr_handle * iio_attr_handle_create(const struct iio_device *dev,
+        const struct iio_channel *chn, const char *attr,
+        enum iio_attr_type type)
+{
+    struct iio_attr_handle *handle;
+    const char *name;
+    int ret;
+
+    if (chn)
+        name = iio_channel_find_attr(chn, attr);
+    else
+        name = iio_device_find_attr(dev, attr);
+    if (!name) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    handle = zalloc(sizeof(*handle));
+    if (!handle) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    handle->dev = dev;
+    handle->chn = chn;
+    handle->attr = name;
+    handle->type = type;
+
+    if (dev->ctx->ops->prepare_attr) {
+        ret = dev->ctx->ops->prepare_attr(handle);
+        if (ret < 0) {
+            free(handle);
+            errno = -ret;
+            return NULL;
+        }
+    }
+
+    return handle;
+}
+
+struct iio_attr_handle * iio_device_attr_prepare(
+        const struct iio_device *dev, const char *attr)
+{
+    return iio_attr_handle_create(dev, NULL, attr, IIO_ATTR_TYPE_DEVICE);
+}
+
+ssize_t iio_attr_handle_read(const struct iio_attr_handle *handle,
+        char *dst, size_t len)
+{
+    const struct iio_backend_ops *ops = handle->dev->ctx->ops;
+
+    if (handle->cmd && ops->read_attr_handle)
+        return ops->read_attr_handle(handle, dst, len);
+    else if (handle->chn)
+        return iio_channel_attr_read(handle->chn, handle->attr, dst, len);
+    else
+        return iio_device_attr_read(handle->dev, handle->attr, dst, len);
+}
+
+int iio_attr_handle_read_async(const struct iio_attr_handle *handle,
+        char *dst, size_t len, void (*cb)(ssize_t ret, void *d), void *data)
+{
+    const struct iio_backend_ops *ops = handle->dev->ctx->ops;
+
+    if (handle->cmd && ops->read_attr_handle_async)
+        return ops->read_attr_handle_async(handle, dst, len, cb, data);
+    else if (ops->read_attr_async)
+        return ops->read_attr_async(handle->dev, handle->chn, handle->attr,
+                handle->type, dst, len, cb, data);
+    else
+        return -ENOSYS;
+}
+
+void iio_attr_handle_destroy(struct iio_attr_handle *handle)
+{
+    free(handle->cmd);
+    free(handle);
+}
+
 ssize_t iio_device_attr_write_raw(const struct iio_device *dev,
         const char *attr, const void *src, size_t len)
 {
@@ -424,6 +545,17 @@ ssize_t iio_device_attr_write(const struct iio_device *dev,
     return iio_device_attr_write_raw(dev, attr, src, strlen(src) + 1);
 }
 
+int iio_device_attr_write_async(const struct iio_device *dev,
+        const char *attr, const char *src,
+        void (*cb)(ssize_t ret, void *d), void *data)
+{
+    if (dev->ctx->ops->write_attr_async)
+        return dev->ctx->ops->write_attr_async(dev, NULL, attr,
+                IIO_ATTR_TYPE_DEVICE, src, strlen(src) + 1, cb, data);
+    else
+        return -ENOSYS;
+}
+
 ssize_t iio_device_buffer_attr_read(const struct iio_device *dev,
         const char *attr, char *dst, size_t len)
 {
@@ -505,9 +637,76 @@ int iio_device_set_trigger(const struct iio_device *dev,
         return -ENOSYS;
 }
 
+static int build_attrs_index(struct iio_hash_index *idx,
+        char * const *attrs, unsigned int nb_attrs)
+{
+    unsigned int i;
+    int ret;
+
+    if (!nb_attrs)
+        return 0;
+
+    ret = iio_hash_index_init(idx, nb_attrs);
+    if (ret < 0)
+        return ret;
+
+    for (i = 0; i < nb_attrs; i++)
+        iio_hash_index_add(idx, attrs[i], i);
+    return 0;
+}
+
+/* Builds the name lookup indexes of the device and of its channels.
+ * Must be called once the channels have been reordered. */
+int iio_device_build_index(struct iio_device *dev)
+{
+    unsigned int i;
+    int ret;
+
+    ret = build_attrs_index(&dev->attrs_index, dev->attrs, dev->nb_attrs);
+    if (ret < 0)
+        return ret;
+
+    ret = build_attrs_index(&dev->buffer_attrs_index,
+            dev->buffer_attrs, dev->nb_buffer_attrs);
+    if (ret < 0)
+        return ret;
+
+    ret = build_attrs_index(&dev->debug_attrs_index,
+            dev->debug_attrs, dev->nb_debug_attrs);
+    if (ret < 0)
+        return ret;
+
+    if (dev->nb_channels) {
+        /* Both the ID and the name of each channel are indexed */
+        ret = iio_hash_index_init(&dev->channels_index,
+                2 * dev->nb_channels);
+        if (ret < 0)
+            return ret;
+    }
+
+    for (i = 0; i < dev->nb_channels; i++) {
+        struct iio_channel *chn = dev->channels[i];
+
+        iio_hash_index_add(&dev->channels_index, chn->id, i);
+        if (chn->name)
+            iio_hash_index_add(&dev->channels_index, chn->name, i);
+
+        ret = iio_channel_build_index(chn);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 void free_device(struct iio_device *dev)
 {
     unsigned int i;
+
+    iio_hash_index_free(&dev->attrs_index);
+    iio_hash_index_free(&dev->buffer_attrs_index);
+    iio_hash_index_free(&dev->debug_attrs_index);
+    iio_hash_index_free(&dev->channels_index);
     for (i = 0; i < dev->nb_attrs; i++)
         free(dev->attrs[i]);
     if (dev->nb_attrs)
@@ -533,6 +732,71 @@ void free_device(struct iio_device *dev)
     free(dev);
 }
 
+/* Returns a copy of the device for a cloned context. The copy and its
+ * channels have their own mask, pdata and userdata, but share the
+ * metadata (names, attributes, formats, indexes) of the original. */
+struct iio_device * iio_device_clone(const struct iio_device *dev,
+        const struct iio_context *ctx)
+{
+    struct iio_device *cpy;
+    unsigned int i;
+
+    cpy = malloc(sizeof(*cpy));
+    if (!cpy)
+        return NULL;
+
+    *cpy = *dev;
+    cpy->ctx = ctx;
+    cpy->pdata = NULL;
+    cpy->userdata = NULL;
+    cpy->mask = NULL;
+    cpy->channels = NULL;
+
+    if (dev->words) {
+        cpy->mask = calloc(dev->words, sizeof(*cpy->mask));
+        if (!cpy->mask)
+            goto err_free_clone;
+    }
+
+    if (dev->nb_channels) {
+        cpy->channels = calloc(dev->nb_channels, sizeof(*cpy->channels));
+        if (!cpy->channels)
+            goto err_free_clone;
+    }
+
+    for (i = 0; i < dev->nb_channels; i++) {
+        struct iio_channel *chn = malloc(sizeof(*chn));
+        if (!chn)
+            goto err_free_clone;
+
+        *chn = *dev->channels[i];
+        chn->dev = cpy;
+        chn->pdata = NULL;
+        chn->userdata = NULL;
+        cpy->channels[i] = chn;
+    }
+
+    return cpy;
+
+err_free_clone:
+    free_device_clone(cpy);
+    return NULL;
+}
+
+/* Frees a device copy made by iio_device_clone(), without the metadata */
+void free_device_clone(struct iio_device *dev)
+{
+    unsigned int i;
+
+    if (dev->channels) {
+        for (i = 0; i < dev->nb_channels; i++)
+            free(dev->channels[i]);
+        free(dev->channels);
+    }
+    free(dev->mask);
+    free(dev);
+}
+
 ssize_t iio_device_get_sample_size_mask(const struct iio_device *dev,
         const uint32_t *mask, size_t words)
 {
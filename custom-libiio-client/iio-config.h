@@ -30,6 +30,17 @@
 
 /* #undef WITH_NETWORK_GET_BUFFER */
 #define WITH_NETWORK_EVENTFD
+#define WITH_NETWORK_EPOLL
+#define WITH_NETWORK_VSOCK
+#define WITH_NETWORK_UNIX
+/* #undef WITH_NETWORK_BINARY */
+#define WITH_NETWORK_COMPRESSION
+#define WITH_SHM_BACKEND
+#define WITH_REPLAY_BACKEND
+#define WITH_SYNTH_BACKEND
+/* #undef WITH_TRACE */
+/* #undef WITH_LOCK_STATS */
+/* #undef WITH_LOCK_SPIN */
 #define HAS_PIPE2
 #define HAS_STRDUP
 #define HAS_STRERROR_R
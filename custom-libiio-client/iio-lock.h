@@ -19,9 +19,26 @@
 #ifndef _IIO_LOCK_H
 #define _IIO_LOCK_H
 
+#include "iio-config.h"
+
 struct iio_mutex;
 
+#if defined(NO_THREADS) || defined(_WIN32)
+/* Contention is only measured with pthreads */
+#undef WITH_LOCK_STATS
+#endif
+
+#ifdef WITH_LOCK_STATS
+/* The statistics are kept per place of creation, see iio_get_lock_stats() */
+#define IIO_LOCK_SITE_(file, line) file ":" #line
+#define IIO_LOCK_SITE(file, line) IIO_LOCK_SITE_(file, line)
+#define iio_mutex_create() \
+    iio_mutex_create_at(IIO_LOCK_SITE(__FILE__, __LINE__))
+
+struct iio_mutex * iio_mutex_create_at(const char *site);
+#else
 struct iio_mutex * iio_mutex_create(void);
+#endif
 void iio_mutex_destroy(struct iio_mutex *lock);
 
 void iio_mutex_lock(struct iio_mutex *lock);
@@ -89,6 +89,47 @@ static inline void *zalloc(size_t size)
     return calloc(1, size);
 }
 
+/* Open-addressing index mapping names to positions in an array.
+ * Slots hold the position + 1, so that a zero means the slot is free. */
+struct iio_hash_slot {
+    uint32_t hash;
+    unsigned int index;
+};
+
+struct iio_hash_index {
+    struct iio_hash_slot *slots;
+    unsigned int mask;
+};
+
+/* 32-bit FNV-1a */
+static inline uint32_t iio_hash_str(const char *str)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*str)
+        hash = (hash ^ (uint8_t) *str++) * 16777619u;
+    return hash;
+}
+
+/* Returns the position stored in the next slot matching 'hash', or -1 when
+ * the probe sequence is exhausted. '*slot' must be initialized to 'hash'.
+ * Entries sharing the same key are returned in insertion order. */
+static inline int iio_hash_index_next(const struct iio_hash_index *idx,
+        uint32_t hash, unsigned int *slot)
+{
+    const struct iio_hash_slot *s;
+
+    for (;;) {
+        s = &idx->slots[*slot & idx->mask];
+        (*slot)++;
+
+        if (!s->index)
+            return -1;
+        if (s->hash == hash)
+            return (int) s->index - 1;
+    }
+}
+
 enum iio_attr_type {
     IIO_ATTR_TYPE_DEVICE = 0,
     IIO_ATTR_TYPE_DEBUG,
@@ -136,6 +177,38 @@ struct iio_backend_ops {
             unsigned int *minor, char git_tag[8]);
 
     int (*set_timeout)(struct iio_context *ctx, unsigned int timeout);
+    int (*subscribe)(const struct iio_device *dev, size_t len,
+            unsigned int period_us);
+    int (*set_max_connections)(struct iio_context *ctx, unsigned int nb);
+
+    int (*prepare_attr)(struct iio_attr_handle *handle);
+    ssize_t (*read_attr_handle)(const struct iio_attr_handle *handle,
+            char *dst, size_t len);
+
+    /* Asynchronous operations: they return immediately, and 'done' is
+     * called from process_async() once the reply has been received. */
+    int (*get_async_fd)(const struct iio_context *ctx);
+    int (*process_async)(const struct iio_context *ctx, int timeout_ms);
+    int (*cancel_async)(const struct iio_context *ctx);
+    int (*read_async)(const struct iio_device *dev, void *dst, size_t len,
+            uint32_t *mask, size_t words,
+            void (*done)(ssize_t ret, void *d), void *d);
+    int (*read_attr_async)(const struct iio_device *dev,
+            const struct iio_channel *chn, const char *attr,
+            enum iio_attr_type type, char *dst, size_t len,
+            void (*done)(ssize_t ret, void *d), void *d);
+    int (*write_attr_async)(const struct iio_device *dev,
+            const struct iio_channel *chn, const char *attr,
+            enum iio_attr_type type, const char *src, size_t len,
+            void (*done)(ssize_t ret, void *d), void *d);
+    int (*read_attr_handle_async)(const struct iio_attr_handle *handle,
+            char *dst, size_t len,
+            void (*done)(ssize_t ret, void *d), void *d);
+
+    int (*get_compression_stats)(const struct iio_context *ctx,
+            struct iio_compression_stats *stats);
+    int (*get_stats)(const struct iio_context *ctx,
+            struct iio_context_stats *stats);
 };
 
 /*
@@ -161,12 +234,21 @@ struct iio_context {
 
     struct iio_device **devices;
     unsigned int nb_devices;
+    struct iio_hash_index devices_index;
+
+    /* The names, attributes and formats of the devices and channels, as
+     * well as the lookup indexes, are shared with the clones of the
+     * context; this counts the contexts referencing them. */
+    unsigned int *meta_refs;
 
     char *xml;
 
     char **attrs;
     char **values;
     unsigned int nb_attrs;
+
+    /* Time spent creating the context, filled by the backend */
+    struct iio_context_profile profile;
 };
 
 struct iio_channel {
@@ -184,6 +266,7 @@ struct iio_channel {
 
     struct iio_channel_attr *attrs;
     unsigned int nb_attrs;
+    struct iio_hash_index attrs_index;
 
     unsigned int number;
 };
@@ -197,20 +280,35 @@ struct iio_device {
 
     char **attrs;
     unsigned int nb_attrs;
+    struct iio_hash_index attrs_index;
 
     char **buffer_attrs;
     unsigned int nb_buffer_attrs;
+    struct iio_hash_index buffer_attrs_index;
 
     char **debug_attrs;
     unsigned int nb_debug_attrs;
+    struct iio_hash_index debug_attrs_index;
 
     struct iio_channel **channels;
     unsigned int nb_channels;
+    struct iio_hash_index channels_index;
 
     uint32_t *mask;
     size_t words;
 };
 
+struct iio_attr_handle {
+    const struct iio_device *dev;
+    const struct iio_channel *chn;
+    const char *attr;
+    enum iio_attr_type type;
+
+    /* Request pre-formatted by the backend, if it supports it */
+    char *cmd;
+    size_t cmd_len;
+};
+
 struct iio_buffer {
     const struct iio_device *dev;
     void *buffer, *userdata;
@@ -220,6 +318,9 @@ struct iio_buffer {
     unsigned int dev_sample_size;
     unsigned int sample_size;
     bool is_output, dev_is_high_speed;
+
+    void (*refill_cb)(struct iio_buffer *buffer, ssize_t ret, void *d);
+    void *refill_data;
 };
 
 struct iio_context_info {
@@ -238,11 +339,31 @@ struct iio_context_info ** iio_scan_result_add(
 void free_channel(struct iio_channel *chn);
 void free_device(struct iio_device *dev);
 
+struct iio_device * iio_device_clone(const struct iio_device *dev,
+        const struct iio_context *ctx);
+void free_device_clone(struct iio_device *dev);
+
+int iio_hash_index_init(struct iio_hash_index *idx, unsigned int nb_keys);
+void iio_hash_index_add(struct iio_hash_index *idx,
+        const char *key, unsigned int index);
+void iio_hash_index_free(struct iio_hash_index *idx);
+
+struct iio_attr_handle * iio_attr_handle_create(const struct iio_device *dev,
+        const struct iio_channel *chn, const char *attr,
+        enum iio_attr_type type);
+
+int iio_channel_build_index(struct iio_channel *chn);
+int iio_device_build_index(struct iio_device *dev);
+
 char *iio_channel_get_xml(const struct iio_channel *chn, size_t *len);
 char *iio_device_get_xml(const struct iio_device *dev, size_t *len);
 
+/* XML declaration and DTD starting the description of every context */
+extern const char iio_xml_header[];
+
 char *iio_context_create_xml(const struct iio_context *ctx);
 int iio_context_init(struct iio_context *ctx);
+struct iio_context * iio_context_clone_metadata(const struct iio_context *ctx);
 
 bool iio_device_is_tx(const struct iio_device *dev);
 int iio_device_open(const struct iio_device *dev,
@@ -260,7 +381,12 @@ int write_double(char *buf, size_t len, double val);
 
 struct iio_context * local_create_context(void);
 struct iio_context * network_create_context(const char *hostname);
+struct iio_context * network_create_vsock_context(const char *uri);
+struct iio_context * network_create_unix_context(const char *path);
 struct iio_context * xml_create_context_mem(const char *xml, size_t len);
+struct iio_context * shm_create_context(const char *path);
+struct iio_context * replay_create_context(const char *uri);
+struct iio_context * synth_create_context(const char *config);
 struct iio_context * xml_create_context(const char *xml_file);
 struct iio_context * usb_create_context(unsigned int bus, unsigned int address,
         unsigned int interface);
@@ -284,6 +410,9 @@ unsigned int find_channel_modifier(const char *s, size_t *len_p);
 
 char *iio_strdup(const char *str);
 
+/* CLOCK_MONOTONIC, in nanoseconds */
+uint64_t iio_time_ns(void);
+
 int iio_context_add_attr(struct iio_context *ctx,
         const char *key, const char *value);
 
@@ -81,6 +81,7 @@ struct iio_context;
 struct iio_device;
 struct iio_channel;
 struct iio_buffer;
+struct iio_attr_handle;
 
 struct iio_context_info;
 struct iio_scan_context;
@@ -334,14 +335,42 @@ __api struct iio_context * iio_create_xml_context_mem(
 /** @brief Create a context from the network
  * @param host Hostname, IPv4 or IPv6 address where the IIO Daemon is running
  * @return On success, a pointer to an iio_context structure
- * @return On failure, NULL is returned and errno is set appropriately */
+ * @return On failure, NULL is returned and errno is set appropriately
+ *
+ * <b>NOTE:</b> The address can be followed by ":port", to reach an IIO
+ * Daemon not listening on the default port, 30431. An IPv6 address then
+ * goes between brackets, e.g. "[::1]:30432". */
 __api struct iio_context * iio_create_network_context(const char *host);
 
 
 /** @brief Create a context from a URI description
  * @param uri A URI describing the context location
  * @return On success, a pointer to a iio_context structure
- * @return On failure, NULL is returned and errno is set appropriately */
+ * @return On failure, NULL is returned and errno is set appropriately
+ *
+ * <b>NOTE:</b> The supported URIs are <i>xml:path</i>, <i>ip:host[:port]</i>,
+ * <i>vsock:cid[:port]</i>, <i>unix:path</i>, <i>shm:path</i>,
+ * <i>replay:path</i> and <i>synth:config</i>. <i>vsock:</i> reaches the
+ * IIO Daemon of a virtual machine's host (CID 2) or guest over AF_VSOCK,
+ * without any IP configuration; the port defaults to the one used over
+ * TCP.
+ * <i>unix:</i> reaches an IIO Daemon running on the same machine over a Unix
+ * domain socket; a path starting with '@' names an abstract socket.
+ * <i>shm:</i> maps a file laid out as described in shm-ring.h, for instance
+ * in /dev/shm or the BAR of an ivshmem device, and reads the samples from
+ * the rings written there by the producer; attributes are not available.
+ * <i>replay:path[?speed=factor]</i> serves a recording made with
+ * iio_context_start_recording(): the attributes and buffers return the
+ * recorded values in order, each one no earlier than it was recorded, the
+ * time being divided by the factor (1 by default; 0 serves them as fast as
+ * possible). Writes are accepted and ignored.
+ * <i>synth:</i> generates devices in-process, without any server; the
+ * configuration is a comma-separated list of
+ * <i>name[/channels[t]][:format][@rate][*count]</i>, for instance
+ * <i>synth:accel_3d\@1000*8,als/1:le:u32/32>>0\@10</i>. Their channels
+ * return deterministic waveforms through the attributes and the buffers,
+ * at the rate given (100 samples per second by default, 0 for as fast as
+ * possible), which the <i>sampling_frequency</i> attribute changes. */
 __api struct iio_context * iio_create_context_from_uri(const char *uri);
 
 
@@ -372,8 +401,12 @@ __api int iio_context_get_version(const struct iio_context *ctx,
 
 /** @brief Obtain a XML representation of the given context
  * @param ctx A pointer to an iio_context structure
- * @return A pointer to a static NULL-terminated string */
-__api __pure const char * iio_context_get_xml(const struct iio_context *ctx);
+ * @return On success, a pointer to a static NULL-terminated string
+ * @return On error, NULL is returned and errno is set appropriately
+ *
+ * <b>NOTE:</b> Unless the backend provided it, the XML representation is
+ * generated the first time this function is called. */
+__api const char * iio_context_get_xml(const struct iio_context *ctx);
 
 
 /** @brief Get the name of the given context
@@ -469,6 +502,231 @@ __api int iio_context_set_timeout(
         struct iio_context *ctx, unsigned int timeout_ms);
 
 
+/** @brief Set the maximum number of connections used for attribute accesses
+ * @param ctx A pointer to an iio_context structure
+ * @param nb A positive integer, the maximum number of connections
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> With a value greater than 1, attributes read or written from
+ * several threads at the same time no longer wait for each other: additional
+ * connections to the remote are opened as needed, up to the given limit.
+ * The default is 1. Only the network backend supports this. */
+__api int iio_context_set_max_connections(
+        struct iio_context *ctx, unsigned int nb);
+
+
+/** @brief Get a pollable file descriptor for the asynchronous operations
+ * @param ctx A pointer to an iio_context structure
+ * @return On success, a file descriptor that becomes readable when
+ * iio_context_process_async() has some work to do
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> The file descriptor belongs to the context; it must not be
+ * read from nor closed. It can be added to the poll or epoll set of the
+ * application, to wait for IIO and other events in a single thread. Once it
+ * was requested, a request submitted while none is pending is sent right
+ * away, instead of by the next iio_context_process_async(). */
+__api int iio_context_get_async_fd(const struct iio_context *ctx);
+
+
+/** @brief Send the asynchronous requests, and process their replies
+ * @param ctx A pointer to an iio_context structure
+ * @param timeout_ms The maximum time to wait for a reply, in milliseconds.
+ * A value of 0 returns immediately, a value of -1 waits indefinitely.
+ * @return On success, the number of operations completed is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> The requests submitted since the previous call are sent by
+ * this function, together. The completion callbacks are called from this
+ * function; the requests they submit are sent before it returns. The
+ * asynchronous functions of a given context must all be called from the same
+ * thread. The asynchronous operations are not subject to the timeout set with
+ * iio_context_set_timeout(). Destroying the context completes the pending
+ * operations with -ECANCELED; their callbacks must not use the context. */
+__api int iio_context_process_async(struct iio_context *ctx, int timeout_ms);
+
+
+/** @brief Cancel the pending asynchronous attribute accesses
+ * @param ctx A pointer to an iio_context structure
+ * @return On success, the number of operations completed is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> The connection used by the asynchronous attribute accesses is
+ * dropped, and their callbacks are called from this function with -ECANCELED.
+ * The next access opens a new connection. The refills of the buffers are not
+ * affected. */
+__api int iio_context_cancel_async(struct iio_context *ctx);
+
+
+/** @brief Statistics of the compressed payloads received by a context
+ *
+ * The compression ratio is <b><i>raw_bytes / wire_bytes</i></b>, and the
+ * decompression throughput <b><i>raw_bytes / decode_ns</i></b>. */
+struct iio_compression_stats {
+    /** @brief Number of compressed payloads received */
+    uint64_t frames;
+
+    /** @brief Bytes received for these payloads, headers included */
+    uint64_t wire_bytes;
+
+    /** @brief Bytes of these payloads once decompressed */
+    uint64_t raw_bytes;
+
+    /** @brief Time spent decompressing them, in nanoseconds */
+    uint64_t decode_ns;
+};
+
+
+/** @brief Record the attribute values and samples read from a context
+ * @param ctx A pointer to an iio_context structure
+ * @param path The path of the file to create
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> From now on and until the context is destroyed, every value
+ * returned by an attribute read and every block returned by a buffer refill,
+ * synchronous or not, is appended to the file with its time of completion,
+ * after the XML of the context. The file can be served again with the
+ * <i>replay:</i> URI. This function must be called before the context is
+ * used by other threads. */
+__api int iio_context_start_recording(struct iio_context *ctx,
+        const char *path);
+
+
+/** @brief Get the statistics of the compressed payloads received so far
+ * @param ctx A pointer to an iio_context structure
+ * @param stats A pointer to an iio_compression_stats structure to fill
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> The network backend asks the server to compress the XML of
+ * the context and the samples. The server decides whether it does; all the
+ * counters stay at zero otherwise. -ENOSYS is returned if the backend doesn't
+ * support compression at all. */
+__api int iio_context_get_compression_stats(const struct iio_context *ctx,
+        struct iio_compression_stats *stats);
+
+
+/**
+ * @enum iio_command
+ * @brief Commands sent to the server, as counted by iio_context_get_stats()
+ */
+enum iio_command {
+    IIO_COMMAND_PRINT,      /**< XML of the context */
+    IIO_COMMAND_VERSION,
+    IIO_COMMAND_OPEN,
+    IIO_COMMAND_CLOSE,
+    IIO_COMMAND_READ,       /**< Attribute reads */
+    IIO_COMMAND_WRITE,      /**< Attribute writes */
+    IIO_COMMAND_READBUF,    /**< Buffer refills, subscriptions included */
+    IIO_COMMAND_WRITEBUF,
+    IIO_COMMAND_OTHER,      /**< TIMEOUT, GETTRIG, SETTRIG, BINARY, EXIT... */
+    IIO_NB_COMMANDS,
+};
+
+
+/** @brief Number of buckets of the round-trip time histograms */
+#define IIO_RTT_BUCKETS 24
+
+
+/** @brief Statistics of the commands of a type
+ *
+ * The traffic following a command, e.g. the samples of a READBUF, is
+ * accounted to that command. */
+struct iio_command_stats {
+    /** @brief Number of commands sent */
+    uint64_t count;
+
+    /** @brief Bytes sent, commands and payloads included */
+    uint64_t bytes_sent;
+
+    /** @brief Bytes received, replies and payloads included */
+    uint64_t bytes_received;
+
+    /** @brief System calls made to send and receive them, waits included */
+    uint64_t syscalls;
+
+    /** @brief Number of waits for the server that timed out */
+    uint64_t timeouts;
+
+    /** @brief Sum of the round-trip times, in nanoseconds */
+    uint64_t rtt_ns;
+
+    /** @brief Histogram of the round-trip times, from the command sent to
+     * the first byte of its reply: bucket 0 counts those under 2 us,
+     * bucket <b><i>i</i></b> those from 2^i to 2^(i+1) us, and the last
+     * one all those above. */
+    uint64_t rtt_buckets[IIO_RTT_BUCKETS];
+};
+
+
+/** @brief Statistics of the commands sent by a context */
+struct iio_context_stats {
+    /** @brief Statistics per command, indexed by enum iio_command */
+    struct iio_command_stats commands[IIO_NB_COMMANDS];
+
+    /** @brief System calls of the asynchronous operations
+     *
+     * Their replies are pipelined, so these calls can't be attributed to
+     * a command; they are not counted in <b><i>commands</i></b>. */
+    uint64_t async_syscalls;
+};
+
+
+/** @brief Get the statistics of the commands sent so far
+ * @param ctx A pointer to an iio_context structure
+ * @param stats A pointer to an iio_context_stats structure to fill
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> The counters of all the connections of the context are
+ * summed, asynchronous operations included; their round-trip time includes
+ * the time spent behind the requests submitted before them. -ENOSYS is
+ * returned by the backends that don't talk to a server. */
+__api int iio_context_get_stats(const struct iio_context *ctx,
+        struct iio_context_stats *stats);
+
+
+/**
+ * @enum iio_context_phase
+ * @brief Phases of the creation of a context
+ */
+enum iio_context_phase {
+    IIO_CONTEXT_PHASE_RESOLVE,      /**< Lookup of the server, e.g. DNS */
+    IIO_CONTEXT_PHASE_CONNECT,      /**< Connection to the server */
+    IIO_CONTEXT_PHASE_HANDSHAKE,    /**< Negotiation of the protocol */
+    IIO_CONTEXT_PHASE_FETCH,        /**< Transfer of the XML */
+    IIO_CONTEXT_PHASE_PARSE,        /**< Parsing of the XML */
+    IIO_CONTEXT_PHASE_INIT,         /**< Sorting of the channels, indexes */
+    IIO_CONTEXT_PHASE_SETUP,        /**< Setup of the devices by the backend */
+    IIO_CONTEXT_NB_PHASES,
+};
+
+
+/** @brief Time spent creating a context */
+struct iio_context_profile {
+    /** @brief Duration of each phase in nanoseconds, indexed by enum
+     * iio_context_phase; zero for the phases the backend doesn't have */
+    uint64_t phase_ns[IIO_CONTEXT_NB_PHASES];
+
+    /** @brief Duration of the whole creation, in nanoseconds */
+    uint64_t total_ns;
+};
+
+
+/** @brief Get the time spent creating a context, phase by phase
+ * @param ctx A pointer to an iio_context structure
+ * @param profile A pointer to an iio_context_profile structure to fill
+ *
+ * <b>NOTE:</b> The phases are measured every time a context is created or
+ * cloned. A clone shares the XML of its original context: it has no
+ * <i>FETCH</i>, <i>PARSE</i> nor <i>INIT</i> phase. The total may exceed
+ * the sum of the phases, which don't cover the small steps between them. */
+__api void iio_context_get_profile(const struct iio_context *ctx,
+        struct iio_context_profile *profile);
+
+
 /** @} *//* ------------------------------------------------------------------*/
 /* ------------------------- Device functions --------------------------------*/
 /** @defgroup Device Device
@@ -607,6 +865,74 @@ __api __pure const char * iio_device_find_buffer_attr(
         const char *attr, char *dst, size_t len);
 
 
+/** @brief Read the content of the given device-specific attribute, without
+ * blocking
+ * @param dev A pointer to an iio_device structure
+ * @param attr A NULL-terminated string corresponding to the name of the
+ * attribute
+ * @param dst A pointer to the memory area where the NULL-terminated string
+ * corresponding to the value read will be stored
+ * @param len The available length of the memory area, in bytes
+ * @param cb A pointer to a callback function
+ * @param data A pointer that will be passed to the callback function
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> The read completes from iio_context_process_async(), which
+ * calls the callback with the number of bytes read or a negative errno code.
+ * The memory area must remain valid until then. Several reads can be in
+ * flight at once; they are sent back to back, and complete in order. */
+__api int iio_device_attr_read_async(const struct iio_device *dev,
+        const char *attr, char *dst, size_t len,
+        void (*cb)(ssize_t ret, void *d), void *data);
+
+
+/** @brief Prepare a device-specific attribute for repeated reads
+ * @param dev A pointer to an iio_device structure
+ * @param attr A NULL-terminated string corresponding to the name of the
+ * attribute
+ * @return On success, a pointer to an iio_attr_handle structure
+ * @return On error, NULL is returned and errno is set appropriately
+ *
+ * <b>NOTE:</b> See iio_channel_attr_prepare. */
+__api struct iio_attr_handle * iio_device_attr_prepare(
+        const struct iio_device *dev, const char *attr);
+
+
+/** @brief Read the content of a prepared attribute
+ * @param handle A pointer to an iio_attr_handle structure
+ * @param dst A pointer to the memory area where the NULL-terminated string
+ * corresponding to the value read will be stored
+ * @param len The available length of the memory area, in bytes
+ * @return On success, the number of bytes written to the buffer
+ * @return On error, a negative errno code is returned */
+__api ssize_t iio_attr_handle_read(const struct iio_attr_handle *handle,
+        char *dst, size_t len);
+
+
+/** @brief Read the content of a prepared attribute, without blocking
+ * @param handle A pointer to an iio_attr_handle structure
+ * @param dst A pointer to the memory area where the NULL-terminated string
+ * corresponding to the value read will be stored
+ * @param len The available length of the memory area, in bytes
+ * @param cb A pointer to a callback function
+ * @param data A pointer that will be passed to the callback function
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> See iio_device_attr_read_async. */
+__api int iio_attr_handle_read_async(const struct iio_attr_handle *handle,
+        char *dst, size_t len, void (*cb)(ssize_t ret, void *d), void *data);
+
+
+/** @brief Destroy the given prepared attribute
+ * @param handle A pointer to an iio_attr_handle structure
+ *
+ * <b>NOTE:</b> The handle may outlive its context; it is only safe to read
+ * from it while the context is alive. */
+__api void iio_attr_handle_destroy(struct iio_attr_handle *handle);
+
+
 /** @brief Read the content of all device-specific attributes
  * @param dev A pointer to an iio_device structure
  * @param cb A pointer to a callback function
@@ -678,6 +1004,25 @@ __api ssize_t iio_device_attr_write(const struct iio_device *dev,
         const char *attr, const char *src);
 
 
+/** @brief Set the value of the given device-specific attribute, without
+ * blocking
+ * @param dev A pointer to an iio_device structure
+ * @param attr A NULL-terminated string corresponding to the name of the
+ * attribute
+ * @param src A NULL-terminated string to set the attribute to
+ * @param cb A pointer to a callback function
+ * @param data A pointer that will be passed to the callback function
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> The string is copied, so it can be released right away. The
+ * write completes from iio_context_process_async(), which calls the callback
+ * with the number of bytes written or a negative errno code. */
+__api int iio_device_attr_write_async(const struct iio_device *dev,
+        const char *attr, const char *src,
+        void (*cb)(ssize_t ret, void *d), void *data);
+
+
 /** @brief Set the value of the given device-specific attribute
  * @param dev A pointer to an iio_device structure
  * @param attr A NULL-terminated string corresponding to the name of the
@@ -1056,6 +1401,40 @@ __api ssize_t iio_channel_attr_read(const struct iio_channel *chn,
         const char *attr, char *dst, size_t len);
 
 
+/** @brief Read the content of the given channel-specific attribute, without
+ * blocking
+ * @param chn A pointer to an iio_channel structure
+ * @param attr A NULL-terminated string corresponding to the name of the
+ * attribute
+ * @param dst A pointer to the memory area where the NULL-terminated string
+ * corresponding to the value read will be stored
+ * @param len The available length of the memory area, in bytes
+ * @param cb A pointer to a callback function
+ * @param data A pointer that will be passed to the callback function
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> See iio_device_attr_read_async. */
+__api int iio_channel_attr_read_async(const struct iio_channel *chn,
+        const char *attr, char *dst, size_t len,
+        void (*cb)(ssize_t ret, void *d), void *data);
+
+
+/** @brief Prepare a channel-specific attribute for repeated reads
+ * @param chn A pointer to an iio_channel structure
+ * @param attr A NULL-terminated string corresponding to the name of the
+ * attribute
+ * @return On success, a pointer to an iio_attr_handle structure
+ * @return On error, NULL is returned and errno is set appropriately
+ *
+ * <b>NOTE:</b> The attribute name is validated once here, and the network
+ * backend formats its request once here as well; reading the attribute
+ * through the handle with iio_attr_handle_read does neither. The handle must
+ * be released with iio_attr_handle_destroy. */
+__api struct iio_attr_handle * iio_channel_attr_prepare(
+        const struct iio_channel *chn, const char *attr);
+
+
 /** @brief Read the content of all channel-specific attributes
  * @param chn A pointer to an iio_channel structure
  * @param cb A pointer to a callback function
@@ -1127,6 +1506,23 @@ __api ssize_t iio_channel_attr_write(const struct iio_channel *chn,
         const char *attr, const char *src);
 
 
+/** @brief Set the value of the given channel-specific attribute, without
+ * blocking
+ * @param chn A pointer to an iio_channel structure
+ * @param attr A NULL-terminated string corresponding to the name of the
+ * attribute
+ * @param src A NULL-terminated string to set the attribute to
+ * @param cb A pointer to a callback function
+ * @param data A pointer that will be passed to the callback function
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> See iio_device_attr_write_async. */
+__api int iio_channel_attr_write_async(const struct iio_channel *chn,
+        const char *attr, const char *src,
+        void (*cb)(ssize_t ret, void *d), void *data);
+
+
 /** @brief Set the value of the given channel-specific attribute
  * @param chn A pointer to an iio_channel structure
  * @param attr A NULL-terminated string corresponding to the name of the
@@ -1345,6 +1741,40 @@ __api int iio_buffer_set_blocking_mode(struct iio_buffer *buf, bool blocking);
 __api ssize_t iio_buffer_refill(struct iio_buffer *buf);
 
 
+/** @brief Fetch more samples from the hardware, without blocking
+ * @param buf A pointer to an iio_buffer structure
+ * @param cb A pointer to a callback function
+ * @param data A pointer that will be passed to the callback function
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> The callback is called from iio_context_process_async(), with
+ * the number of bytes read or a negative errno code. The buffer must not be
+ * used in the meantime: iio_buffer_refill() fails with -EBUSY until the
+ * refills pending are complete. Destroying the buffer completes them with
+ * -EBADF, from iio_buffer_destroy(). When a refill fails because of the
+ * connection, the following refills fail too, until the buffer is created
+ * again. Only valid for input buffers. */
+__api int iio_buffer_refill_async(struct iio_buffer *buf,
+        void (*cb)(struct iio_buffer *buf, ssize_t ret, void *d),
+        void *data);
+
+
+/** @brief Have the samples sent periodically, without asking for them
+ * @param buf A pointer to an iio_buffer structure
+ * @param period_us The interval between two blocks, in microseconds
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned. -ENOSYS means the
+ * backend or the server doesn't support it; the buffer is left as it was.
+ *
+ * <b>NOTE:</b> The server then sends a full buffer of samples every period,
+ * and iio_buffer_refill() returns the next one to arrive instead of
+ * requesting it, saving a round trip per refill. Only valid for input
+ * buffers, and not compatible with iio_buffer_refill_async(). The
+ * subscription lasts until the buffer is destroyed. */
+__api int iio_buffer_subscribe(struct iio_buffer *buf, unsigned int period_us);
+
+
 /** @brief Send the samples to the hardware
  * @param buf A pointer to an iio_buffer structure
  * @return On success, the number of bytes written is returned
@@ -1766,6 +2196,97 @@ __api int iio_device_reg_read(struct iio_device *dev,
         uint32_t address, uint32_t *value);
 
 
+/**
+ * @enum iio_trace_event
+ * @brief Events recorded by the trace
+ */
+enum iio_trace_event {
+    IIO_TRACE_CONNECT_BEGIN,    /**< Connection to a server; no argument */
+    IIO_TRACE_CONNECT_END,      /**< Argument: error code, or 0 */
+    IIO_TRACE_COMMAND_SEND,     /**< Argument: length of the command */
+    IIO_TRACE_RESPONSE,         /**< Argument: code returned by the server */
+    IIO_TRACE_PARSE_BEGIN,      /**< Parsing of an XML; argument: length */
+    IIO_TRACE_PARSE_END,        /**< Argument: error code, or 0 */
+    IIO_TRACE_POLL_BEGIN,       /**< Poll of the sensors; no argument */
+    IIO_TRACE_POLL_END,         /**< Argument: number of events */
+    IIO_TRACE_EVENT_EMIT,       /**< Argument: identifier of the sensor */
+};
+
+
+/** @brief Record an event in the trace of the calling thread
+ * @param event The event that happened
+ * @param arg An argument, whose meaning depends on the event
+ *
+ * <b>NOTE:</b> Each thread records its last events, with their time, in a
+ * ring of its own, without any lock or system call. The library records
+ * its events by itself; applications can add theirs, e.g. once per poll.
+ * Does nothing if the library was built without WITH_TRACE. */
+__api void iio_trace(enum iio_trace_event event, uint32_t arg);
+
+
+/** @brief Write the events recorded by all threads to a file
+ * @param path The path of the file to create
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> This function can be called from a signal handler. The
+ * oldest events of a thread recording while the file is written may be
+ * incomplete. Use iio_trace_convert_json() to read the file. */
+__api int iio_trace_dump(const char *path);
+
+
+/** @brief Write the trace to a file each time a signal is received
+ * @param signum The signal, e.g. SIGUSR2
+ * @param path The path of the file to create; it is replaced every time
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned */
+__api int iio_trace_dump_on_signal(int signum, const char *path);
+
+
+/** @brief Convert a trace written by iio_trace_dump() to Chrome's JSON
+ * @param dump The path of the trace
+ * @param json The path of the JSON file to create
+ * @return On success, 0 is returned
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> The file can be loaded in chrome://tracing or Perfetto. */
+__api int iio_trace_convert_json(const char *dump, const char *json);
+
+
+/** @brief Statistics of the locks created at a given place */
+struct iio_lock_stats {
+    /** @brief Where the locks were created, as "file:line" */
+    const char *site;
+
+    /** @brief Number of times the locks were taken */
+    uint64_t acquisitions;
+
+    /** @brief Number of times they were busy and had to be waited for */
+    uint64_t contentions;
+
+    /** @brief Time spent waiting for them, in nanoseconds */
+    uint64_t wait_ns;
+    uint64_t max_wait_ns;
+
+    /** @brief Time they were held, in nanoseconds */
+    uint64_t hold_ns;
+    uint64_t max_hold_ns;
+};
+
+
+/** @brief Get the statistics of the locks of the library
+ * @param stats An array to fill with the statistics of each place
+ * @param nb The number of elements of the array
+ * @return On success, the number of places, which may exceed nb; only the
+ * first nb are filled
+ * @return On error, a negative errno code is returned
+ *
+ * <b>NOTE:</b> The statistics cover all the locks ever created, by all the
+ * contexts. -ENOSYS is returned if the library was built without
+ * WITH_LOCK_STATS, in which case the locks cost nothing more. */
+__api ssize_t iio_get_lock_stats(struct iio_lock_stats *stats, size_t nb);
+
+
 /** @} */
 
 #ifdef __cplusplus
@@ -16,6 +16,7 @@
  *
  */
 
+#include "compress.h"
 #include "debug.h"
 #include "iiod-client.h"
 #include "iio-lock.h"
@@ -23,6 +24,7 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -30,8 +32,38 @@ struct iiod_client {
     struct iio_context_pdata *pdata;
     const struct iiod_client_ops *ops;
     struct iio_mutex *lock;
+
+    /* Compressed payloads received through this client */
+    struct iio_compression_stats stats;
 };
 
+static ssize_t iiod_client_read_all(struct iiod_client *client,
+        void *desc, void *dst, size_t len);
+
+static bool iiod_client_is_binary(struct iiod_client *client, void *desc)
+{
+    return client->ops->is_binary &&
+        client->ops->is_binary(client->pdata, desc);
+}
+
+static uint32_t iiod_client_get_le32(const unsigned char *buf)
+{
+    return (uint32_t) buf[0] | (uint32_t) buf[1] << 8 |
+        (uint32_t) buf[2] << 16 | (uint32_t) buf[3] << 24;
+}
+
+static bool iiod_client_is_compressed(struct iiod_client *client, void *desc)
+{
+    return client->ops->is_compressed &&
+        client->ops->is_compressed(client->pdata, desc);
+}
+
+/* Bytes following a payload: a \n in text mode, nothing in binary mode */
+static size_t iiod_client_trailer_len(struct iiod_client *client, void *desc)
+{
+    return iiod_client_is_binary(client, desc) ? 0 : 1;
+}
+
 static ssize_t iiod_client_read_integer(struct iiod_client *client,
         void *desc, int *val)
 {
@@ -40,6 +72,18 @@ static ssize_t iiod_client_read_integer(struct iiod_client *client,
     ssize_t ret;
     int value;
 
+    if (iiod_client_is_binary(client, desc)) {
+        unsigned char word[4];
+
+        ret = iiod_client_read_all(client, desc, word, sizeof(word));
+        if (ret < 0)
+            return ret;
+
+        *val = (int32_t) iiod_client_get_le32(word);
+        IIO_TRACE(IIO_TRACE_RESPONSE, *val);
+        return 0;
+    }
+
     do {
         ret = client->ops->read_line(client->pdata,
                 desc, buf, sizeof(buf));
@@ -62,17 +106,27 @@ static ssize_t iiod_client_read_integer(struct iiod_client *client,
     if (ptr == end)
         return -EINVAL;
 
+    IIO_TRACE(IIO_TRACE_RESPONSE, value);
     *val = value;
     return 0;
 }
 
-static int iiod_client_exec_command(struct iiod_client *client,
-        void *desc, const char *cmd)
+static void iiod_client_begin_command(struct iiod_client *client,
+        void *desc, const char *cmd, size_t len)
+{
+    IIO_TRACE(IIO_TRACE_COMMAND_SEND, len);
+    if (client->ops->begin_command)
+        client->ops->begin_command(client->pdata, desc, cmd, len);
+}
+
+static int iiod_client_exec_command_len(struct iiod_client *client,
+        void *desc, const char *cmd, size_t cmd_len)
 {
     int resp;
     ssize_t ret;
 
-    ret = client->ops->write(client->pdata, desc, cmd, strlen(cmd));
+    iiod_client_begin_command(client, desc, cmd, cmd_len);
+    ret = client->ops->write(client->pdata, desc, cmd, cmd_len);
     if (ret < 0)
         return (int) ret;
 
@@ -80,6 +134,12 @@ static int iiod_client_exec_command(struct iiod_client *client,
     return ret < 0 ? (int) ret : resp;
 }
 
+static int iiod_client_exec_command(struct iiod_client *client,
+        void *desc, const char *cmd)
+{
+    return iiod_client_exec_command_len(client, desc, cmd, strlen(cmd));
+}
+
 static ssize_t iiod_client_write_all(struct iiod_client *client,
         void *desc, const void *src, size_t len)
 {
@@ -107,6 +167,13 @@ static ssize_t iiod_client_write_all(struct iiod_client *client,
     return (ssize_t) (ptr - (uintptr_t) src);
 }
 
+static ssize_t iiod_client_write_command(struct iiod_client *client,
+        void *desc, const char *cmd, size_t len)
+{
+    iiod_client_begin_command(client, desc, cmd, len);
+    return iiod_client_write_all(client, desc, cmd, len);
+}
+
 static ssize_t iiod_client_read_all(struct iiod_client *client,
         void *desc, void *dst, size_t len)
 {
@@ -148,6 +215,7 @@ struct iiod_client * iiod_client_new(struct iio_context_pdata *pdata,
     client->lock = lock;
     client->pdata = pdata;
     client->ops = ops;
+    memset(&client->stats, 0, sizeof(client->stats));
     return client;
 }
 
@@ -167,7 +235,8 @@ int iiod_client_get_version(struct iiod_client *client, void *desc,
 
     iio_mutex_lock(client->lock);
 
-    ret = ops->write(pdata, desc, "VERSION\r\n", sizeof("VERSION\r\n") - 1);
+    ret = iiod_client_write_command(client, desc,
+            "VERSION\r\n", sizeof("VERSION\r\n") - 1);
     if (ret < 0) {
         iio_mutex_unlock(client->lock);
         return ret;
@@ -204,6 +273,147 @@ int iiod_client_get_version(struct iiod_client *client, void *desc,
     return 0;
 }
 
+/*
+ * Protocol extension: from the reply on, the server sends the integers
+ * (return codes and lengths) as 32-bit little-endian words instead of
+ * decimal lines, the buffer masks as 32-bit little-endian words, and
+ * nothing after the payloads. The commands and the reply to VERSION stay
+ * in text. Servers without the extension reject the command, which is
+ * reported as -ENOSYS; the connection then stays in text mode.
+ */
+int iiod_client_enable_binary(struct iiod_client *client, void *desc)
+{
+    ssize_t ret;
+    int resp;
+
+    iio_mutex_lock(client->lock);
+    ret = iiod_client_write_command(client, desc,
+            "BINARY\r\n", sizeof("BINARY\r\n") - 1);
+    if (ret >= 0)
+        ret = iiod_client_read_integer(client, desc, &resp);
+    iio_mutex_unlock(client->lock);
+
+    if (ret < 0)
+        return (int) ret;
+
+    return resp < 0 ? -ENOSYS : 0;
+}
+
+/*
+ * Protocol extension: from the reply on, the server may send the XML of
+ * PRINT and the samples of READBUF as compressed frames (see compress.h),
+ * the integer preceding each payload then being the length of the frame.
+ * Servers without the extension, or not willing to compress, reject the
+ * command, which is reported as -ENOSYS.
+ */
+int iiod_client_enable_compression(struct iiod_client *client, void *desc)
+{
+    ssize_t ret;
+    int resp;
+
+    iio_mutex_lock(client->lock);
+    ret = iiod_client_write_command(client, desc,
+            "COMPRESS\r\n", sizeof("COMPRESS\r\n") - 1);
+    if (ret >= 0)
+        ret = iiod_client_read_integer(client, desc, &resp);
+    iio_mutex_unlock(client->lock);
+
+    if (ret < 0)
+        return (int) ret;
+
+    return resp < 0 ? -ENOSYS : 0;
+}
+
+static const struct {
+    const char *name;
+    enum iio_command type;
+} iiod_client_commands[] = {
+    /* READBUF and WRITEBUF before READ and WRITE, of which they start with */
+    { "PRINT", IIO_COMMAND_PRINT },
+    { "VERSION", IIO_COMMAND_VERSION },
+    { "OPEN", IIO_COMMAND_OPEN },
+    { "CLOSE", IIO_COMMAND_CLOSE },
+    { "READBUF", IIO_COMMAND_READBUF },
+    { "READ", IIO_COMMAND_READ },
+    { "WRITEBUF", IIO_COMMAND_WRITEBUF },
+    { "WRITE", IIO_COMMAND_WRITE },
+    { "SUBSCRIBE", IIO_COMMAND_READBUF },
+};
+
+enum iio_command iiod_client_command_type(const char *cmd, size_t len)
+{
+    unsigned int i;
+
+    /* Skip the \r\n sent ahead of EXIT */
+    while (len && (*cmd == '\r' || *cmd == '\n')) {
+        cmd++;
+        len--;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(iiod_client_commands); i++) {
+        size_t n = strlen(iiod_client_commands[i].name);
+
+        if (len >= n && !strncmp(cmd, iiod_client_commands[i].name, n))
+            return iiod_client_commands[i].type;
+    }
+
+    return IIO_COMMAND_OTHER;
+}
+
+void iiod_client_account_rtt(struct iio_command_stats *stats,
+        uint64_t rtt_ns)
+{
+    uint64_t us = rtt_ns / 1000;
+    unsigned int bucket = 0;
+
+    while (us >= 2 && bucket < IIO_RTT_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+
+    __atomic_fetch_add(&stats->rtt_ns, rtt_ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->rtt_buckets[bucket], 1, __ATOMIC_RELAXED);
+}
+
+void iiod_client_get_compression_stats(struct iiod_client *client,
+        struct iio_compression_stats *stats)
+{
+    stats->frames = __atomic_load_n(&client->stats.frames,
+            __ATOMIC_RELAXED);
+    stats->wire_bytes = __atomic_load_n(&client->stats.wire_bytes,
+            __ATOMIC_RELAXED);
+    stats->raw_bytes = __atomic_load_n(&client->stats.raw_bytes,
+            __ATOMIC_RELAXED);
+    stats->decode_ns = __atomic_load_n(&client->stats.decode_ns,
+            __ATOMIC_RELAXED);
+}
+
+/* Receives a payload announced as 'wire_len' bytes into 'dst', which can
+ * hold 'len' bytes; returns the length of the payload once decompressed */
+static ssize_t iiod_client_read_payload(struct iiod_client *client,
+        void *desc, void *dst, size_t len, size_t wire_len)
+{
+    ssize_t ret;
+    char *frame;
+
+    if (!iiod_client_is_compressed(client, desc))
+        return iiod_client_read_all(client, desc, dst, wire_len);
+
+    if (wire_len > IIO_FRAME_MAX_LEN(len))
+        return -EIO;
+
+    frame = malloc(wire_len);
+    if (!frame)
+        return -ENOMEM;
+
+    ret = iiod_client_read_all(client, desc, frame, wire_len);
+    if (ret >= 0)
+        ret = iio_frame_decode(frame, wire_len, dst, len, &client->stats);
+
+    free(frame);
+    return ret;
+}
+
 int iiod_client_get_trigger(struct iiod_client *client, void *desc,
         const struct iio_device *dev, const struct iio_device **trigger)
 {
@@ -231,7 +441,8 @@ int iiod_client_get_trigger(struct iiod_client *client, void *desc,
 
     name_len = ret;
 
-    ret = (int) iiod_client_read_all(client, desc, buf, name_len + 1);
+    ret = (int) iiod_client_read_all(client, desc, buf,
+            name_len + iiod_client_trailer_len(client, desc));
     if (ret < 0)
         goto out_unlock;
 
@@ -331,77 +542,191 @@ static int iiod_client_discard(struct iiod_client *client, void *desc,
     return 0;
 }
 
-ssize_t iiod_client_read_attr(struct iiod_client *client, void *desc,
-        const struct iio_device *dev, const struct iio_channel *chn,
-        const char *attr, char *dest, size_t len, enum iio_attr_type type)
+static int iiod_client_validate_attr(const struct iio_device *dev,
+        const struct iio_channel *chn, const char *attr,
+        enum iio_attr_type type)
 {
-    const char *id = iio_device_get_id(dev);
-    char buf[1024];
-    ssize_t ret;
+    if (!attr)
+        return 0;
 
-    if (attr) {
-        if (chn) {
-            if (!iio_channel_find_attr(chn, attr))
+    if (chn) {
+        if (!iio_channel_find_attr(chn, attr))
+            return -ENOENT;
+        return 0;
+    }
+
+    switch (type) {
+        case IIO_ATTR_TYPE_DEVICE:
+            if (!iio_device_find_attr(dev, attr))
                 return -ENOENT;
-        } else {
-            switch (type) {
-                case IIO_ATTR_TYPE_DEVICE:
-                    if (!iio_device_find_attr(dev, attr))
-                        return -ENOENT;
-                    break;
-                case IIO_ATTR_TYPE_DEBUG:
-                    if (!iio_device_find_debug_attr(dev, attr))
-                        return -ENOENT;
-                    break;
-                case IIO_ATTR_TYPE_BUFFER:
-                    if (!iio_device_find_buffer_attr(dev, attr))
-                        return -ENOENT;
-                    break;
-                default:
-                    return -EINVAL;
-            }
-        }
+            break;
+        case IIO_ATTR_TYPE_DEBUG:
+            if (!iio_device_find_debug_attr(dev, attr))
+                return -ENOENT;
+            break;
+        case IIO_ATTR_TYPE_BUFFER:
+            if (!iio_device_find_buffer_attr(dev, attr))
+                return -ENOENT;
+            break;
+        default:
+            return -EINVAL;
     }
 
+    return 0;
+}
+
+static int iiod_client_format_read_attr(char *buf, size_t len,
+        const struct iio_device *dev, const struct iio_channel *chn,
+        const char *attr, enum iio_attr_type type)
+{
+    const char *id = iio_device_get_id(dev);
+
     if (chn) {
-        iio_snprintf(buf, sizeof(buf), "READ %s %s %s %s\r\n", id,
+        return iio_snprintf(buf, len, "READ %s %s %s %s\r\n", id,
                 iio_channel_is_output(chn) ? "OUTPUT" : "INPUT",
                 iio_channel_get_id(chn), attr ? attr : "");
-    } else {
-        switch (type) {
-            case IIO_ATTR_TYPE_DEVICE:
-                iio_snprintf(buf, sizeof(buf), "READ %s %s\r\n",
-                        id, attr ? attr : "");
-                break;
-            case IIO_ATTR_TYPE_DEBUG:
-                iio_snprintf(buf, sizeof(buf), "READ %s DEBUG %s\r\n",
-                        id, attr ? attr : "");
-                break;
-            case IIO_ATTR_TYPE_BUFFER:
-                iio_snprintf(buf, sizeof(buf), "READ %s BUFFER %s\r\n",
-                        id, attr ? attr : "");
-                break;
-        }
     }
 
+    switch (type) {
+        case IIO_ATTR_TYPE_DEVICE:
+            return iio_snprintf(buf, len, "READ %s %s\r\n",
+                    id, attr ? attr : "");
+        case IIO_ATTR_TYPE_DEBUG:
+            return iio_snprintf(buf, len, "READ %s DEBUG %s\r\n",
+                    id, attr ? attr : "");
+        case IIO_ATTR_TYPE_BUFFER:
+            return iio_snprintf(buf, len, "READ %s BUFFER %s\r\n",
+                    id, attr ? attr : "");
+        default:
+            return -EINVAL;
+    }
+}
+
+static int iiod_client_format_write_attr(char *buf, size_t len,
+        const struct iio_device *dev, const struct iio_channel *chn,
+        const char *attr, enum iio_attr_type type, size_t data_len)
+{
+    const char *id = iio_device_get_id(dev);
+
+    if (chn) {
+        return iio_snprintf(buf, len, "WRITE %s %s %s %s %lu\r\n", id,
+                iio_channel_is_output(chn) ? "OUTPUT" : "INPUT",
+                iio_channel_get_id(chn), attr ? attr : "",
+                (unsigned long) data_len);
+    }
+
+    switch (type) {
+        case IIO_ATTR_TYPE_DEVICE:
+            return iio_snprintf(buf, len, "WRITE %s %s %lu\r\n",
+                    id, attr ? attr : "", (unsigned long) data_len);
+        case IIO_ATTR_TYPE_DEBUG:
+            return iio_snprintf(buf, len, "WRITE %s DEBUG %s %lu\r\n",
+                    id, attr ? attr : "", (unsigned long) data_len);
+        case IIO_ATTR_TYPE_BUFFER:
+            return iio_snprintf(buf, len, "WRITE %s BUFFER %s %lu\r\n",
+                    id, attr ? attr : "", (unsigned long) data_len);
+        default:
+            return -EINVAL;
+    }
+}
+
+/* Returns a newly allocated READ command for the given attribute, so that
+ * it can be sent repeatedly with iiod_client_read_attr_cmd() */
+char * iiod_client_prepare_read_attr(const struct iio_device *dev,
+        const struct iio_channel *chn, const char *attr,
+        enum iio_attr_type type, size_t *cmd_len)
+{
+    char buf[1024], *cmd;
+    int ret;
+
+    ret = iiod_client_validate_attr(dev, chn, attr, type);
+    if (ret < 0)
+        goto err_set_errno;
+
+    ret = iiod_client_format_read_attr(buf, sizeof(buf),
+            dev, chn, attr, type);
+    if (ret < 0)
+        goto err_set_errno;
+    if ((size_t) ret >= sizeof(buf)) {
+        ret = -ENAMETOOLONG;
+        goto err_set_errno;
+    }
+
+    cmd = iio_strdup(buf);
+    if (!cmd) {
+        ret = -ENOMEM;
+        goto err_set_errno;
+    }
+
+    *cmd_len = (size_t) ret;
+    return cmd;
+
+err_set_errno:
+    errno = -ret;
+    return NULL;
+}
+
+/* Returns a newly allocated WRITE command header for the given attribute;
+ * the value of 'data_len' bytes must be sent right after it */
+char * iiod_client_prepare_write_attr(const struct iio_device *dev,
+        const struct iio_channel *chn, const char *attr,
+        enum iio_attr_type type, size_t data_len, size_t *cmd_len)
+{
+    char buf[1024], *cmd;
+    int ret;
+
+    ret = iiod_client_validate_attr(dev, chn, attr, type);
+    if (ret < 0)
+        goto err_set_errno;
+
+    ret = iiod_client_format_write_attr(buf, sizeof(buf),
+            dev, chn, attr, type, data_len);
+    if (ret < 0)
+        goto err_set_errno;
+    if ((size_t) ret >= sizeof(buf)) {
+        ret = -ENAMETOOLONG;
+        goto err_set_errno;
+    }
+
+    cmd = iio_strdup(buf);
+    if (!cmd) {
+        ret = -ENOMEM;
+        goto err_set_errno;
+    }
+
+    *cmd_len = (size_t) ret;
+    return cmd;
+
+err_set_errno:
+    errno = -ret;
+    return NULL;
+}
+
+ssize_t iiod_client_read_attr_cmd(struct iiod_client *client, void *desc,
+        const char *cmd, size_t cmd_len, char *dest, size_t len)
+{
+    size_t trailer = iiod_client_trailer_len(client, desc);
+    ssize_t ret;
+
     iio_mutex_lock(client->lock);
 
-    ret = (ssize_t) iiod_client_exec_command(client, desc, buf);
+    ret = (ssize_t) iiod_client_exec_command_len(client,
+            desc, cmd, cmd_len);
     if (ret < 0)
         goto out_unlock;
 
     if ((size_t) ret + 1 > len) {
-        iiod_client_discard(client, desc, dest, len, ret + 1);
+        iiod_client_discard(client, desc, dest, len, ret + trailer);
         ret = -EIO;
         goto out_unlock;
     }
 
-    /* +1: Also read the trailing \n */
-    ret = iiod_client_read_all(client, desc, dest, ret + 1);
+    /* Also read the trailing \n in text mode */
+    ret = iiod_client_read_all(client, desc, dest, ret + trailer);
 
-    if (ret > 0) {
+    if (ret >= 0) {
         /* Discard the trailing \n */
-        ret--;
+        ret -= trailer;
 
         /* Replace it with a \0 just in case */
         dest[ret] = '\0';
@@ -412,65 +737,45 @@ out_unlock:
     return ret;
 }
 
+ssize_t iiod_client_read_attr(struct iiod_client *client, void *desc,
+        const struct iio_device *dev, const struct iio_channel *chn,
+        const char *attr, char *dest, size_t len, enum iio_attr_type type)
+{
+    char buf[1024];
+    int ret;
+
+    ret = iiod_client_validate_attr(dev, chn, attr, type);
+    if (ret < 0)
+        return ret;
+
+    ret = iiod_client_format_read_attr(buf, sizeof(buf),
+            dev, chn, attr, type);
+    if (ret < 0)
+        return ret;
+
+    return iiod_client_read_attr_cmd(client, desc, buf,
+            strlen(buf), dest, len);
+}
+
 ssize_t iiod_client_write_attr(struct iiod_client *client, void *desc,
         const struct iio_device *dev, const struct iio_channel *chn,
         const char *attr, const char *src, size_t len, enum iio_attr_type type)
 {
-    struct iio_context_pdata *pdata = client->pdata;
-    const struct iiod_client_ops *ops = client->ops;
-    const char *id = iio_device_get_id(dev);
     char buf[1024];
     ssize_t ret;
     int resp;
 
-    if (attr) {
-        if (chn) {
-            if (!iio_channel_find_attr(chn, attr))
-                return -ENOENT;
-        } else {
-            switch (type) {
-                case IIO_ATTR_TYPE_DEVICE:
-                    if (!iio_device_find_attr(dev, attr))
-                        return -ENOENT;
-                    break;
-                case IIO_ATTR_TYPE_DEBUG:
-                    if (!iio_device_find_debug_attr(dev, attr))
-                        return -ENOENT;
-                    break;
-                case IIO_ATTR_TYPE_BUFFER:
-                    if (!iio_device_find_buffer_attr(dev, attr))
-                        return -ENOENT;
-                    break;
-                default:
-                    return -EINVAL;
-            }
-        }
-    }
+    ret = iiod_client_validate_attr(dev, chn, attr, type);
+    if (ret < 0)
+        return ret;
 
-    if (chn) {
-        iio_snprintf(buf, sizeof(buf), "WRITE %s %s %s %s %lu\r\n", id,
-                iio_channel_is_output(chn) ? "OUTPUT" : "INPUT",
-                iio_channel_get_id(chn), attr ? attr : "",
-                (unsigned long) len);
-    } else {
-        switch (type) {
-            case IIO_ATTR_TYPE_DEVICE:
-                iio_snprintf(buf, sizeof(buf), "WRITE %s %s %lu\r\n",
-                        id, attr ? attr : "", (unsigned long) len);
-                break;
-            case IIO_ATTR_TYPE_DEBUG:
-                iio_snprintf(buf, sizeof(buf), "WRITE %s DEBUG %s %lu\r\n",
-                        id, attr ? attr : "", (unsigned long) len);
-                break;
-            case IIO_ATTR_TYPE_BUFFER:
-                iio_snprintf(buf, sizeof(buf), "WRITE %s BUFFER %s %lu\r\n",
-                        id, attr ? attr : "", (unsigned long) len);
-                break;
-        }
-    }
+    ret = iiod_client_format_write_attr(buf, sizeof(buf),
+            dev, chn, attr, type, len);
+    if (ret < 0)
+        return ret;
 
     iio_mutex_lock(client->lock);
-    ret = ops->write(pdata, desc, buf, strlen(buf));
+    ret = iiod_client_write_command(client, desc, buf, strlen(buf));
     if (ret < 0)
         goto out_unlock;
 
@@ -493,8 +798,9 @@ struct iio_context * iiod_client_create_context(
         struct iiod_client *client, void *desc)
 {
     struct iio_context *ctx = NULL;
-    size_t xml_len;
-    char *xml;
+    size_t xml_len, wire_len, trailer = iiod_client_trailer_len(client, desc);
+    uint64_t start_ns = iio_time_ns(), fetch_ns;
+    char *xml, *frame = NULL;
     int ret;
 
     iio_mutex_lock(client->lock);
@@ -502,24 +808,74 @@ struct iio_context * iiod_client_create_context(
     if (ret < 0)
         goto out_unlock;
 
-    xml_len = (size_t) ret;
+    xml_len = wire_len = (size_t) ret;
+
+    if (iiod_client_is_compressed(client, desc)) {
+        if (wire_len < IIO_FRAME_HEADER_LEN) {
+            ret = -EIO;
+            goto out_unlock;
+        }
+
+        frame = malloc(wire_len + trailer);
+        if (!frame) {
+            ret = -ENOMEM;
+            goto out_unlock;
+        }
+
+        ret = (int) iiod_client_read_all(client, desc, frame,
+                wire_len + trailer);
+        if (ret < 0)
+            goto out_free_frame;
+
+        /* From now on, the length of the decompressed XML, which the
+         * frame has to be able to hold before anything is allocated */
+        xml_len = iio_frame_get_raw_len(frame);
+        if (xml_len > IIO_FRAME_MAX_RAW_LEN(wire_len) || xml_len > INT_MAX) {
+            ret = -EIO;
+            goto out_free_frame;
+        }
+    }
+
     xml = malloc(xml_len + 1);
     if (!xml) {
         ret = -ENOMEM;
-        goto out_unlock;
+        goto out_free_frame;
     }
 
-    /* +1: Also read the trailing \n */
-    ret = (int) iiod_client_read_all(client, desc, xml, xml_len + 1);
+    if (frame) {
+        ret = (int) iio_frame_decode(frame, wire_len,
+                xml, xml_len, &client->stats);
+    } else {
+        /* Also read the trailing \n in text mode */
+        ret = (int) iiod_client_read_all(client, desc, xml,
+                xml_len + trailer);
+    }
     if (ret < 0)
         goto out_free_xml;
 
+    fetch_ns = iio_time_ns() - start_ns;
+
+    IIO_TRACE(IIO_TRACE_PARSE_BEGIN, xml_len);
     ctx = iio_create_xml_context_mem(xml, xml_len);
-    if (!ctx)
+    IIO_TRACE(IIO_TRACE_PARSE_END, ctx ? 0 : errno);
+    if (!ctx) {
         ret = -errno;
+        goto out_free_xml;
+    }
+
+    ctx->profile.phase_ns[IIO_CONTEXT_PHASE_FETCH] = fetch_ns;
+    ctx->profile.total_ns += fetch_ns;
+
+    /* Keep the server's XML as the context's XML string, instead of
+     * having it generated again from the parsed context */
+    xml[xml_len] = '\0';
+    ctx->xml = xml;
+    goto out_free_frame;
 
 out_free_xml:
     free(xml);
+out_free_frame:
+    free(frame);
 out_unlock:
     iio_mutex_unlock(client->lock);
     if (!ctx)
@@ -563,6 +919,18 @@ static int iiod_client_read_mask(struct iiod_client *client,
     ssize_t ret;
     char *buf, *ptr;
 
+    /* Binary mode: the words in order, without any separator */
+    if (iiod_client_is_binary(client, desc)) {
+        ret = iiod_client_read_all(client, desc, mask,
+                words * sizeof(*mask));
+        if (ret < 0)
+            return (int) ret;
+
+        for (i = 0; i < words; i++)
+            mask[i] = iiod_client_get_le32((unsigned char *) &mask[i]);
+        return 0;
+    }
+
     buf = malloc(words * 8 + 1);
     if (!buf)
         return -ENOMEM;
@@ -605,7 +973,7 @@ ssize_t iiod_client_read_unlocked(struct iiod_client *client, void *desc,
     iio_snprintf(buf, sizeof(buf), "READBUF %s %lu\r\n",
             iio_device_get_id(dev), (unsigned long) len);
 
-    ret = iiod_client_write_all(client, desc, buf, strlen(buf));
+    ret = iiod_client_write_command(client, desc, buf, strlen(buf));
     if (ret < 0)
         return ret;
 
@@ -628,7 +996,8 @@ ssize_t iiod_client_read_unlocked(struct iiod_client *client, void *desc,
             mask = NULL; /* We read the mask only once */
         }
 
-        ret = iiod_client_read_all(client, desc, (char *) ptr, to_read);
+        ret = iiod_client_read_payload(client, desc, (char *) ptr,
+                len, (size_t) to_read);
         if (ret < 0)
             return ret;
 
@@ -640,6 +1009,77 @@ ssize_t iiod_client_read_unlocked(struct iiod_client *client, void *desc,
     return read;
 }
 
+/*
+ * Protocol extension: once subscribed, the server sends a block of 'len'
+ * bytes every 'period_us', formatted like the reply to READBUF, without
+ * waiting for any request. Servers without the extension reject the
+ * command, which is reported as -ENOSYS.
+ */
+int iiod_client_subscribe_unlocked(struct iiod_client *client, void *desc,
+        const struct iio_device *dev, size_t len, unsigned int period_us)
+{
+    char buf[1024];
+    ssize_t ret;
+    int resp;
+
+    iio_snprintf(buf, sizeof(buf), "SUBSCRIBE %s %lu %u\r\n",
+            iio_device_get_id(dev), (unsigned long) len, period_us);
+
+    ret = iiod_client_write_command(client, desc, buf, strlen(buf));
+    if (ret < 0)
+        return (int) ret;
+
+    ret = iiod_client_read_integer(client, desc, &resp);
+    if (ret < 0)
+        return (int) ret;
+
+    return resp < 0 ? -ENOSYS : 0;
+}
+
+/* Receives the next block pushed by the server after a subscription */
+ssize_t iiod_client_read_pushed_unlocked(struct iiod_client *client,
+        void *desc, const struct iio_device *dev, void *dst, size_t len,
+        uint32_t *mask, size_t words)
+{
+    unsigned int nb_channels = iio_device_get_channels_count(dev);
+    ssize_t ret;
+    int to_read;
+
+    if (!len || words != (nb_channels + 31) / 32)
+        return -EINVAL;
+
+    ret = iiod_client_read_integer(client, desc, &to_read);
+    if (ret < 0)
+        return ret;
+    if (to_read <= 0)
+        return to_read < 0 ? (ssize_t) to_read : -EPIPE;
+
+    ret = iiod_client_read_mask(client, desc, mask, words);
+    if (ret < 0)
+        return ret;
+
+    /* Compressed blocks can't be truncated */
+    if (iiod_client_is_compressed(client, desc))
+        return iiod_client_read_payload(client, desc, dst, len,
+                (size_t) to_read);
+
+    ret = iiod_client_read_all(client, desc, dst,
+            (size_t) to_read < len ? (size_t) to_read : len);
+    if (ret < 0)
+        return ret;
+
+    /* Blocks larger than the buffer are truncated */
+    if ((size_t) to_read > len) {
+        char tmp[256];
+        int err = iiod_client_discard(client, desc, tmp, sizeof(tmp),
+                (size_t) to_read - len);
+        if (err < 0)
+            return err;
+    }
+
+    return ret;
+}
+
 ssize_t iiod_client_write_unlocked(struct iiod_client *client, void *desc,
         const struct iio_device *dev, const void *src, size_t len)
 {
@@ -650,7 +1090,7 @@ ssize_t iiod_client_write_unlocked(struct iiod_client *client, void *desc,
     iio_snprintf(buf, sizeof(buf), "WRITEBUF %s %lu\r\n",
             dev->id, (unsigned long) len);
 
-    ret = iiod_client_write_all(client, desc, buf, strlen(buf));
+    ret = iiod_client_write_command(client, desc, buf, strlen(buf));
     if (ret < 0)
         return ret;
 
@@ -32,12 +32,27 @@ struct iiod_client_ops {
             void *desc, char *dst, size_t len);
     ssize_t (*read_line)(struct iio_context_pdata *pdata,
             void *desc, char *dst, size_t len);
+
+    /* Optional: whether iiod_client_enable_binary() succeeded on 'desc' */
+    bool (*is_binary)(struct iio_context_pdata *pdata, void *desc);
+
+    /* Optional: whether iiod_client_enable_compression() succeeded */
+    bool (*is_compressed)(struct iio_context_pdata *pdata, void *desc);
+
+    /* Optional: called before a command is written to 'desc', so that the
+     * traffic which follows can be accounted to it */
+    void (*begin_command)(struct iio_context_pdata *pdata, void *desc,
+            const char *cmd, size_t len);
 };
 
 struct iiod_client * iiod_client_new(struct iio_context_pdata *pdata,
         struct iio_mutex *lock, const struct iiod_client_ops *ops);
 void iiod_client_destroy(struct iiod_client *client);
 
+int iiod_client_enable_binary(struct iiod_client *client, void *desc);
+int iiod_client_enable_compression(struct iiod_client *client, void *desc);
+void iiod_client_get_compression_stats(struct iiod_client *client,
+        struct iio_compression_stats *stats);
 int iiod_client_get_version(struct iiod_client *client, void *desc,
         unsigned int *major, unsigned int *minor, char *git_tag);
 int iiod_client_get_trigger(struct iiod_client *client, void *desc,
@@ -52,6 +67,14 @@ int iiod_client_set_timeout(struct iiod_client *client,
 ssize_t iiod_client_read_attr(struct iiod_client *client, void *desc,
         const struct iio_device *dev, const struct iio_channel *chn,
         const char *attr, char *dest, size_t len, enum iio_attr_type type);
+char * iiod_client_prepare_read_attr(const struct iio_device *dev,
+        const struct iio_channel *chn, const char *attr,
+        enum iio_attr_type type, size_t *cmd_len);
+char * iiod_client_prepare_write_attr(const struct iio_device *dev,
+        const struct iio_channel *chn, const char *attr,
+        enum iio_attr_type type, size_t data_len, size_t *cmd_len);
+ssize_t iiod_client_read_attr_cmd(struct iiod_client *client, void *desc,
+        const char *cmd, size_t cmd_len, char *dest, size_t len);
 ssize_t iiod_client_write_attr(struct iiod_client *client, void *desc,
         const struct iio_device *dev, const struct iio_channel *chn,
         const char *attr, const char *src, size_t len, enum iio_attr_type type);
@@ -63,9 +86,18 @@ int iiod_client_close_unlocked(struct iiod_client *client, void *desc,
 ssize_t iiod_client_read_unlocked(struct iiod_client *client, void *desc,
         const struct iio_device *dev, void *dst, size_t len,
         uint32_t *mask, size_t words);
+int iiod_client_subscribe_unlocked(struct iiod_client *client, void *desc,
+        const struct iio_device *dev, size_t len, unsigned int period_us);
+ssize_t iiod_client_read_pushed_unlocked(struct iiod_client *client,
+        void *desc, const struct iio_device *dev, void *dst, size_t len,
+        uint32_t *mask, size_t words);
 ssize_t iiod_client_write_unlocked(struct iiod_client *client, void *desc,
         const struct iio_device *dev, const void *src, size_t len);
 struct iio_context * iiod_client_create_context(
         struct iiod_client *client, void *desc);
 
+enum iio_command iiod_client_command_type(const char *cmd, size_t len);
+void iiod_client_account_rtt(struct iio_command_stats *stats,
+        uint64_t rtt_ns);
+
 #endif /* _IIOD_CLIENT_H */
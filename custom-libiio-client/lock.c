@@ -17,6 +17,8 @@
  */
 
 #include "iio-config.h"
+#include "iio-lock.h"
+#include "iio-private.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -24,7 +26,37 @@
 #include <pthread.h>
 #endif
 
+#include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+
+/* Upper bound of the number of attempts to take a busy lock before
+ * sleeping on it */
+#define LOCK_MAX_SPINS 100
+
+#if defined(__i386__) || defined(__x86_64__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define cpu_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+
+#ifdef WITH_LOCK_STATS
+/* The locks created at the same place share their statistics */
+struct iio_lock_site {
+    struct iio_lock_site *next;
+    const char *name;
+
+    uint64_t acquisitions, contentions;
+    uint64_t wait_ns, max_wait_ns;
+    uint64_t hold_ns, max_hold_ns;
+};
+
+/* Never freed, so that the statistics outlive the locks */
+static struct iio_lock_site *lock_sites;
+static pthread_mutex_t lock_sites_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 struct iio_mutex {
 #ifdef NO_THREADS
@@ -36,18 +68,80 @@ struct iio_mutex {
     pthread_mutex_t lock;
 #endif
 #endif
+
+#ifdef WITH_LOCK_SPIN
+    /* Average number of attempts that took the lock while spinning */
+    int spins;
+#endif
+
+#ifdef WITH_LOCK_STATS
+    struct iio_lock_site *site;
+
+    /* Time the owner took the lock */
+    uint64_t acquired_ns;
+#endif
 };
 
+#ifdef WITH_LOCK_STATS
+static struct iio_lock_site * iio_lock_site_get(const char *name)
+{
+    struct iio_lock_site *site;
+
+    pthread_mutex_lock(&lock_sites_lock);
+
+    for (site = lock_sites; site; site = site->next)
+        if (!strcmp(site->name, name))
+            goto out_unlock;
+
+    site = calloc(1, sizeof(*site));
+    if (site) {
+        site->name = name;
+        site->next = lock_sites;
+        lock_sites = site;
+    }
+
+out_unlock:
+    pthread_mutex_unlock(&lock_sites_lock);
+    return site;
+}
+
+static void iio_lock_site_max(uint64_t *max, uint64_t val)
+{
+    uint64_t cur = __atomic_load_n(max, __ATOMIC_RELAXED);
+
+    while (val > cur && !__atomic_compare_exchange_n(max, &cur, val,
+                true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+struct iio_mutex * iio_mutex_create_at(const char *name)
+#else
 struct iio_mutex * iio_mutex_create(void)
+#endif
 {
     struct iio_mutex *lock = malloc(sizeof(*lock));
 
     if (!lock)
         return NULL;
 
+#ifdef WITH_LOCK_STATS
+    lock->site = iio_lock_site_get(name);
+    if (!lock->site) {
+        free(lock);
+        return NULL;
+    }
+#endif
+
+#ifdef WITH_LOCK_SPIN
+    lock->spins = 0;
+#endif
+
 #ifndef NO_THREADS
 #ifdef _WIN32
+#ifdef WITH_LOCK_SPIN
+    InitializeCriticalSectionAndSpinCount(&lock->lock, LOCK_MAX_SPINS);
+#else
     InitializeCriticalSection(&lock->lock);
+#endif
 #else
     pthread_mutex_init(&lock->lock, NULL);
 #endif
@@ -67,11 +161,64 @@ void iio_mutex_destroy(struct iio_mutex *lock)
     free(lock);
 }
 
+#if !defined(NO_THREADS) && !defined(_WIN32) && \
+        (defined(WITH_LOCK_STATS) || defined(WITH_LOCK_SPIN))
+/* Called once the lock was found busy. The critical sections are short
+ * unless a reply of the server is awaited, so the lock is likely to be
+ * released soon: try again a few times before sleeping. The number of
+ * attempts follows the number that succeeded recently, as with the
+ * non-portable adaptive mutexes of glibc. */
+static void iio_mutex_lock_contended(struct iio_mutex *lock)
+{
+#ifdef WITH_LOCK_SPIN
+    int i, max = lock->spins * 2 + 10;
+
+    if (max > LOCK_MAX_SPINS)
+        max = LOCK_MAX_SPINS;
+
+    for (i = 0; i < max; i++) {
+        cpu_relax();
+        if (!pthread_mutex_trylock(&lock->lock))
+            break;
+    }
+
+    if (i == max)
+        pthread_mutex_lock(&lock->lock);
+
+    /* We own the lock now */
+    lock->spins += (i - lock->spins) / 8;
+#else
+    pthread_mutex_lock(&lock->lock);
+#endif
+}
+#endif
+
 void iio_mutex_lock(struct iio_mutex *lock)
 {
 #ifndef NO_THREADS
 #ifdef _WIN32
     EnterCriticalSection(&lock->lock);
+#elif defined(WITH_LOCK_STATS)
+    struct iio_lock_site *site = lock->site;
+
+    if (pthread_mutex_trylock(&lock->lock)) {
+        uint64_t start_ns = iio_time_ns(), wait_ns;
+
+        iio_mutex_lock_contended(lock);
+        lock->acquired_ns = iio_time_ns();
+        wait_ns = lock->acquired_ns - start_ns;
+
+        __atomic_fetch_add(&site->contentions, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&site->wait_ns, wait_ns, __ATOMIC_RELAXED);
+        iio_lock_site_max(&site->max_wait_ns, wait_ns);
+    } else {
+        lock->acquired_ns = iio_time_ns();
+    }
+
+    __atomic_fetch_add(&site->acquisitions, 1, __ATOMIC_RELAXED);
+#elif defined(WITH_LOCK_SPIN)
+    if (pthread_mutex_trylock(&lock->lock))
+        iio_mutex_lock_contended(lock);
 #else
     pthread_mutex_lock(&lock->lock);
 #endif
@@ -83,8 +230,55 @@ void iio_mutex_unlock(struct iio_mutex *lock)
 #ifndef NO_THREADS
 #ifdef _WIN32
     LeaveCriticalSection(&lock->lock);
+#elif defined(WITH_LOCK_STATS)
+    struct iio_lock_site *site = lock->site;
+    uint64_t hold_ns = iio_time_ns() - lock->acquired_ns;
+
+    pthread_mutex_unlock(&lock->lock);
+
+    /* Accounted once released, not to make the critical section longer */
+    __atomic_fetch_add(&site->hold_ns, hold_ns, __ATOMIC_RELAXED);
+    iio_lock_site_max(&site->max_hold_ns, hold_ns);
 #else
     pthread_mutex_unlock(&lock->lock);
 #endif
 #endif
 }
+
+#ifdef WITH_LOCK_STATS
+ssize_t iio_get_lock_stats(struct iio_lock_stats *stats, size_t nb)
+{
+    struct iio_lock_site *site;
+    size_t i = 0;
+
+    pthread_mutex_lock(&lock_sites_lock);
+
+    for (site = lock_sites; site; site = site->next, i++) {
+        if (i >= nb)
+            continue;
+
+        stats[i].site = site->name;
+        stats[i].acquisitions = __atomic_load_n(&site->acquisitions,
+                __ATOMIC_RELAXED);
+        stats[i].contentions = __atomic_load_n(&site->contentions,
+                __ATOMIC_RELAXED);
+        stats[i].wait_ns = __atomic_load_n(&site->wait_ns,
+                __ATOMIC_RELAXED);
+        stats[i].max_wait_ns = __atomic_load_n(&site->max_wait_ns,
+                __ATOMIC_RELAXED);
+        stats[i].hold_ns = __atomic_load_n(&site->hold_ns,
+                __ATOMIC_RELAXED);
+        stats[i].max_hold_ns = __atomic_load_n(&site->max_hold_ns,
+                __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&lock_sites_lock);
+    return (ssize_t) i;
+}
+#else
+ssize_t iio_get_lock_stats(__notused struct iio_lock_stats *stats,
+        __notused size_t nb)
+{
+    return -ENOSYS;
+}
+#endif
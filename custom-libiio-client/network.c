@@ -17,6 +17,7 @@
  * */
 
 #include "iio-config.h"
+#include "compress.h"
 #include "iio-private.h"
 #include "iio-lock.h"
 #include "iiod-client.h"
@@ -46,6 +47,16 @@
 #include <poll.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#ifdef WITH_NETWORK_EPOLL
+#include <sys/epoll.h>
+#endif
+#ifdef WITH_NETWORK_VSOCK
+#include <linux/vm_sockets.h>
+#endif
+#ifdef WITH_NETWORK_UNIX
+#include <stddef.h>
+#include <sys/un.h>
+#endif
 #endif /* _WIN32 */
 
 #ifdef HAVE_AVAHI
@@ -65,6 +76,8 @@
 #define IIOD_PORT 30431
 #define IIOD_PORT_STR STRINGIFY(IIOD_PORT)
 
+#define RX_BUF_SIZE 4096
+
 struct iio_network_io_context {
     int fd;
 
@@ -79,14 +92,158 @@ struct iio_network_io_context {
     int cancel_fd[2]; /* pipe */
 #endif
     unsigned int timeout_ms;
+
+    /* When set, replies are received in 'rx_buf', so that a short reply
+     * is fetched with a single recv() call */
+    bool buffered;
+    char rx_buf[RX_BUF_SIZE];
+    size_t rx_start, rx_end;
+
+    /* The server sends binary replies, see iiod_client_enable_binary() */
+    bool binary;
+
+    /* The server compresses the payloads, see compress.h */
+    bool compressed;
+
+    /* Statistics of the last command sent, to which the traffic is
+     * accounted. 'cmd_sent_ns' is cleared once its reply starts. */
+    struct iio_command_stats *cmd_stats;
+    uint64_t cmd_sent_ns;
+};
+
+#define NETWORK_ACCOUNT(io_ctx, counter, n) \
+    do { \
+        if ((io_ctx)->cmd_stats) \
+            __atomic_fetch_add(&(io_ctx)->cmd_stats->counter, \
+                    (uint64_t) (n), __ATOMIC_RELAXED); \
+    } while (0)
+
+#ifdef WITH_NETWORK_EPOLL
+#define ASYNC_RX_SIZE RX_BUF_SIZE
+#define ASYNC_MAX_EVENTS 16
+
+enum network_async_type {
+    NETWORK_ASYNC_READ,
+    NETWORK_ASYNC_WRITE,
+    NETWORK_ASYNC_READBUF,
+};
+
+enum network_async_state {
+    NETWORK_ASYNC_CODE,     /* Waiting for the integer reply */
+    NETWORK_ASYNC_MASK,     /* READBUF: waiting for the channel mask */
+    NETWORK_ASYNC_DATA,     /* Receiving the payload */
+};
+
+/* A request sent on an asynchronous connection */
+struct network_async_op {
+    struct network_async_op *next;
+    enum network_async_type type;
+    enum network_async_state state;
+
+    /* READ: the destination and its size.
+     * READBUF: the destination and the number of bytes requested. */
+    char *dst;
+    size_t len;
+
+    /* Bytes written to 'dst' so far, and bytes left in the payload */
+    size_t offset, pending;
+    ssize_t result;
+
+    /* READBUF on a compressed connection: the frame being received, which
+     * is expanded into 'dst' once complete */
+    char *frame;
+    size_t frame_len;
+
+    uint32_t *mask;
+    size_t words;
+
+    /* Statistics of the command, and when it was queued */
+    struct iio_command_stats *stats;
+    uint64_t sent_ns;
+
+    /* Device of a READBUF, whose callback must run before it is closed */
+    struct iio_device_pdata *owner;
+
+    void (*done)(ssize_t ret, void *d);
+    void *d;
+};
+
+struct network_async_conn {
+    int fd;
+    bool owns_fd, compressed;
+    uint32_t events;
+
+    /* Pointer to clear when the connection is dropped */
+    struct network_async_conn **ref;
+
+    /* Requests not yet accepted by the socket */
+    char *tx;
+    size_t tx_len, tx_size;
+
+    /* Set while requests are held back in 'tx', see
+     * network_async_submit(); linked from the context's 'corked' list */
+    bool corked;
+    struct network_async_conn *corked_next;
+
+    /* Received data not yet parsed */
+    char rx[ASYNC_RX_SIZE];
+    size_t rx_start, rx_end;
+
+    /* Requests waiting for their reply, in the order they were sent */
+    struct network_async_op *head, *tail;
+};
+#endif
+
+/* Connection used for attribute accesses */
+struct iio_network_conn {
+    struct iio_network_io_context *io_ctx;
+    struct iio_mutex *lock;
+    struct iiod_client *iiod_client;
+
+    /* Number of requests currently using the connection */
+    unsigned int users;
 };
 
 struct iio_context_pdata {
     struct iio_network_io_context io_ctx;
-    struct addrinfo *addrinfo;
+
+    /* Copy of the resolved address; ai_addr points to 'addr' */
+    struct addrinfo addrinfo;
+    struct sockaddr_storage addr;
+
     struct iio_mutex *lock;
     struct iiod_client *iiod_client;
     bool msg_trunc_supported;
+
+    /* Attribute accesses are spread over up to 'max_conns' connections.
+     * The first one wraps the main connection above; the others are
+     * opened on demand, when all the existing ones are busy. */
+    struct iio_mutex *pool_lock;
+    struct iio_network_conn **conns;
+    unsigned int nb_conns, max_conns;
+
+#ifdef WITH_NETWORK_EPOLL
+    /* Event loop of the asynchronous operations, with the connection
+     * used for attribute accesses; buffers use the socket of their
+     * device. Both are set up on first use. */
+    int epoll_fd;
+    struct network_async_conn *async_conn;
+
+    /* Operations completed, but whose callback was not called yet */
+    struct network_async_op *done_head, *done_tail;
+
+    /* Connections holding requests back until the next processing */
+    struct network_async_conn *corked;
+
+    /* Set once the application may poll 'epoll_fd' by itself */
+    bool async_fd_exported;
+
+    /* Compressed payloads received by the asynchronous operations */
+    struct iio_compression_stats async_stats;
+#endif
+
+    /* Commands sent on all the connections, see iio_context_get_stats() */
+    struct iio_context_stats wire_stats;
 };
 
 struct iio_device_pdata {
@@ -96,8 +253,11 @@ struct iio_device_pdata {
     void *mmap_addr;
     size_t mmap_len;
 #endif
-    bool wait_for_err_code, is_cyclic, is_tx;
+    bool wait_for_err_code, is_cyclic, is_tx, subscribed;
     struct iio_mutex *lock;
+#ifdef WITH_NETWORK_EPOLL
+    struct network_async_conn *async_conn;
+#endif
 };
 
 #ifdef _WIN32
@@ -163,6 +323,7 @@ static int wait_cancellable(struct iio_network_io_context *io_ctx, bool read)
 
     ret = WSAWaitForMultipleEvents(2, io_ctx->events, FALSE,
         WSA_INFINITE, FALSE);
+    NETWORK_ACCOUNT(io_ctx, syscalls, 1);
 
     if (ret == WSA_WAIT_EVENT_0 + 1)
         return -EBADF;
@@ -321,12 +482,15 @@ static int wait_cancellable(struct iio_network_io_context *io_ctx, bool read)
 
         do {
             ret = poll(pfd, 2, timeout_ms);
+            NETWORK_ACCOUNT(io_ctx, syscalls, 1);
         } while (ret == -1 && errno == EINTR);
 
         if (ret == -1)
             return -errno;
-        if (!ret)
+        if (!ret) {
+            NETWORK_ACCOUNT(io_ctx, timeouts, 1);
             return -EPIPE;
+        }
 
         if (pfd[1].revents & POLLIN)
             return -EBADF;
@@ -466,6 +630,18 @@ err_free_poll:
 }
 #endif /* HAVE_AVAHI */
 
+/* Called by the iiod client, and for the commands written by this backend */
+static void network_begin_command(struct iio_context_pdata *pdata,
+        void *io_data, const char *cmd, size_t len)
+{
+    struct iio_network_io_context *io_ctx = io_data;
+
+    io_ctx->cmd_stats = &pdata->wire_stats.commands[
+        iiod_client_command_type(cmd, len)];
+    io_ctx->cmd_sent_ns = iio_time_ns();
+    NETWORK_ACCOUNT(io_ctx, count, 1);
+}
+
 static ssize_t network_recv(struct iio_network_io_context *io_ctx,
         void *data, size_t len, int flags)
 {
@@ -478,6 +654,7 @@ static ssize_t network_recv(struct iio_network_io_context *io_ctx,
             return ret;
 
         ret = recv(io_ctx->fd, data, (int) len, flags);
+        NETWORK_ACCOUNT(io_ctx, syscalls, 1);
         if (ret == 0)
             return -EPIPE;
         else if (ret > 0)
@@ -487,12 +664,24 @@ static ssize_t network_recv(struct iio_network_io_context *io_ctx,
         if (network_should_retry(err)) {
             if (io_ctx->cancellable)
                 continue;
-            else
-                return -EPIPE;
+
+            /* SO_RCVTIMEO expired */
+            NETWORK_ACCOUNT(io_ctx, timeouts, 1);
+            return -EPIPE;
         } else if (!network_is_interrupted(err)) {
             return (ssize_t) err;
         }
     }
+
+    if (io_ctx->cmd_sent_ns) {
+        iiod_client_account_rtt(io_ctx->cmd_stats,
+                iio_time_ns() - io_ctx->cmd_sent_ns);
+        io_ctx->cmd_sent_ns = 0;
+    }
+
+    /* Peeked bytes are counted when they are actually consumed */
+    if (!(flags & MSG_PEEK))
+        NETWORK_ACCOUNT(io_ctx, bytes_received, ret);
     return ret;
 }
 
@@ -508,6 +697,7 @@ static ssize_t network_send(struct iio_network_io_context *io_ctx,
             return ret;
 
         ret = send(io_ctx->fd, data, (int) len, flags);
+        NETWORK_ACCOUNT(io_ctx, syscalls, 1);
         if (ret == 0)
             return -EPIPE;
         else if (ret > 0)
@@ -517,13 +707,16 @@ static ssize_t network_send(struct iio_network_io_context *io_ctx,
         if (network_should_retry(err)) {
             if (io_ctx->cancellable)
                 continue;
-            else
-                return -EPIPE;
+
+            /* SO_SNDTIMEO expired */
+            NETWORK_ACCOUNT(io_ctx, timeouts, 1);
+            return -EPIPE;
         } else if (!network_is_interrupted(err)) {
             return (ssize_t) err;
         }
     }
 
+    NETWORK_ACCOUNT(io_ctx, bytes_sent, ret);
     return ret;
 }
 
@@ -541,12 +734,14 @@ static ssize_t write_all(struct iio_network_io_context *io_ctx,
     return (ssize_t)(ptr - (uintptr_t) src);
 }
 
-static ssize_t write_command(struct iio_network_io_context *io_ctx,
-        const char *cmd)
+static ssize_t write_command(struct iio_context_pdata *pdata,
+        struct iio_network_io_context *io_ctx, const char *cmd)
 {
     ssize_t ret;
 
     DEBUG("Writing command: %s\n", cmd);
+    IIO_TRACE(IIO_TRACE_COMMAND_SEND, strlen(cmd));
+    network_begin_command(pdata, io_ctx, cmd, strlen(cmd));
     ret = write_all(io_ctx, cmd, strlen(cmd));
     if (ret < 0) {
         char buf[1024];
@@ -698,6 +893,12 @@ static int do_connect(int fd, const struct addrinfo *addrinfo,
     return 0;
 }
 
+/* TCP options and MSG_TRUNC don't apply to the other stream sockets */
+static bool network_is_tcp(const struct addrinfo *addrinfo)
+{
+    return addrinfo->ai_family == AF_INET || addrinfo->ai_family == AF_INET6;
+}
+
 static int create_socket(const struct addrinfo *addrinfo, unsigned int timeout)
 {
     int ret, fd, yes = 1;
@@ -706,14 +907,16 @@ static int create_socket(const struct addrinfo *addrinfo, unsigned int timeout)
     if (fd < 0)
         return fd;
 
+    IIO_TRACE(IIO_TRACE_CONNECT_BEGIN, 0);
     ret = do_connect(fd, addrinfo, timeout);
+    IIO_TRACE(IIO_TRACE_CONNECT_END, ret < 0 ? -ret : 0);
     if (ret < 0) {
         close(fd);
         return ret;
     }
 
     set_socket_timeout(fd, timeout);
-    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
+    if (network_is_tcp(addrinfo) && setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
                 (const char *) &yes, sizeof(yes)) < 0) {
         ret = -errno;
         close(fd);
@@ -723,492 +926,1710 @@ static int create_socket(const struct addrinfo *addrinfo, unsigned int timeout)
     return fd;
 }
 
-static int network_open(const struct iio_device *dev,
-        size_t samples_count, bool cyclic)
+#ifdef WITH_NETWORK_EPOLL
+static int network_async_setup(struct iio_context_pdata *pdata)
 {
-    struct iio_context_pdata *pdata = dev->ctx->pdata;
-    struct iio_device_pdata *ppdata = dev->pdata;
-    int ret = -EBUSY;
+    if (pdata->epoll_fd >= 0)
+        return 0;
 
-    iio_mutex_lock(ppdata->lock);
-    if (ppdata->io_ctx.fd >= 0)
-        goto out_mutex_unlock;
+    pdata->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (pdata->epoll_fd < 0)
+        return -errno;
 
-    ret = create_socket(pdata->addrinfo, DEFAULT_TIMEOUT_MS);
-    if (ret < 0)
-        goto out_mutex_unlock;
+    return 0;
+}
 
-    ppdata->io_ctx.fd = ret;
-    ppdata->io_ctx.cancelled = false;
-    ppdata->io_ctx.cancellable = false;
-    ppdata->io_ctx.timeout_ms = DEFAULT_TIMEOUT_MS;
+static struct network_async_conn * network_async_conn_new(
+        struct iio_context_pdata *pdata, int fd, bool owns_fd,
+        struct network_async_conn **ref)
+{
+    struct network_async_conn *conn;
+    struct epoll_event ev;
+    int ret;
 
-    ret = iiod_client_open_unlocked(pdata->iiod_client,
-            &ppdata->io_ctx, dev, samples_count, cyclic);
+    ret = network_async_setup(pdata);
     if (ret < 0)
-        goto err_close_socket;
+        goto err_set_errno;
 
-    ret = setup_cancel(&ppdata->io_ctx);
-    if (ret < 0)
-        goto err_close_socket;
+    conn = zalloc(sizeof(*conn));
+    if (!conn) {
+        ret = -ENOMEM;
+        goto err_set_errno;
+    }
 
-    set_socket_timeout(ppdata->io_ctx.fd, pdata->io_ctx.timeout_ms);
+    conn->fd = fd;
+    conn->owns_fd = owns_fd;
+    conn->ref = ref;
+    conn->events = EPOLLIN;
 
-    ppdata->io_ctx.timeout_ms = pdata->io_ctx.timeout_ms;
-    ppdata->io_ctx.cancellable = true;
-    ppdata->is_tx = iio_device_is_tx(dev);
-    ppdata->is_cyclic = cyclic;
-    ppdata->wait_for_err_code = false;
-#ifdef WITH_NETWORK_GET_BUFFER
-    ppdata->mmap_len = samples_count * iio_device_get_sample_size(dev);
-#endif
+    ev.events = conn->events;
+    ev.data.ptr = conn;
 
-    iio_mutex_unlock(ppdata->lock);
+    if (epoll_ctl(pdata->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        ret = -errno;
+        free(conn);
+        goto err_set_errno;
+    }
 
-    return 0;
+    *ref = conn;
+    return conn;
 
-err_close_socket:
-    close(ppdata->io_ctx.fd);
-    ppdata->io_ctx.fd = -1;
-out_mutex_unlock:
-    iio_mutex_unlock(ppdata->lock);
-    return ret;
+err_set_errno:
+    errno = -ret;
+    return NULL;
 }
 
-static int network_close(const struct iio_device *dev)
+static void network_async_complete(struct iio_context_pdata *pdata,
+        struct network_async_op *op)
 {
-    struct iio_device_pdata *pdata = dev->pdata;
-    int ret = -EBADF;
+    op->next = NULL;
+    if (pdata->done_tail)
+        pdata->done_tail->next = op;
+    else
+        pdata->done_head = op;
+    pdata->done_tail = op;
+}
 
-    iio_mutex_lock(pdata->lock);
+/* Removes the connection from the event loop. The requests still waiting
+ * for a reply complete with the error 'err' if 'notify' is set, and are
+ * dropped silently otherwise. */
+static void network_async_conn_free(struct iio_context_pdata *pdata,
+        struct network_async_conn *conn, ssize_t err, bool notify)
+{
+    struct network_async_op *op, *next;
+    struct network_async_conn **corked;
 
-    if (pdata->io_ctx.fd >= 0) {
-        if (!pdata->io_ctx.cancelled) {
-            ret = iiod_client_close_unlocked(
-                    dev->ctx->pdata->iiod_client,
-                    &pdata->io_ctx, dev);
+    for (corked = &pdata->corked; conn->corked && *corked;
+            corked = &(*corked)->corked_next) {
+        if (*corked == conn) {
+            *corked = conn->corked_next;
+            break;
+        }
+    }
+
+    epoll_ctl(pdata->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    if (conn->owns_fd)
+        close(conn->fd);
 
-            write_command(&pdata->io_ctx, "\r\nEXIT\r\n");
+    for (op = conn->head; op; op = next) {
+        next = op->next;
+        free(op->frame);
+        op->frame = NULL;
+
+        if (notify) {
+            op->result = err;
+            network_async_complete(pdata, op);
         } else {
-            ret = 0;
+            free(op);
         }
-
-        cleanup_cancel(&pdata->io_ctx);
-        close(pdata->io_ctx.fd);
-        pdata->io_ctx.fd = -1;
     }
 
-#ifdef WITH_NETWORK_GET_BUFFER
-    if (pdata->memfd >= 0)
-        close(pdata->memfd);
-    pdata->memfd = -1;
+    *conn->ref = NULL;
+    free(conn->tx);
+    free(conn);
+}
 
-    if (pdata->mmap_addr) {
-        munmap(pdata->mmap_addr, pdata->mmap_len);
-        pdata->mmap_addr = NULL;
-    }
-#endif
+static void network_async_conn_fail(struct iio_context_pdata *pdata,
+        struct network_async_conn *conn, ssize_t err)
+{
+    char buf[1024];
 
-    iio_mutex_unlock(pdata->lock);
-    return ret;
+    iio_strerror(-err, buf, sizeof(buf));
+    WARNING("Asynchronous connection lost: %s\n", buf);
+
+    /* The socket of a device may be in the middle of a request or a
+     * reply: shut it down, so that the blocking accesses fail until the
+     * device is closed and opened again, instead of reading garbage */
+    if (!conn->owns_fd)
+        shutdown(conn->fd, SHUT_RDWR);
+
+    network_async_conn_free(pdata, conn, err, true);
 }
 
-static ssize_t network_read(const struct iio_device *dev, void *dst, size_t len,
-        uint32_t *mask, size_t words)
+static int network_async_update_events(struct iio_context_pdata *pdata,
+        struct network_async_conn *conn)
 {
-    struct iio_device_pdata *pdata = dev->pdata;
-    ssize_t ret;
+    struct epoll_event ev;
+    uint32_t events = EPOLLIN;
 
-    iio_mutex_lock(pdata->lock);
-    ret = iiod_client_read_unlocked(dev->ctx->pdata->iiod_client,
-            &pdata->io_ctx, dev, dst, len, mask, words);
-    iio_mutex_unlock(pdata->lock);
+    if (conn->tx_len)
+        events |= EPOLLOUT;
+    if (events == conn->events)
+        return 0;
 
-    return ret;
+    ev.events = events;
+    ev.data.ptr = conn;
+
+    if (epoll_ctl(pdata->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) < 0)
+        return -errno;
+
+    conn->events = events;
+    return 0;
 }
 
-static ssize_t network_write(const struct iio_device *dev,
-        const void *src, size_t len)
+static int network_async_flush(struct iio_context_pdata *pdata,
+        struct network_async_conn *conn)
 {
-    struct iio_device_pdata *pdata = dev->pdata;
     ssize_t ret;
 
-    iio_mutex_lock(pdata->lock);
-    ret = iiod_client_write_unlocked(dev->ctx->pdata->iiod_client,
-            &pdata->io_ctx, dev, src, len);
-    iio_mutex_unlock(pdata->lock);
+    while (conn->tx_len) {
+        ret = send(conn->fd, conn->tx, conn->tx_len, MSG_NOSIGNAL);
+        __atomic_fetch_add(&pdata->wire_stats.async_syscalls, 1,
+                __ATOMIC_RELAXED);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -errno;
+        }
 
-    return ret;
+        conn->tx_len -= (size_t) ret;
+        memmove(conn->tx, conn->tx + ret, conn->tx_len);
+    }
+
+    return network_async_update_events(pdata, conn);
 }
 
-#ifdef WITH_NETWORK_GET_BUFFER
+/* Queues a request, made of a command and an optional payload. If it can't
+ * be sent, the connection is dropped and the error returned; errors
+ * happening past this point are reported through the 'done' callback.
+ *
+ * The requests are held back, and sent all at once by the next processing,
+ * in one send() instead of one each. An application polling the file
+ * descriptor of the context would wait forever for the reply to a request
+ * not sent: then only the requests queued behind others still waiting for
+ * their reply are held back, as that reply will wake it up. */
+static int network_async_submit(struct iio_context_pdata *pdata,
+        struct network_async_conn *conn, struct network_async_op *op,
+        const char *cmd, size_t cmd_len, const char *src, size_t src_len)
+{
+    size_t tx_len = conn->tx_len + cmd_len + src_len;
+    struct network_async_op *prev;
+    int ret;
 
-static ssize_t read_all(struct iio_network_io_context *io_ctx,
-        void *dst, size_t len)
-{
-    uintptr_t ptr = (uintptr_t) dst;
-    while (len) {
-        ssize_t ret = network_recv(io_ctx, (void *) ptr, len, 0);
-        if (ret < 0)
-            return ret;
-        ptr += ret;
-        len -= ret;
+    if (tx_len > conn->tx_size) {
+        char *tx = realloc(conn->tx, tx_len);
+        if (!tx)
+            return -ENOMEM;
+
+        conn->tx = tx;
+        conn->tx_size = tx_len;
     }
-    return (ssize_t)(ptr - (uintptr_t) dst);
+
+    IIO_TRACE(IIO_TRACE_COMMAND_SEND, cmd_len);
+    op->stats = &pdata->wire_stats.commands[
+        iiod_client_command_type(cmd, cmd_len)];
+    op->sent_ns = iio_time_ns();
+    __atomic_fetch_add(&op->stats->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&op->stats->bytes_sent, cmd_len + src_len,
+            __ATOMIC_RELAXED);
+
+    memcpy(conn->tx + conn->tx_len, cmd, cmd_len);
+    if (src_len)
+        memcpy(conn->tx + conn->tx_len + cmd_len, src, src_len);
+    conn->tx_len = tx_len;
+
+    op->next = NULL;
+    op->state = NETWORK_ASYNC_CODE;
+    prev = conn->tail;
+    if (prev)
+        prev->next = op;
+    else
+        conn->head = op;
+    conn->tail = op;
+
+    /* With EPOLLOUT set, the socket is full: the event loop sends it */
+    if ((prev || !pdata->async_fd_exported) &&
+            !(conn->events & EPOLLOUT)) {
+        if (!conn->corked) {
+            conn->corked = true;
+            conn->corked_next = pdata->corked;
+            pdata->corked = conn;
+        }
+        return 0;
+    }
+
+    ret = network_async_flush(pdata, conn);
+    if (ret < 0) {
+        /* The caller still owns the request */
+        conn->tail = prev;
+        if (prev)
+            prev->next = NULL;
+        else
+            conn->head = NULL;
+
+        network_async_conn_fail(pdata, conn, ret);
+    }
+    return ret;
 }
 
-static int read_integer(struct iio_network_io_context *io_ctx, long *val)
+/* Sends the requests held back by network_async_submit() */
+static void network_async_uncork(struct iio_context_pdata *pdata)
 {
-    unsigned int i;
-    char buf[1024], *ptr;
-    ssize_t ret;
-    bool found = false;
+    struct network_async_conn *conn;
+    int ret;
 
-    for (i = 0; i < sizeof(buf) - 1; i++) {
-        ret = read_all(io_ctx, buf + i, 1);
-        if (ret < 0)
-            return (int) ret;
+    while (pdata->corked) {
+        conn = pdata->corked;
+        pdata->corked = conn->corked_next;
+        conn->corked = false;
 
-        /* Skip the eventual first few carriage returns.
-         * Also stop when a dot is found (for parsing floats) */
-        if (buf[i] != '\n' && buf[i] != '.')
-            found = true;
-        else if (found)
-            break;
+        ret = network_async_flush(pdata, conn);
+        if (ret < 0)
+            network_async_conn_fail(pdata, conn, ret);
     }
-
-    buf[i] = '\0';
-    ret = (ssize_t) strtol(buf, &ptr, 10);
-    if (ptr == buf)
-        return -EINVAL;
-    *val = (long) ret;
-    return 0;
 }
 
-static ssize_t network_read_mask(struct iio_network_io_context *io_ctx,
-        uint32_t *mask, size_t words)
+static void network_async_pop(struct iio_context_pdata *pdata,
+        struct network_async_conn *conn)
 {
-    long read_len;
-    ssize_t ret;
+    struct network_async_op *op = conn->head;
 
-    ret = read_integer(io_ctx, &read_len);
-    if (ret < 0)
-        return ret;
+    conn->head = op->next;
+    if (!conn->head)
+        conn->tail = NULL;
 
-    if (read_len > 0 && mask) {
-        size_t i;
-        char buf[9];
+    network_async_complete(pdata, op);
+}
 
-        buf[8] = '\0';
-        DEBUG("Reading mask\n");
+static int network_async_handle_code(struct iio_context_pdata *pdata,
+        struct network_async_conn *conn, long code)
+{
+    struct network_async_op *op = conn->head;
 
-        for (i = words; i > 0; i--) {
-            ret = read_all(io_ctx, buf, 8);
-            if (ret < 0)
-                return ret;
+    IIO_TRACE(IIO_TRACE_RESPONSE, code);
 
-            sscanf(buf, "%08x", &mask[i - 1]);
-            DEBUG("mask[%lu] = 0x%x\n",
-                    (unsigned long)(i - 1), mask[i - 1]);
-        }
+    /* READBUF replies once per block; only the first one is a round trip */
+    if (op->sent_ns) {
+        iiod_client_account_rtt(op->stats, iio_time_ns() - op->sent_ns);
+        op->sent_ns = 0;
     }
 
-    if (read_len > 0) {
-        char c;
-        ssize_t nb = read_all(io_ctx, &c, 1);
-        if (nb > 0 && c != '\n')
-            read_len = -EIO;
+    if (code < 0 || op->type == NETWORK_ASYNC_WRITE) {
+        op->result = (ssize_t) code;
+        network_async_pop(pdata, conn);
+        return 0;
     }
 
-    return (ssize_t) read_len;
-}
+    if (op->type == NETWORK_ASYNC_READ) {
+        /* +1: The value is followed by a \n */
+        op->pending = (size_t) code + 1;
+        op->state = NETWORK_ASYNC_DATA;
 
-static ssize_t read_error_code(struct iio_network_io_context *io_ctx)
-{
-    /*
-     * The server returns two integer codes.
-     * The first one is returned right after the WRITEBUF command is issued,
-     * and corresponds to the error code returned when the server attempted
-     * to open the device.
-     * If zero, a second error code is returned, that corresponds (if positive)
-     * to the number of bytes written.
-     *
-     * To speed up things, we delay error reporting. We just send out the
-     * data without reading the error code that the server gives us, because
-     * the answer will take too much time. If an error occured, it will be
-     * reported by the next call to iio_buffer_push().
-     */
+        /* Values too big for the destination are discarded */
+        if (op->pending > op->len)
+            op->result = -EIO;
+        else
+            op->result = (ssize_t) code;
+        return 0;
+    }
 
-    unsigned int i;
-    long resp = 0;
+    if (!code) {
+        op->result = (ssize_t) op->offset;
+        network_async_pop(pdata, conn);
+        return 0;
+    }
 
-    for (i = 0; i < 2; i++) {
-        ssize_t ret = read_integer(io_ctx, &resp);
-        if (ret < 0)
-            return ret;
-        if (resp < 0)
-            return (ssize_t) resp;
+    if (conn->compressed) {
+        if ((size_t) code < IIO_FRAME_HEADER_LEN ||
+                (size_t) code > IIO_FRAME_MAX_LEN(op->len - op->offset))
+            return -EIO;
+
+        op->frame = malloc((size_t) code);
+        if (!op->frame)
+            return -ENOMEM;
+        op->frame_len = 0;
+    } else if ((size_t) code > op->len - op->offset) {
+        return -EIO;
     }
 
-    return (ssize_t) resp;
+    op->pending = (size_t) code;
+    op->state = op->mask ? NETWORK_ASYNC_MASK : NETWORK_ASYNC_DATA;
+    return 0;
 }
 
-static ssize_t write_rwbuf_command(const struct iio_device *dev,
-        const char *cmd)
+/* Where the next bytes of the payload go */
+static char * network_async_data_ptr(struct network_async_op *op)
 {
-    struct iio_device_pdata *pdata = dev->pdata;
-
-    if (pdata->wait_for_err_code) {
-        ssize_t ret = read_error_code(&pdata->io_ctx);
+    if (op->frame)
+        return op->frame + op->frame_len;
+    return op->dst + op->offset;
+}
 
-        pdata->wait_for_err_code = false;
-        if (ret < 0)
-            return ret;
-    }
+static void network_async_data_received(struct network_async_op *op,
+        size_t len)
+{
+    __atomic_fetch_add(&op->stats->bytes_received, len, __ATOMIC_RELAXED);
 
-    return write_command(&pdata->io_ctx, cmd);
+    if (op->frame)
+        op->frame_len += len;
+    else
+        op->offset += len;
+    op->pending -= len;
 }
 
-static ssize_t network_do_splice(struct iio_device_pdata *pdata, size_t len,
-        bool read)
+static void network_async_data_done(struct iio_context_pdata *pdata,
+        struct network_async_conn *conn)
 {
-    int pipefd[2];
-    int fd_in, fd_out;
-    ssize_t ret, read_len = len, write_len = 0;
+    struct network_async_op *op = conn->head;
 
-    ret = (ssize_t) pipe2(pipefd, O_CLOEXEC);
-    if (ret < 0)
-        return -errno;
+    if (op->frame) {
+        ssize_t ret = iio_frame_decode(op->frame, op->frame_len,
+                op->dst + op->offset, op->len - op->offset,
+                &pdata->async_stats);
 
-    if (read) {
-        fd_in = pdata->io_ctx.fd;
-        fd_out = pdata->memfd;
-    } else {
-        fd_in = pdata->memfd;
-        fd_out = pdata->io_ctx.fd;
+        free(op->frame);
+        op->frame = NULL;
+
+        if (ret < 0) {
+            op->result = ret;
+            network_async_pop(pdata, conn);
+            return;
+        }
+
+        op->offset += (size_t) ret;
     }
 
-    do {
-        ret = wait_cancellable(&pdata->io_ctx, read);
-        if (ret < 0)
-            goto err_close_pipe;
+    if (op->type == NETWORK_ASYNC_READ) {
+        /* Replace the trailing \n with a \0 */
+        if (op->result >= 0)
+            op->dst[op->result] = '\0';
+        network_async_pop(pdata, conn);
+    } else if (op->offset == op->len) {
+        op->result = (ssize_t) op->offset;
+        network_async_pop(pdata, conn);
+    } else {
+        op->state = NETWORK_ASYNC_CODE;
+    }
+}
 
-        if (read_len) {
-            /*
-             * SPLICE_F_NONBLOCK is just here to avoid a deadlock when
-             * splicing from a socket. As the socket is not in
-             * non-blocking mode, it should never return -EAGAIN.
-             * TODO(pcercuei): Find why it locks...
-             * */
-            ret = splice(fd_in, NULL, pipefd[1], NULL, read_len,
-                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
-            if (!ret)
-                ret = -EIO;
-            if (ret < 0 && errno != EAGAIN) {
-                ret = -errno;
-                goto err_close_pipe;
-            } else if (ret > 0) {
-                write_len += ret;
-                read_len -= ret;
-            }
-        }
+static void network_async_parse_mask(struct network_async_op *op,
+        const char *src)
+{
+    char word[9];
+    size_t i;
 
-        if (write_len) {
-            ret = splice(pipefd[0], NULL, fd_out, NULL, write_len,
-                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
-            if (!ret)
-                ret = -EIO;
-            if (ret < 0 && errno != EAGAIN) {
-                ret = -errno;
-                goto err_close_pipe;
-            } else if (ret > 0) {
-                write_len -= ret;
-            }
-        }
+    word[8] = '\0';
 
-    } while (write_len || read_len);
+    for (i = op->words; i > 0; i--) {
+        memcpy(word, src, 8);
+        op->mask[i - 1] = (uint32_t) strtoul(word, NULL, 16);
+        src += 8;
+    }
 
-err_close_pipe:
-    close(pipefd[0]);
-    close(pipefd[1]);
-    return ret < 0 ? ret : len;
+    /* We read the mask only once */
+    op->mask = NULL;
+    op->state = NETWORK_ASYNC_DATA;
 }
 
-static ssize_t network_get_buffer(const struct iio_device *dev,
-        void **addr_ptr, size_t bytes_used,
-        uint32_t *mask, size_t words)
+/* Consumes the received data; returns a negative error code if the
+ * connection is out of sync */
+static int network_async_parse(struct iio_context_pdata *pdata,
+        struct network_async_conn *conn)
 {
-    struct iio_device_pdata *pdata = dev->pdata;
-    ssize_t ret, read = 0;
-    int memfd;
+    while (conn->rx_start < conn->rx_end) {
+        struct network_async_op *op = conn->head;
+        char *ptr = conn->rx + conn->rx_start, *end, *eol;
+        size_t avail = conn->rx_end - conn->rx_start, n;
+        long code;
+        int ret;
 
-    if (pdata->is_cyclic)
-        return -ENOSYS;
+        if (!op)
+            return -EIO;
 
-    /* We check early that the temporary file can be created, so that we can
-     * return -ENOSYS in case it fails, which will indicate that the
-     * high-speed interface is not available.
-     *
-     * O_TMPFILE -> Linux 3.11.
-     * TODO: use memfd_create (Linux 3.17) */
-    memfd = open(P_tmpdir, O_RDWR | O_TMPFILE | O_EXCL | O_CLOEXEC, S_IRWXU);
-    if (memfd < 0)
-        return -ENOSYS;
+        switch (op->state) {
+        case NETWORK_ASYNC_CODE:
+            /* Skip the empty lines */
+            if (*ptr == '\n') {
+                conn->rx_start++;
+                continue;
+            }
 
-    if (!addr_ptr || words != (dev->nb_channels + 31) / 32) {
-        close(memfd);
-        return -EINVAL;
-    }
+            eol = memchr(ptr, '\n', avail);
+            if (!eol)
+                return avail == ASYNC_RX_SIZE ? -EIO : 0;
 
-    if (pdata->mmap_addr)
-        munmap(pdata->mmap_addr, pdata->mmap_len);
+            *eol = '\0';
+            code = strtol(ptr, &end, 10);
+            if (end == ptr)
+                return -EINVAL;
 
-    if (pdata->mmap_addr && pdata->is_tx) {
-        char buf[1024];
+            conn->rx_start += (size_t) (eol - ptr) + 1;
+            __atomic_fetch_add(&op->stats->bytes_received,
+                    (size_t) (eol - ptr) + 1, __ATOMIC_RELAXED);
 
-        iio_snprintf(buf, sizeof(buf), "WRITEBUF %s %lu\r\n",
-                dev->id, (unsigned long) bytes_used);
+            ret = network_async_handle_code(pdata, conn, code);
+            if (ret < 0)
+                return ret;
+            break;
 
-        iio_mutex_lock(pdata->lock);
+        case NETWORK_ASYNC_MASK:
+            /* 8 hexadecimal digits per word, then a \n */
+            n = op->words * 8 + 1;
+            if (avail < n)
+                return 0;
 
-        ret = write_rwbuf_command(dev, buf);
-        if (ret < 0)
-            goto err_close_memfd;
+            network_async_parse_mask(op, ptr);
+            conn->rx_start += n;
+            __atomic_fetch_add(&op->stats->bytes_received, n,
+                    __ATOMIC_RELAXED);
+            break;
 
-        ret = network_do_splice(pdata, bytes_used, false);
-        if (ret < 0)
-            goto err_close_memfd;
+        case NETWORK_ASYNC_DATA:
+            n = avail < op->pending ? avail : op->pending;
+            if (op->result >= 0)
+                memcpy(network_async_data_ptr(op), ptr, n);
 
-        pdata->wait_for_err_code = true;
-        iio_mutex_unlock(pdata->lock);
+            conn->rx_start += n;
+            network_async_data_received(op, n);
+
+            if (!op->pending)
+                network_async_data_done(pdata, conn);
+            break;
+        }
     }
 
-    if (pdata->memfd >= 0)
-        close(pdata->memfd);
+    return 0;
+}
 
-    pdata->memfd = memfd;
+static int network_async_receive(struct iio_context_pdata *pdata,
+        struct network_async_conn *conn)
+{
+    struct network_async_op *op = conn->head;
+    bool direct = false;
+    ssize_t ret;
+    size_t len;
+    char *dst;
+
+    if (conn->rx_start == conn->rx_end) {
+        conn->rx_start = conn->rx_end = 0;
+
+        /* Payloads are received directly into their destination,
+         * if no reply is waiting in the buffer */
+        direct = op && op->state == NETWORK_ASYNC_DATA && op->result >= 0;
+    } else if (conn->rx_end == ASYNC_RX_SIZE) {
+        memmove(conn->rx, conn->rx + conn->rx_start,
+                conn->rx_end - conn->rx_start);
+        conn->rx_end -= conn->rx_start;
+        conn->rx_start = 0;
+    }
 
-    ret = (ssize_t) ftruncate(pdata->memfd, pdata->mmap_len);
-    if (ret < 0) {
-        ret = -errno;
-        ERROR("Unable to truncate temp file: %zi\n", -ret);
-        return ret;
+    if (direct) {
+        dst = network_async_data_ptr(op);
+        len = op->pending;
+    } else {
+        dst = conn->rx + conn->rx_end;
+        len = ASYNC_RX_SIZE - conn->rx_end;
     }
 
-    if (!pdata->is_tx) {
-        char buf[1024];
-        size_t len = pdata->mmap_len;
+    do {
+        ret = recv(conn->fd, dst, len, 0);
+        __atomic_fetch_add(&pdata->wire_stats.async_syscalls, 1,
+                __ATOMIC_RELAXED);
+    } while (ret < 0 && errno == EINTR);
 
-        iio_snprintf(buf, sizeof(buf), "READBUF %s %lu\r\n",
-                dev->id, (unsigned long) len);
+    if (ret == 0)
+        return -EPIPE;
+    if (ret < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -errno;
 
-        iio_mutex_lock(pdata->lock);
-        ret = write_rwbuf_command(dev, buf);
+    if (direct) {
+        network_async_data_received(op, (size_t) ret);
+        if (!op->pending)
+            network_async_data_done(pdata, conn);
+    } else {
+        conn->rx_end += (size_t) ret;
+        ret = network_async_parse(pdata, conn);
         if (ret < 0)
-            goto err_unlock;
-
-        do {
-            ret = network_read_mask(&pdata->io_ctx, mask, words);
-            if (!ret)
-                break;
-            if (ret < 0)
-                goto err_unlock;
+            return ret;
+    }
 
-            mask = NULL; /* We read the mask only once */
+    /* With several replies in flight, a server using Nagle's algorithm
+     * holds the next one until this one is acknowledged: don't delay
+     * the ACK. The option has to be set again after each receive. */
+    if (conn->head && network_is_tcp(&pdata->addrinfo)) {
+        int yes = 1;
 
-            ret = network_do_splice(pdata, ret, true);
-            if (ret < 0)
-                goto err_unlock;
+        setsockopt(conn->fd, IPPROTO_TCP, TCP_QUICKACK,
+                (const char *) &yes, sizeof(yes));
+    }
 
-            read += ret;
-            len -= ret;
-        } while (len);
+    return 0;
+}
 
-        iio_mutex_unlock(pdata->lock);
-    }
+static int network_async_run_ops(struct network_async_op *op)
+{
+    struct network_async_op *next;
+    int count = 0;
 
-    pdata->mmap_addr = mmap(NULL, pdata->mmap_len,
-            PROT_READ | PROT_WRITE, MAP_SHARED, pdata->memfd, 0);
-    if (pdata->mmap_addr == MAP_FAILED) {
-        pdata->mmap_addr = NULL;
-        ret = -errno;
-        ERROR("Unable to mmap: %zi\n", -ret);
-        return ret;
+    for (; op; op = next) {
+        next = op->next;
+        op->done(op->result, op->d);
+        free(op);
+        count++;
     }
 
-    *addr_ptr = pdata->mmap_addr;
-    return read ? read : (ssize_t) bytes_used;
-
-err_close_memfd:
-    close(memfd);
-err_unlock:
-    iio_mutex_unlock(pdata->lock);
-    return ret;
+    return count;
 }
-#endif
 
-static ssize_t network_read_dev_attr(const struct iio_device *dev,
-        const char *attr, char *dst, size_t len, enum iio_attr_type type)
+static int network_async_run_callbacks(struct iio_context_pdata *pdata)
 {
-    struct iio_context_pdata *pdata = dev->ctx->pdata;
+    struct network_async_op *op = pdata->done_head;
+
+    /* The callbacks may queue new operations */
+    pdata->done_head = pdata->done_tail = NULL;
 
-    return iiod_client_read_attr(pdata->iiod_client,
-            &pdata->io_ctx, dev, NULL, attr, dst, len, type);
+    return network_async_run_ops(op);
 }
 
-static ssize_t network_write_dev_attr(const struct iio_device *dev,
-        const char *attr, const char *src, size_t len, enum iio_attr_type type)
+/* Takes the operations of a device out of the event loop, so that their
+ * callbacks can be called before the device goes away; those still
+ * waiting for a reply complete with -EBADF */
+static struct network_async_op * network_async_detach_device(
+        struct iio_context_pdata *pdata, struct iio_device_pdata *dpdata)
 {
-    struct iio_context_pdata *pdata = dev->ctx->pdata;
+    struct network_async_op *op, *next, *head = NULL, **tail = &head;
+    struct network_async_op **prev = &pdata->done_head;
 
-    return iiod_client_write_attr(pdata->iiod_client,
-            &pdata->io_ctx, dev, NULL, attr, src, len, type);
-}
+    if (dpdata->async_conn)
+        network_async_conn_free(pdata, dpdata->async_conn, -EBADF, true);
 
-static ssize_t network_read_chn_attr(const struct iio_channel *chn,
-        const char *attr, char *dst, size_t len)
-{
-    struct iio_context_pdata *pdata = chn->dev->ctx->pdata;
+    pdata->done_tail = NULL;
 
-    return iiod_client_read_attr(pdata->iiod_client,
-            &pdata->io_ctx, chn->dev, chn, attr, dst, len, false);
-}
+    for (op = pdata->done_head; op; op = next) {
+        next = op->next;
 
-static ssize_t network_write_chn_attr(const struct iio_channel *chn,
-        const char *attr, const char *src, size_t len)
-{
-    struct iio_context_pdata *pdata = chn->dev->ctx->pdata;
+        if (op->owner == dpdata) {
+            *prev = next;
+            op->next = NULL;
+            *tail = op;
+            tail = &op->next;
+        } else {
+            prev = &op->next;
+            pdata->done_tail = op;
+        }
+    }
 
-    return iiod_client_write_attr(pdata->iiod_client,
-            &pdata->io_ctx, chn->dev, chn, attr, src, len, false);
+    return head;
 }
 
-static int network_get_trigger(const struct iio_device *dev,
-        const struct iio_device **trigger)
+/* Hands the socket taken over by the asynchronous refills back to the
+ * blocking reads, once no refill is pending anymore */
+static int network_async_give_back(struct iio_context_pdata *pdata,
+        struct iio_device_pdata *dpdata)
 {
-    struct iio_context_pdata *pdata = dev->ctx->pdata;
+    struct network_async_conn *conn = dpdata->async_conn;
+    struct iio_network_io_context *io_ctx = &dpdata->io_ctx;
 
-    return iiod_client_get_trigger(pdata->iiod_client,
-            &pdata->io_ctx, dev, trigger);
-}
+    if (conn->head || conn->tx_len)
+        return -EBUSY;
 
-static int network_set_trigger(const struct iio_device *dev,
-        const struct iio_device *trigger)
-{
-    struct iio_context_pdata *pdata = dev->ctx->pdata;
+    io_ctx->rx_start = 0;
+    io_ctx->rx_end = conn->rx_end - conn->rx_start;
+    memcpy(io_ctx->rx_buf, conn->rx + conn->rx_start, io_ctx->rx_end);
 
-    return iiod_client_set_trigger(pdata->iiod_client,
-            &pdata->io_ctx, dev, trigger);
+    network_async_conn_free(pdata, conn, 0, false);
+    return 0;
 }
 
-static void network_shutdown(struct iio_context *ctx)
+static int network_get_async_fd(const struct iio_context *ctx)
 {
     struct iio_context_pdata *pdata = ctx->pdata;
-    unsigned int i;
+    int ret;
 
-    iio_mutex_lock(pdata->lock);
-    write_command(&pdata->io_ctx, "\r\nEXIT\r\n");
-    close(pdata->io_ctx.fd);
+    ret = network_async_setup(pdata);
+    if (ret < 0)
+        return ret;
+
+    pdata->async_fd_exported = true;
+    return pdata->epoll_fd;
+}
+
+static int network_process_async(const struct iio_context *ctx,
+        int timeout_ms)
+{
+    struct iio_context_pdata *pdata = ctx->pdata;
+    struct epoll_event events[ASYNC_MAX_EVENTS];
+    int i, ret, nb;
+
+    ret = network_async_setup(pdata);
+    if (ret < 0)
+        return ret;
+
+    network_async_uncork(pdata);
+
+    /* Don't wait if some callbacks are already due */
+    if (pdata->done_head)
+        timeout_ms = 0;
+
+    nb = epoll_wait(pdata->epoll_fd, events, ASYNC_MAX_EVENTS, timeout_ms);
+    __atomic_fetch_add(&pdata->wire_stats.async_syscalls, 1,
+            __ATOMIC_RELAXED);
+    if (nb < 0) {
+        if (errno != EINTR)
+            return -errno;
+        nb = 0;
+    }
+
+    for (i = 0; i < nb; i++) {
+        struct network_async_conn *conn = events[i].data.ptr;
+
+        ret = 0;
+        if (events[i].events & EPOLLOUT)
+            ret = network_async_flush(pdata, conn);
+        if (!ret && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+            ret = network_async_receive(pdata, conn);
+        if (ret < 0)
+            network_async_conn_fail(pdata, conn, ret);
+    }
+
+    ret = network_async_run_callbacks(pdata);
+
+    /* Send what the callbacks queued, before the caller polls again */
+    network_async_uncork(pdata);
+    return ret;
+}
+
+static int network_cancel_async(const struct iio_context *ctx)
+{
+    struct iio_context_pdata *pdata = ctx->pdata;
+
+    if (pdata->async_conn)
+        network_async_conn_free(pdata, pdata->async_conn,
+                -ECANCELED, true);
+
+    return network_async_run_callbacks(pdata);
+}
+
+static struct network_async_conn * network_async_get_conn(
+        struct iio_context_pdata *pdata)
+{
+    struct network_async_conn *conn;
+    int fd, ret;
+
+    if (pdata->async_conn)
+        return pdata->async_conn;
+
+    fd = create_socket(&pdata->addrinfo, pdata->io_ctx.timeout_ms);
+    if (fd < 0) {
+        errno = -fd;
+        return NULL;
+    }
+
+    ret = set_blocking_mode(fd, false);
+    if (ret < 0) {
+        close(fd);
+        errno = -ret;
+        return NULL;
+    }
+
+    conn = network_async_conn_new(pdata, fd, true, &pdata->async_conn);
+    if (!conn) {
+        ret = -errno;
+        close(fd);
+        errno = -ret;
+    }
+
+    return conn;
+}
+
+static struct network_async_op * network_async_op_new(
+        enum network_async_type type, char *dst, size_t len,
+        void (*done)(ssize_t ret, void *d), void *d)
+{
+    struct network_async_op *op = zalloc(sizeof(*op));
+
+    if (op) {
+        op->type = type;
+        op->dst = dst;
+        op->len = len;
+        op->done = done;
+        op->d = d;
+    }
+
+    return op;
+}
+
+static int network_read_async(const struct iio_device *dev,
+        void *dst, size_t len, uint32_t *mask, size_t words,
+        void (*done)(ssize_t ret, void *d), void *d)
+{
+    struct iio_context_pdata *pdata = dev->ctx->pdata;
+    struct iio_device_pdata *dpdata = dev->pdata;
+    unsigned int nb_channels = iio_device_get_channels_count(dev);
+    struct network_async_op *op;
+    char buf[1024];
+    int ret;
+
+    if (!len || words != (nb_channels + 31) / 32 ||
+            words * 8 + 1 > ASYNC_RX_SIZE)
+        return -EINVAL;
+
+    /* The blocking reads use the socket under this lock */
+    iio_mutex_lock(dpdata->lock);
+
+    if (dpdata->io_ctx.fd < 0) {
+        ret = -EBADF;
+        goto out_unlock;
+    }
+    if (dpdata->subscribed) {
+        ret = -EBUSY;
+        goto out_unlock;
+    }
+
+    if (!dpdata->async_conn) {
+        struct iio_network_io_context *io_ctx = &dpdata->io_ctx;
+        struct network_async_conn *conn;
+
+        conn = network_async_conn_new(pdata, io_ctx->fd, false,
+                &dpdata->async_conn);
+        if (!conn) {
+            ret = -errno;
+            goto out_unlock;
+        }
+
+        conn->compressed = io_ctx->compressed;
+
+        /* Take over the data already received on the socket */
+        conn->rx_end = io_ctx->rx_end - io_ctx->rx_start;
+        memcpy(conn->rx, io_ctx->rx_buf + io_ctx->rx_start, conn->rx_end);
+        io_ctx->rx_start = io_ctx->rx_end = 0;
+    }
+
+    op = network_async_op_new(NETWORK_ASYNC_READBUF, dst, len, done, d);
+    if (!op) {
+        ret = -ENOMEM;
+        goto out_unlock;
+    }
+
+    op->mask = mask;
+    op->words = words;
+    op->owner = dpdata;
+
+    iio_snprintf(buf, sizeof(buf), "READBUF %s %lu\r\n",
+            iio_device_get_id(dev), (unsigned long) len);
+
+    ret = network_async_submit(pdata, dpdata->async_conn, op,
+            buf, strlen(buf), NULL, 0);
+    if (ret < 0)
+        free(op);
+
+out_unlock:
+    iio_mutex_unlock(dpdata->lock);
+    return ret;
+}
+
+static int network_async_read(struct iio_context_pdata *pdata,
+        const char *cmd, size_t cmd_len, char *dst, size_t len,
+        void (*done)(ssize_t ret, void *d), void *d)
+{
+    struct network_async_conn *conn;
+    struct network_async_op *op;
+    int ret;
+
+    conn = network_async_get_conn(pdata);
+    if (!conn)
+        return -errno;
+
+    op = network_async_op_new(NETWORK_ASYNC_READ, dst, len, done, d);
+    if (!op)
+        return -ENOMEM;
+
+    ret = network_async_submit(pdata, conn, op, cmd, cmd_len, NULL, 0);
+    if (ret < 0)
+        free(op);
+    return ret;
+}
+
+static int network_read_attr_async(const struct iio_device *dev,
+        const struct iio_channel *chn, const char *attr,
+        enum iio_attr_type type, char *dst, size_t len,
+        void (*done)(ssize_t ret, void *d), void *d)
+{
+    size_t cmd_len;
+    char *cmd;
+    int ret;
+
+    cmd = iiod_client_prepare_read_attr(dev, chn, attr, type, &cmd_len);
+    if (!cmd)
+        return -errno;
+
+    ret = network_async_read(dev->ctx->pdata, cmd, cmd_len,
+            dst, len, done, d);
+    free(cmd);
+    return ret;
+}
+
+static int network_read_attr_handle_async(
+        const struct iio_attr_handle *handle, char *dst, size_t len,
+        void (*done)(ssize_t ret, void *d), void *d)
+{
+    return network_async_read(handle->dev->ctx->pdata, handle->cmd,
+            handle->cmd_len, dst, len, done, d);
+}
+
+static int network_write_attr_async(const struct iio_device *dev,
+        const struct iio_channel *chn, const char *attr,
+        enum iio_attr_type type, const char *src, size_t len,
+        void (*done)(ssize_t ret, void *d), void *d)
+{
+    struct iio_context_pdata *pdata = dev->ctx->pdata;
+    struct network_async_conn *conn;
+    struct network_async_op *op;
+    size_t cmd_len;
+    char *cmd;
+    int ret;
+
+    cmd = iiod_client_prepare_write_attr(dev, chn, attr, type,
+            len, &cmd_len);
+    if (!cmd)
+        return -errno;
+
+    conn = network_async_get_conn(pdata);
+    if (!conn) {
+        ret = -errno;
+        goto out_free_cmd;
+    }
+
+    op = network_async_op_new(NETWORK_ASYNC_WRITE, NULL, 0, done, d);
+    if (!op) {
+        ret = -ENOMEM;
+        goto out_free_cmd;
+    }
+
+    ret = network_async_submit(pdata, conn, op, cmd, cmd_len, src, len);
+    if (ret < 0)
+        free(op);
+
+out_free_cmd:
+    free(cmd);
+    return ret;
+}
+
+static void network_async_shutdown(struct iio_context_pdata *pdata)
+{
+    if (pdata->async_conn)
+        network_async_conn_free(pdata, pdata->async_conn,
+                -ECANCELED, true);
+
+    /* Nothing will process the completions anymore */
+    network_async_run_callbacks(pdata);
+
+    if (pdata->epoll_fd >= 0)
+        close(pdata->epoll_fd);
+}
+#endif /* WITH_NETWORK_EPOLL */
+
+#ifdef WITH_NETWORK_COMPRESSION
+/* Asks the server to compress the payloads, if it is willing to */
+static int network_enable_compression(struct iiod_client *client,
+        struct iio_network_io_context *io_ctx)
+{
+    int ret = iiod_client_enable_compression(client, io_ctx);
+
+    if (ret == -ENOSYS)
+        return 0;
+    if (!ret)
+        io_ctx->compressed = true;
+    return ret;
+}
+#endif
+
+static int network_open(const struct iio_device *dev,
+        size_t samples_count, bool cyclic)
+{
+    struct iio_context_pdata *pdata = dev->ctx->pdata;
+    struct iio_device_pdata *ppdata = dev->pdata;
+    int ret = -EBUSY;
+
+    iio_mutex_lock(ppdata->lock);
+    if (ppdata->io_ctx.fd >= 0)
+        goto out_mutex_unlock;
+
+    ret = create_socket(&pdata->addrinfo, DEFAULT_TIMEOUT_MS);
+    if (ret < 0)
+        goto out_mutex_unlock;
+
+    ppdata->io_ctx.fd = ret;
+    ppdata->io_ctx.cancelled = false;
+    ppdata->io_ctx.cancellable = false;
+    ppdata->io_ctx.timeout_ms = DEFAULT_TIMEOUT_MS;
+    ppdata->io_ctx.rx_start = ppdata->io_ctx.rx_end = 0;
+    ppdata->io_ctx.compressed = false;
+#ifndef WITH_NETWORK_GET_BUFFER
+    /* The samples are spliced straight from the socket otherwise */
+    ppdata->io_ctx.buffered = true;
+#endif
+
+#if defined(WITH_NETWORK_COMPRESSION) && !defined(WITH_NETWORK_GET_BUFFER)
+    /* No need to ask if the main connection was refused */
+    if (pdata->io_ctx.compressed && !iio_device_is_tx(dev)) {
+        ret = network_enable_compression(pdata->iiod_client,
+                &ppdata->io_ctx);
+        if (ret < 0)
+            goto err_close_socket;
+    }
+#endif
+
+    ret = iiod_client_open_unlocked(pdata->iiod_client,
+            &ppdata->io_ctx, dev, samples_count, cyclic);
+    if (ret < 0)
+        goto err_close_socket;
+
+    ret = setup_cancel(&ppdata->io_ctx);
+    if (ret < 0)
+        goto err_close_socket;
+
+    set_socket_timeout(ppdata->io_ctx.fd, pdata->io_ctx.timeout_ms);
+
+    ppdata->io_ctx.timeout_ms = pdata->io_ctx.timeout_ms;
+    ppdata->io_ctx.cancellable = true;
+    ppdata->is_tx = iio_device_is_tx(dev);
+    ppdata->is_cyclic = cyclic;
+    ppdata->wait_for_err_code = false;
+    ppdata->subscribed = false;
+#ifdef WITH_NETWORK_GET_BUFFER
+    ppdata->mmap_len = samples_count * iio_device_get_sample_size(dev);
+#endif
+
+    iio_mutex_unlock(ppdata->lock);
+
+    return 0;
+
+err_close_socket:
+    close(ppdata->io_ctx.fd);
+    ppdata->io_ctx.fd = -1;
+out_mutex_unlock:
+    iio_mutex_unlock(ppdata->lock);
+    return ret;
+}
+
+static int network_close(const struct iio_device *dev)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+    bool drop;
+    int ret = -EBADF;
+#ifdef WITH_NETWORK_EPOLL
+    struct network_async_op *cancelled;
+#endif
+
+    iio_mutex_lock(pdata->lock);
+
+    /* Pushed blocks may be in flight ahead of any reply: just drop the
+     * connection, which ends the subscription on the server */
+    drop = pdata->subscribed;
+
+#ifdef WITH_NETWORK_EPOLL
+    /* Same when the asynchronous refills took over the socket, which may
+     * be in the middle of a reply */
+    if (pdata->async_conn)
+        drop = true;
+
+    cancelled = network_async_detach_device(dev->ctx->pdata, pdata);
+#endif
+
+    if (pdata->io_ctx.fd >= 0) {
+        if (drop) {
+            pdata->subscribed = false;
+            ret = 0;
+        } else if (!pdata->io_ctx.cancelled) {
+            ret = iiod_client_close_unlocked(
+                    dev->ctx->pdata->iiod_client,
+                    &pdata->io_ctx, dev);
+
+            write_command(dev->ctx->pdata, &pdata->io_ctx,
+                    "\r\nEXIT\r\n");
+        } else {
+            ret = 0;
+        }
+
+        cleanup_cancel(&pdata->io_ctx);
+        close(pdata->io_ctx.fd);
+        pdata->io_ctx.fd = -1;
+    }
+
+#ifdef WITH_NETWORK_GET_BUFFER
+    if (pdata->memfd >= 0)
+        close(pdata->memfd);
+    pdata->memfd = -1;
+
+    if (pdata->mmap_addr) {
+        munmap(pdata->mmap_addr, pdata->mmap_len);
+        pdata->mmap_addr = NULL;
+    }
+#endif
+
+    iio_mutex_unlock(pdata->lock);
+
+#ifdef WITH_NETWORK_EPOLL
+    /* Before the buffer of the refills is freed; new refills now fail */
+    network_async_run_ops(cancelled);
+#endif
+    return ret;
+}
+
+static ssize_t network_read(const struct iio_device *dev, void *dst, size_t len,
+        uint32_t *mask, size_t words)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+    ssize_t ret;
+
+    iio_mutex_lock(pdata->lock);
+#ifdef WITH_NETWORK_EPOLL
+    /* The asynchronous refills own the replies received on the socket */
+    if (pdata->async_conn) {
+        ret = network_async_give_back(dev->ctx->pdata, pdata);
+        if (ret < 0)
+            goto out_unlock;
+    }
+#endif
+
+    if (pdata->subscribed)
+        ret = iiod_client_read_pushed_unlocked(
+                dev->ctx->pdata->iiod_client,
+                &pdata->io_ctx, dev, dst, len, mask, words);
+    else
+        ret = iiod_client_read_unlocked(dev->ctx->pdata->iiod_client,
+                &pdata->io_ctx, dev, dst, len, mask, words);
+
+#ifdef WITH_NETWORK_EPOLL
+out_unlock:
+#endif
+    iio_mutex_unlock(pdata->lock);
+
+    return ret;
+}
+
+static int network_subscribe(const struct iio_device *dev, size_t len,
+        unsigned int period_us)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+    int ret = -EBADF;
+
+#ifdef WITH_NETWORK_GET_BUFFER
+    /* The spliced get_buffer path requests each block itself */
+    if (pdata->memfd >= 0)
+        return -ENOSYS;
+#endif
+
+    iio_mutex_lock(pdata->lock);
+    if (pdata->io_ctx.fd >= 0) {
+        if (pdata->is_tx || pdata->is_cyclic)
+            ret = -EINVAL;
+        else if (pdata->subscribed)
+            ret = -EBUSY;
+#ifdef WITH_NETWORK_EPOLL
+        else if (pdata->async_conn &&
+                network_async_give_back(dev->ctx->pdata, pdata) < 0)
+            ret = -EBUSY;
+#endif
+        else
+            ret = iiod_client_subscribe_unlocked(
+                    dev->ctx->pdata->iiod_client,
+                    &pdata->io_ctx, dev, len, period_us);
+        if (!ret)
+            pdata->subscribed = true;
+    }
+    iio_mutex_unlock(pdata->lock);
+
+    return ret;
+}
+
+static ssize_t network_write(const struct iio_device *dev,
+        const void *src, size_t len)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+    ssize_t ret;
+
+    iio_mutex_lock(pdata->lock);
+    ret = iiod_client_write_unlocked(dev->ctx->pdata->iiod_client,
+            &pdata->io_ctx, dev, src, len);
+    iio_mutex_unlock(pdata->lock);
+
+    return ret;
+}
+
+#ifdef WITH_NETWORK_GET_BUFFER
+
+static ssize_t read_all(struct iio_network_io_context *io_ctx,
+        void *dst, size_t len)
+{
+    uintptr_t ptr = (uintptr_t) dst;
+    while (len) {
+        ssize_t ret = network_recv(io_ctx, (void *) ptr, len, 0);
+        if (ret < 0)
+            return ret;
+        ptr += ret;
+        len -= ret;
+    }
+    return (ssize_t)(ptr - (uintptr_t) dst);
+}
+
+static int read_integer(struct iio_network_io_context *io_ctx, long *val)
+{
+    unsigned int i;
+    char buf[1024], *ptr;
+    ssize_t ret;
+    bool found = false;
+
+    for (i = 0; i < sizeof(buf) - 1; i++) {
+        ret = read_all(io_ctx, buf + i, 1);
+        if (ret < 0)
+            return (int) ret;
+
+        /* Skip the eventual first few carriage returns.
+         * Also stop when a dot is found (for parsing floats) */
+        if (buf[i] != '\n' && buf[i] != '.')
+            found = true;
+        else if (found)
+            break;
+    }
+
+    buf[i] = '\0';
+    ret = (ssize_t) strtol(buf, &ptr, 10);
+    if (ptr == buf)
+        return -EINVAL;
+    IIO_TRACE(IIO_TRACE_RESPONSE, ret);
+    *val = (long) ret;
+    return 0;
+}
+
+static ssize_t network_read_mask(struct iio_network_io_context *io_ctx,
+        uint32_t *mask, size_t words)
+{
+    long read_len;
+    ssize_t ret;
+
+    ret = read_integer(io_ctx, &read_len);
+    if (ret < 0)
+        return ret;
+
+    if (read_len > 0 && mask) {
+        size_t i;
+        char buf[9];
+
+        buf[8] = '\0';
+        DEBUG("Reading mask\n");
+
+        for (i = words; i > 0; i--) {
+            ret = read_all(io_ctx, buf, 8);
+            if (ret < 0)
+                return ret;
+
+            sscanf(buf, "%08x", &mask[i - 1]);
+            DEBUG("mask[%lu] = 0x%x\n",
+                    (unsigned long)(i - 1), mask[i - 1]);
+        }
+    }
+
+    if (read_len > 0) {
+        char c;
+        ssize_t nb = read_all(io_ctx, &c, 1);
+        if (nb > 0 && c != '\n')
+            read_len = -EIO;
+    }
+
+    return (ssize_t) read_len;
+}
+
+static ssize_t read_error_code(struct iio_network_io_context *io_ctx)
+{
+    /*
+     * The server returns two integer codes.
+     * The first one is returned right after the WRITEBUF command is issued,
+     * and corresponds to the error code returned when the server attempted
+     * to open the device.
+     * If zero, a second error code is returned, that corresponds (if positive)
+     * to the number of bytes written.
+     *
+     * To speed up things, we delay error reporting. We just send out the
+     * data without reading the error code that the server gives us, because
+     * the answer will take too much time. If an error occured, it will be
+     * reported by the next call to iio_buffer_push().
+     */
+
+    unsigned int i;
+    long resp = 0;
+
+    for (i = 0; i < 2; i++) {
+        ssize_t ret = read_integer(io_ctx, &resp);
+        if (ret < 0)
+            return ret;
+        if (resp < 0)
+            return (ssize_t) resp;
+    }
+
+    return (ssize_t) resp;
+}
+
+static ssize_t write_rwbuf_command(const struct iio_device *dev,
+        const char *cmd)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+
+    if (pdata->wait_for_err_code) {
+        ssize_t ret = read_error_code(&pdata->io_ctx);
+
+        pdata->wait_for_err_code = false;
+        if (ret < 0)
+            return ret;
+    }
+
+    return write_command(dev->ctx->pdata, &pdata->io_ctx, cmd);
+}
+
+static ssize_t network_do_splice(struct iio_device_pdata *pdata, size_t len,
+        bool read)
+{
+    int pipefd[2];
+    int fd_in, fd_out;
+    ssize_t ret, read_len = len, write_len = 0;
+
+    ret = (ssize_t) pipe2(pipefd, O_CLOEXEC);
+    if (ret < 0)
+        return -errno;
+
+    if (read) {
+        fd_in = pdata->io_ctx.fd;
+        fd_out = pdata->memfd;
+    } else {
+        fd_in = pdata->memfd;
+        fd_out = pdata->io_ctx.fd;
+    }
+
+    do {
+        ret = wait_cancellable(&pdata->io_ctx, read);
+        if (ret < 0)
+            goto err_close_pipe;
+
+        if (read_len) {
+            /*
+             * SPLICE_F_NONBLOCK is just here to avoid a deadlock when
+             * splicing from a socket. As the socket is not in
+             * non-blocking mode, it should never return -EAGAIN.
+             * TODO(pcercuei): Find why it locks...
+             * */
+            ret = splice(fd_in, NULL, pipefd[1], NULL, read_len,
+                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            NETWORK_ACCOUNT(&pdata->io_ctx, syscalls, 1);
+            if (read && ret > 0)
+                NETWORK_ACCOUNT(&pdata->io_ctx, bytes_received, ret);
+            if (!ret)
+                ret = -EIO;
+            if (ret < 0 && errno != EAGAIN) {
+                ret = -errno;
+                goto err_close_pipe;
+            } else if (ret > 0) {
+                write_len += ret;
+                read_len -= ret;
+            }
+        }
+
+        if (write_len) {
+            ret = splice(pipefd[0], NULL, fd_out, NULL, write_len,
+                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            NETWORK_ACCOUNT(&pdata->io_ctx, syscalls, 1);
+            if (!read && ret > 0)
+                NETWORK_ACCOUNT(&pdata->io_ctx, bytes_sent, ret);
+            if (!ret)
+                ret = -EIO;
+            if (ret < 0 && errno != EAGAIN) {
+                ret = -errno;
+                goto err_close_pipe;
+            } else if (ret > 0) {
+                write_len -= ret;
+            }
+        }
+
+    } while (write_len || read_len);
+
+err_close_pipe:
+    close(pipefd[0]);
+    close(pipefd[1]);
+    return ret < 0 ? ret : len;
+}
+
+static ssize_t network_get_buffer(const struct iio_device *dev,
+        void **addr_ptr, size_t bytes_used,
+        uint32_t *mask, size_t words)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+    ssize_t ret, read = 0;
+    int memfd;
+
+    if (pdata->is_cyclic)
+        return -ENOSYS;
+
+    /* We check early that the temporary file can be created, so that we can
+     * return -ENOSYS in case it fails, which will indicate that the
+     * high-speed interface is not available.
+     *
+     * O_TMPFILE -> Linux 3.11.
+     * TODO: use memfd_create (Linux 3.17) */
+    memfd = open(P_tmpdir, O_RDWR | O_TMPFILE | O_EXCL | O_CLOEXEC, S_IRWXU);
+    if (memfd < 0)
+        return -ENOSYS;
+
+    if (!addr_ptr || words != (dev->nb_channels + 31) / 32) {
+        close(memfd);
+        return -EINVAL;
+    }
+
+    if (pdata->mmap_addr)
+        munmap(pdata->mmap_addr, pdata->mmap_len);
+
+    if (pdata->mmap_addr && pdata->is_tx) {
+        char buf[1024];
+
+        iio_snprintf(buf, sizeof(buf), "WRITEBUF %s %lu\r\n",
+                dev->id, (unsigned long) bytes_used);
+
+        iio_mutex_lock(pdata->lock);
+
+        ret = write_rwbuf_command(dev, buf);
+        if (ret < 0)
+            goto err_close_memfd;
+
+        ret = network_do_splice(pdata, bytes_used, false);
+        if (ret < 0)
+            goto err_close_memfd;
+
+        pdata->wait_for_err_code = true;
+        iio_mutex_unlock(pdata->lock);
+    }
+
+    if (pdata->memfd >= 0)
+        close(pdata->memfd);
+
+    pdata->memfd = memfd;
+
+    ret = (ssize_t) ftruncate(pdata->memfd, pdata->mmap_len);
+    if (ret < 0) {
+        ret = -errno;
+        ERROR("Unable to truncate temp file: %zi\n", -ret);
+        return ret;
+    }
+
+    if (!pdata->is_tx) {
+        char buf[1024];
+        size_t len = pdata->mmap_len;
+
+        iio_snprintf(buf, sizeof(buf), "READBUF %s %lu\r\n",
+                dev->id, (unsigned long) len);
+
+        iio_mutex_lock(pdata->lock);
+        ret = write_rwbuf_command(dev, buf);
+        if (ret < 0)
+            goto err_unlock;
+
+        do {
+            ret = network_read_mask(&pdata->io_ctx, mask, words);
+            if (!ret)
+                break;
+            if (ret < 0)
+                goto err_unlock;
+
+            mask = NULL; /* We read the mask only once */
+
+            ret = network_do_splice(pdata, ret, true);
+            if (ret < 0)
+                goto err_unlock;
+
+            read += ret;
+            len -= ret;
+        } while (len);
+
+        iio_mutex_unlock(pdata->lock);
+    }
+
+    pdata->mmap_addr = mmap(NULL, pdata->mmap_len,
+            PROT_READ | PROT_WRITE, MAP_SHARED, pdata->memfd, 0);
+    if (pdata->mmap_addr == MAP_FAILED) {
+        pdata->mmap_addr = NULL;
+        ret = -errno;
+        ERROR("Unable to mmap: %zi\n", -ret);
+        return ret;
+    }
+
+    *addr_ptr = pdata->mmap_addr;
+    return read ? read : (ssize_t) bytes_used;
+
+err_close_memfd:
+    close(memfd);
+err_unlock:
+    iio_mutex_unlock(pdata->lock);
+    return ret;
+}
+#endif
+
+static unsigned int calculate_remote_timeout(unsigned int timeout)
+{
+    /* XXX(pcercuei): We currently hardcode timeout / 2 for the backend used
+     * by the remote. Is there something better to do here? */
+    return timeout / 2;
+}
+
+static const struct iiod_client_ops network_iiod_client_ops;
+
+/* Switches the connection to binary replies if the server supports them */
+static int network_enable_binary(struct iiod_client *client,
+        struct iio_network_io_context *io_ctx)
+{
+    int ret = iiod_client_enable_binary(client, io_ctx);
+
+    if (ret == -ENOSYS)
+        return 0;
+    if (!ret)
+        io_ctx->binary = true;
+    return ret;
+}
+
+/* Negotiates the protocol extensions built in, on the main connection */
+static int network_enable_extensions(struct iiod_client *client,
+        struct iio_network_io_context *io_ctx)
+{
+    int ret = 0;
+
+#ifdef WITH_NETWORK_BINARY
+    ret = network_enable_binary(client, io_ctx);
+
+    /* A server refusing BINARY predates the extensions: don't spend one
+     * more round trip on a COMPRESS it would refuse as well */
+    if (ret < 0 || !io_ctx->binary)
+        return ret;
+#endif
+#ifdef WITH_NETWORK_COMPRESSION
+    ret = network_enable_compression(client, io_ctx);
+#endif
+    return ret;
+}
+
+static struct iio_network_conn * network_open_conn(
+        struct iio_context_pdata *pdata)
+{
+    struct iio_network_conn *conn, **conns;
+    unsigned int timeout = pdata->io_ctx.timeout_ms;
+    int fd;
+
+    conns = realloc(pdata->conns, (pdata->nb_conns + 1) * sizeof(*conns));
+    if (!conns)
+        return NULL;
+
+    pdata->conns = conns;
+
+    conn = zalloc(sizeof(*conn));
+    if (!conn)
+        return NULL;
+
+    conn->io_ctx = zalloc(sizeof(*conn->io_ctx));
+    if (!conn->io_ctx)
+        goto err_free_conn;
+
+    fd = create_socket(&pdata->addrinfo, timeout);
+    if (fd < 0)
+        goto err_free_io_ctx;
+
+    conn->io_ctx->fd = fd;
+    conn->io_ctx->timeout_ms = timeout;
+    conn->io_ctx->buffered = true;
+
+    conn->lock = iio_mutex_create();
+    if (!conn->lock)
+        goto err_close_socket;
+
+    conn->iiod_client = iiod_client_new(pdata, conn->lock,
+            &network_iiod_client_ops);
+    if (!conn->iiod_client)
+        goto err_destroy_mutex;
+
+    /* No need to ask if the first connection was refused */
+    if (pdata->io_ctx.binary &&
+            network_enable_binary(conn->iiod_client, conn->io_ctx) < 0)
+        goto err_destroy_client;
+
+    if (iiod_client_set_timeout(conn->iiod_client, conn->io_ctx,
+                calculate_remote_timeout(timeout)) < 0)
+        goto err_destroy_client;
+
+    conns[pdata->nb_conns++] = conn;
+    DEBUG("Opened connection #%u\n", pdata->nb_conns);
+    return conn;
+
+err_destroy_client:
+    iiod_client_destroy(conn->iiod_client);
+err_destroy_mutex:
+    iio_mutex_destroy(conn->lock);
+err_close_socket:
+    close(fd);
+err_free_io_ctx:
+    free(conn->io_ctx);
+err_free_conn:
+    free(conn);
+    return NULL;
+}
+
+static void network_close_conn(struct iio_context_pdata *pdata,
+        struct iio_network_conn *conn)
+{
+    iio_mutex_lock(conn->lock);
+    write_command(pdata, conn->io_ctx, "\r\nEXIT\r\n");
+    close(conn->io_ctx->fd);
+    iio_mutex_unlock(conn->lock);
+
+    iiod_client_destroy(conn->iiod_client);
+    iio_mutex_destroy(conn->lock);
+    free(conn->io_ctx);
+    free(conn);
+}
+
+/* Returns an idle connection if there is one, opens a new one if the limit
+ * allows it, and falls back to the least busy connection otherwise. */
+static struct iio_network_conn * network_lease_conn(
+        struct iio_context_pdata *pdata)
+{
+    struct iio_network_conn *conn, *best = NULL;
+    unsigned int i;
+
+    iio_mutex_lock(pdata->pool_lock);
+
+    for (i = 0; i < pdata->nb_conns && i < pdata->max_conns; i++) {
+        conn = pdata->conns[i];
+
+        if (!best || conn->users < best->users)
+            best = conn;
+        if (!conn->users)
+            break;
+    }
+
+    if (best->users && pdata->nb_conns < pdata->max_conns) {
+        conn = network_open_conn(pdata);
+        if (conn) {
+            best = conn;
+        } else {
+            /* Don't retry on every request */
+            WARNING("Unable to open a new connection, "
+                    "limiting to %u\n", pdata->nb_conns);
+            pdata->max_conns = pdata->nb_conns;
+        }
+    }
+
+    best->users++;
+    iio_mutex_unlock(pdata->pool_lock);
+
+    return best;
+}
+
+static void network_release_conn(struct iio_context_pdata *pdata,
+        struct iio_network_conn *conn)
+{
+    iio_mutex_lock(pdata->pool_lock);
+    conn->users--;
+    iio_mutex_unlock(pdata->pool_lock);
+}
+
+static ssize_t network_read_dev_attr(const struct iio_device *dev,
+        const char *attr, char *dst, size_t len, enum iio_attr_type type)
+{
+    struct iio_context_pdata *pdata = dev->ctx->pdata;
+    struct iio_network_conn *conn = network_lease_conn(pdata);
+    ssize_t ret;
+
+    ret = iiod_client_read_attr(conn->iiod_client,
+            conn->io_ctx, dev, NULL, attr, dst, len, type);
+    network_release_conn(pdata, conn);
+    return ret;
+}
+
+static ssize_t network_write_dev_attr(const struct iio_device *dev,
+        const char *attr, const char *src, size_t len, enum iio_attr_type type)
+{
+    struct iio_context_pdata *pdata = dev->ctx->pdata;
+    struct iio_network_conn *conn = network_lease_conn(pdata);
+    ssize_t ret;
+
+    ret = iiod_client_write_attr(conn->iiod_client,
+            conn->io_ctx, dev, NULL, attr, src, len, type);
+    network_release_conn(pdata, conn);
+    return ret;
+}
+
+static ssize_t network_read_chn_attr(const struct iio_channel *chn,
+        const char *attr, char *dst, size_t len)
+{
+    struct iio_context_pdata *pdata = chn->dev->ctx->pdata;
+    struct iio_network_conn *conn = network_lease_conn(pdata);
+    ssize_t ret;
+
+    ret = iiod_client_read_attr(conn->iiod_client,
+            conn->io_ctx, chn->dev, chn, attr, dst, len, false);
+    network_release_conn(pdata, conn);
+    return ret;
+}
+
+static ssize_t network_write_chn_attr(const struct iio_channel *chn,
+        const char *attr, const char *src, size_t len)
+{
+    struct iio_context_pdata *pdata = chn->dev->ctx->pdata;
+    struct iio_network_conn *conn = network_lease_conn(pdata);
+    ssize_t ret;
+
+    ret = iiod_client_write_attr(conn->iiod_client,
+            conn->io_ctx, chn->dev, chn, attr, src, len, false);
+    network_release_conn(pdata, conn);
+    return ret;
+}
+
+static int network_prepare_attr(struct iio_attr_handle *handle)
+{
+    handle->cmd = iiod_client_prepare_read_attr(handle->dev, handle->chn,
+            handle->attr, handle->type, &handle->cmd_len);
+
+    return handle->cmd ? 0 : -errno;
+}
+
+static ssize_t network_read_attr_handle(const struct iio_attr_handle *handle,
+        char *dst, size_t len)
+{
+    struct iio_context_pdata *pdata = handle->dev->ctx->pdata;
+    struct iio_network_conn *conn = network_lease_conn(pdata);
+    ssize_t ret;
+
+    ret = iiod_client_read_attr_cmd(conn->iiod_client, conn->io_ctx,
+            handle->cmd, handle->cmd_len, dst, len);
+    network_release_conn(pdata, conn);
+    return ret;
+}
+
+static int network_get_trigger(const struct iio_device *dev,
+        const struct iio_device **trigger)
+{
+    struct iio_context_pdata *pdata = dev->ctx->pdata;
+
+    return iiod_client_get_trigger(pdata->iiod_client,
+            &pdata->io_ctx, dev, trigger);
+}
+
+static int network_set_trigger(const struct iio_device *dev,
+        const struct iio_device *trigger)
+{
+    struct iio_context_pdata *pdata = dev->ctx->pdata;
+
+    return iiod_client_set_trigger(pdata->iiod_client,
+            &pdata->io_ctx, dev, trigger);
+}
+
+static void network_shutdown(struct iio_context *ctx)
+{
+    struct iio_context_pdata *pdata = ctx->pdata;
+    unsigned int i;
+
+    for (i = 1; i < pdata->nb_conns; i++)
+        network_close_conn(pdata, pdata->conns[i]);
+
+    iio_mutex_lock(pdata->lock);
+    write_command(pdata, &pdata->io_ctx, "\r\nEXIT\r\n");
+    close(pdata->io_ctx.fd);
     iio_mutex_unlock(pdata->lock);
 
     for (i = 0; i < ctx->nb_devices; i++) {
@@ -1222,9 +2643,15 @@ static void network_shutdown(struct iio_context *ctx)
         }
     }
 
+#ifdef WITH_NETWORK_EPOLL
+    network_async_shutdown(pdata);
+#endif
+
+    free(pdata->conns[0]);
+    free(pdata->conns);
+    iio_mutex_destroy(pdata->pool_lock);
     iiod_client_destroy(pdata->iiod_client);
     iio_mutex_destroy(pdata->lock);
-    freeaddrinfo(pdata->addrinfo);
     free(pdata);
 }
 
@@ -1235,13 +2662,6 @@ static int network_get_version(const struct iio_context *ctx,
             &ctx->pdata->io_ctx, major, minor, git_tag);
 }
 
-static unsigned int calculate_remote_timeout(unsigned int timeout)
-{
-    /* XXX(pcercuei): We currently hardcode timeout / 2 for the backend used
-     * by the remote. Is there something better to do here? */
-    return timeout / 2;
-}
-
 static int network_set_timeout(struct iio_context *ctx, unsigned int timeout)
 {
     struct iio_context_pdata *pdata = ctx->pdata;
@@ -1256,6 +2676,24 @@ static int network_set_timeout(struct iio_context *ctx, unsigned int timeout)
         if (!ret)
             pdata->io_ctx.timeout_ms = timeout;
     }
+
+    if (!ret) {
+        unsigned int i;
+
+        iio_mutex_lock(pdata->pool_lock);
+        for (i = 1; !ret && i < pdata->nb_conns; i++) {
+            struct iio_network_conn *conn = pdata->conns[i];
+
+            ret = set_socket_timeout(conn->io_ctx->fd, timeout);
+            if (!ret)
+                ret = iiod_client_set_timeout(conn->iiod_client,
+                        conn->io_ctx, calculate_remote_timeout(timeout));
+            if (!ret)
+                conn->io_ctx->timeout_ms = timeout;
+        }
+        iio_mutex_unlock(pdata->pool_lock);
+    }
+
     if (ret < 0) {
         char buf[1024];
         iio_strerror(-ret, buf, sizeof(buf));
@@ -1264,6 +2702,21 @@ static int network_set_timeout(struct iio_context *ctx, unsigned int timeout)
     return ret;
 }
 
+static int network_set_max_connections(struct iio_context *ctx,
+        unsigned int nb)
+{
+    struct iio_context_pdata *pdata = ctx->pdata;
+
+    if (!nb)
+        return -EINVAL;
+
+    iio_mutex_lock(pdata->pool_lock);
+    pdata->max_conns = nb;
+    iio_mutex_unlock(pdata->pool_lock);
+
+    return 0;
+}
+
 static int network_set_kernel_buffers_count(const struct iio_device *dev,
         unsigned int nb_blocks)
 {
@@ -1273,11 +2726,88 @@ static int network_set_kernel_buffers_count(const struct iio_device *dev,
              &pdata->io_ctx, dev, nb_blocks);
 }
 
+static struct iio_context_pdata * network_create_pdata(
+        const struct addrinfo *addrinfo, struct iio_context_profile *profile);
+static void network_free_pdata(struct iio_context_pdata *pdata);
+static int network_setup_devices(struct iio_context *ctx);
+
+/* The clone shares the metadata of the original context, so only a new
+ * connection and new device pdata are needed. */
 static struct iio_context * network_clone(const struct iio_context *ctx)
 {
-    const char *addr = iio_context_get_attr_value(ctx, "ip,ip-addr");
+    struct iio_context_profile profile;
+    uint64_t start_ns = iio_time_ns(), setup_ns;
+    struct iio_context_pdata *pdata;
+    struct iio_context *cpy;
+    int ret;
+
+    memset(&profile, 0, sizeof(profile));
+
+    pdata = network_create_pdata(&ctx->pdata->addrinfo, &profile);
+    if (!pdata)
+        return NULL;
+
+    cpy = iio_context_clone_metadata(ctx);
+    if (!cpy) {
+        ret = -errno;
+        network_free_pdata(pdata);
+        errno = -ret;
+        return NULL;
+    }
+
+    cpy->pdata = pdata;
+    pdata->max_conns = ctx->pdata->max_conns;
+
+    setup_ns = iio_time_ns();
+    ret = network_setup_devices(cpy);
+    if (ret < 0) {
+        iio_context_destroy(cpy);
+        errno = -ret;
+        return NULL;
+    }
+
+    iiod_client_set_timeout(pdata->iiod_client, &pdata->io_ctx,
+            calculate_remote_timeout(DEFAULT_TIMEOUT_MS));
+
+    cpy->profile = profile;
+    cpy->profile.phase_ns[IIO_CONTEXT_PHASE_SETUP] = iio_time_ns() - setup_ns;
+    cpy->profile.total_ns = iio_time_ns() - start_ns;
+    return cpy;
+}
+
+#ifdef WITH_NETWORK_COMPRESSION
+static int network_get_compression_stats(const struct iio_context *ctx,
+        struct iio_compression_stats *stats)
+{
+    struct iio_context_pdata *pdata = ctx->pdata;
+
+    /* The buffers use the client of the main connection */
+    iiod_client_get_compression_stats(pdata->iiod_client, stats);
+#ifdef WITH_NETWORK_EPOLL
+    stats->frames += __atomic_load_n(&pdata->async_stats.frames,
+            __ATOMIC_RELAXED);
+    stats->wire_bytes += __atomic_load_n(&pdata->async_stats.wire_bytes,
+            __ATOMIC_RELAXED);
+    stats->raw_bytes += __atomic_load_n(&pdata->async_stats.raw_bytes,
+            __ATOMIC_RELAXED);
+    stats->decode_ns += __atomic_load_n(&pdata->async_stats.decode_ns,
+            __ATOMIC_RELAXED);
+#endif
+    return 0;
+}
+#endif
+
+static int network_get_stats(const struct iio_context *ctx,
+        struct iio_context_stats *stats)
+{
+    const uint64_t *src = (const uint64_t *) &ctx->pdata->wire_stats;
+    uint64_t *dst = (uint64_t *) stats;
+    size_t i;
 
-    return iio_create_network_context(addr);
+    /* The counters are all 64-bit wide, and updated concurrently */
+    for (i = 0; i < sizeof(*stats) / sizeof(*dst); i++)
+        dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    return 0;
 }
 
 static const struct iio_backend_ops network_ops = {
@@ -1298,127 +2828,531 @@ static const struct iio_backend_ops network_ops = {
     .shutdown = network_shutdown,
     .get_version = network_get_version,
     .set_timeout = network_set_timeout,
+    .set_max_connections = network_set_max_connections,
+    .subscribe = network_subscribe,
     .set_kernel_buffers_count = network_set_kernel_buffers_count,
+    .prepare_attr = network_prepare_attr,
+    .read_attr_handle = network_read_attr_handle,
+#ifdef WITH_NETWORK_EPOLL
+    .get_async_fd = network_get_async_fd,
+    .process_async = network_process_async,
+    .cancel_async = network_cancel_async,
+    .read_async = network_read_async,
+    .read_attr_async = network_read_attr_async,
+    .write_attr_async = network_write_attr_async,
+    .read_attr_handle_async = network_read_attr_handle_async,
+#endif
+#ifdef WITH_NETWORK_COMPRESSION
+    .get_compression_stats = network_get_compression_stats,
+#endif
+    .get_stats = network_get_stats,
 
     .cancel = network_cancel,
 };
 
-static ssize_t network_write_data(struct iio_context_pdata *pdata,
+static ssize_t network_write_data(__notused struct iio_context_pdata *pdata,
         void *io_data, const char *src, size_t len)
 {
     struct iio_network_io_context *io_ctx = io_data;
 
-    return network_send(io_ctx, src, len, 0);
+    return network_send(io_ctx, src, len, 0);
+}
+
+/* Refills the receive buffer, once it has been consumed entirely */
+static ssize_t network_fill_rx_buf(struct iio_network_io_context *io_ctx)
+{
+    ssize_t ret;
+
+    ret = network_recv(io_ctx, io_ctx->rx_buf, RX_BUF_SIZE, 0);
+    if (ret < 0)
+        return ret;
+
+    io_ctx->rx_start = 0;
+    io_ctx->rx_end = (size_t) ret;
+    return ret;
+}
+
+static ssize_t network_read_data(__notused struct iio_context_pdata *pdata,
+        void *io_data, char *dst, size_t len)
+{
+    struct iio_network_io_context *io_ctx = io_data;
+    size_t avail;
+    ssize_t ret;
+
+    if (!io_ctx->buffered)
+        return network_recv(io_ctx, dst, len, 0);
+
+    avail = io_ctx->rx_end - io_ctx->rx_start;
+    if (!avail) {
+        /* Big payloads go straight to their destination */
+        if (len >= RX_BUF_SIZE)
+            return network_recv(io_ctx, dst, len, 0);
+
+        ret = network_fill_rx_buf(io_ctx);
+        if (ret < 0)
+            return ret;
+
+        avail = (size_t) ret;
+    }
+
+    if (len > avail)
+        len = avail;
+
+    memcpy(dst, io_ctx->rx_buf + io_ctx->rx_start, len);
+    io_ctx->rx_start += len;
+    return (ssize_t) len;
+}
+
+static ssize_t network_read_line_buffered(
+        struct iio_network_io_context *io_ctx, char *dst, size_t len)
+{
+    size_t bytes_read = 0;
+
+    while (bytes_read < len) {
+        size_t n = io_ctx->rx_end - io_ctx->rx_start;
+        const char *src, *eol;
+
+        if (!n) {
+            ssize_t ret = network_fill_rx_buf(io_ctx);
+            if (ret < 0)
+                return ret;
+
+            n = (size_t) ret;
+        }
+
+        if (n > len - bytes_read)
+            n = len - bytes_read;
+
+        src = io_ctx->rx_buf + io_ctx->rx_start;
+        eol = memchr(src, '\n', n);
+        if (eol)
+            n = (size_t) (eol - src) + 1;
+
+        memcpy(dst + bytes_read, src, n);
+        io_ctx->rx_start += n;
+        bytes_read += n;
+
+        if (eol)
+            return (ssize_t) bytes_read;
+    }
+
+    return -EIO;
+}
+
+static ssize_t network_read_line(struct iio_context_pdata *pdata,
+        void *io_data, char *dst, size_t len)
+{
+    bool found = false;
+    size_t i;
+#ifdef __linux__
+    struct iio_network_io_context *io_ctx = io_data;
+    ssize_t ret;
+    size_t bytes_read = 0;
+
+    if (io_ctx->buffered)
+        return network_read_line_buffered(io_ctx, dst, len);
+
+    do {
+        size_t to_trunc;
+
+        ret = network_recv(io_ctx, dst, len, MSG_PEEK);
+        if (ret < 0)
+            return ret;
+
+        /* Lookup for the trailing \n */
+        for (i = 0; i < (size_t) ret && dst[i] != '\n'; i++);
+        found = i < (size_t) ret;
+
+        len -= ret;
+        dst += ret;
+
+        if (found)
+            to_trunc = i + 1;
+        else
+            to_trunc = (size_t) ret;
+
+        /* Advance the read offset to the byte following the \n if
+         * found, or after the last charater read otherwise */
+        if (pdata->msg_trunc_supported)
+            ret = network_recv(io_ctx, NULL, to_trunc, MSG_TRUNC);
+        else
+            ret = network_recv(io_ctx, dst - ret, to_trunc, 0);
+        if (ret < 0)
+            return ret;
+
+        bytes_read += to_trunc;
+    } while (!found && len);
+
+    if (!found)
+        return -EIO;
+    else
+        return bytes_read;
+#else
+    struct iio_network_io_context *io_ctx = io_data;
+
+    if (io_ctx->buffered)
+        return network_read_line_buffered(io_ctx, dst, len);
+
+    for (i = 0; i < len - 1; i++) {
+        ssize_t ret = network_read_data(pdata, io_data, dst + i, 1);
+
+        if (ret < 0)
+            return ret;
+
+        if (dst[i] != '\n')
+            found = true;
+        else if (found)
+            break;
+    }
+
+    if (!found || i == len - 1)
+        return -EIO;
+
+    return (ssize_t) i + 1;
+#endif
+}
+
+static bool network_is_binary(__notused struct iio_context_pdata *pdata,
+        void *io_data)
+{
+    struct iio_network_io_context *io_ctx = io_data;
+
+    return io_ctx->binary;
+}
+
+static bool network_is_compressed(__notused struct iio_context_pdata *pdata,
+        void *io_data)
+{
+    struct iio_network_io_context *io_ctx = io_data;
+
+    return io_ctx->compressed;
+}
+
+static const struct iiod_client_ops network_iiod_client_ops = {
+    .write = network_write_data,
+    .read = network_read_data,
+    .read_line = network_read_line,
+    .is_binary = network_is_binary,
+    .is_compressed = network_is_compressed,
+    .begin_command = network_begin_command,
+};
+
+#ifdef __linux__
+/*
+ * As of build 16299, Windows Subsystem for Linux presents a Linux API but
+ * without support for MSG_TRUNC. Since WSL allows running native Linux
+ * applications this is not something that can be detected at compile time. If
+ * we want to support WSL we have to have a runtime workaround.
+ */
+static bool msg_trunc_supported(struct iio_network_io_context *io_ctx)
+{
+    int ret;
+
+    /* Not part of a command */
+    io_ctx->cmd_stats = NULL;
+    ret = network_recv(io_ctx, NULL, 0, MSG_TRUNC | MSG_DONTWAIT);
+
+    return ret != -EFAULT && ret != -EINVAL;
+}
+#else
+static bool msg_trunc_supported(struct iio_network_io_context *io_ctx)
+{
+    return false;
+}
+#endif
+
+/* Connects to the server; the durations of the connection and of the
+ * negotiation of the protocol are stored in 'profile' */
+static struct iio_context_pdata * network_create_pdata(
+        const struct addrinfo *addrinfo, struct iio_context_profile *profile)
+{
+    struct iio_context_pdata *pdata;
+    uint64_t start_ns;
+    int fd, ret;
+
+    if (addrinfo->ai_addrlen > sizeof(pdata->addr)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    start_ns = iio_time_ns();
+    fd = create_socket(addrinfo, DEFAULT_TIMEOUT_MS);
+    if (fd < 0) {
+        errno = -fd;
+        return NULL;
+    }
+
+    profile->phase_ns[IIO_CONTEXT_PHASE_CONNECT] = iio_time_ns() - start_ns;
+
+    pdata = zalloc(sizeof(*pdata));
+    if (!pdata) {
+        errno = ENOMEM;
+        goto err_close_socket;
+    }
+
+    pdata->io_ctx.fd = fd;
+    pdata->io_ctx.timeout_ms = DEFAULT_TIMEOUT_MS;
+    pdata->io_ctx.buffered = true;
+
+    pdata->addrinfo.ai_family = addrinfo->ai_family;
+    pdata->addrinfo.ai_socktype = addrinfo->ai_socktype;
+    pdata->addrinfo.ai_protocol = addrinfo->ai_protocol;
+    pdata->addrinfo.ai_addrlen = addrinfo->ai_addrlen;
+    pdata->addrinfo.ai_addr = (struct sockaddr *) &pdata->addr;
+    memcpy(&pdata->addr, addrinfo->ai_addr, addrinfo->ai_addrlen);
+
+    pdata->lock = iio_mutex_create();
+    if (!pdata->lock) {
+        errno = ENOMEM;
+        goto err_free_pdata;
+    }
+
+    pdata->iiod_client = iiod_client_new(pdata, pdata->lock,
+            &network_iiod_client_ops);
+    if (!pdata->iiod_client)
+        goto err_destroy_mutex;
+
+    start_ns = iio_time_ns();
+    ret = network_enable_extensions(pdata->iiod_client, &pdata->io_ctx);
+    if (ret < 0) {
+        errno = -ret;
+        goto err_destroy_client;
+    }
+
+    pdata->pool_lock = iio_mutex_create();
+    if (!pdata->pool_lock) {
+        errno = ENOMEM;
+        goto err_destroy_client;
+    }
+
+    pdata->conns = malloc(sizeof(*pdata->conns));
+    if (!pdata->conns) {
+        errno = ENOMEM;
+        goto err_destroy_pool_lock;
+    }
+
+    pdata->conns[0] = zalloc(sizeof(**pdata->conns));
+    if (!pdata->conns[0]) {
+        errno = ENOMEM;
+        goto err_free_conns;
+    }
+
+    pdata->conns[0]->io_ctx = &pdata->io_ctx;
+    pdata->conns[0]->lock = pdata->lock;
+    pdata->conns[0]->iiod_client = pdata->iiod_client;
+    pdata->nb_conns = 1;
+    pdata->max_conns = 1;
+#ifdef WITH_NETWORK_EPOLL
+    pdata->epoll_fd = -1;
+#endif
+
+    pdata->msg_trunc_supported = network_is_tcp(addrinfo) &&
+        msg_trunc_supported(&pdata->io_ctx);
+    if (pdata->msg_trunc_supported)
+        DEBUG("MSG_TRUNC is supported\n");
+    else
+        DEBUG("MSG_TRUNC is NOT supported\n");
+
+    profile->phase_ns[IIO_CONTEXT_PHASE_HANDSHAKE] = iio_time_ns() - start_ns;
+    return pdata;
+
+err_free_conns:
+    free(pdata->conns);
+err_destroy_pool_lock:
+    iio_mutex_destroy(pdata->pool_lock);
+err_destroy_client:
+    iiod_client_destroy(pdata->iiod_client);
+err_destroy_mutex:
+    iio_mutex_destroy(pdata->lock);
+err_free_pdata:
+    free(pdata);
+err_close_socket:
+    close(fd);
+    return NULL;
+}
+
+/* Releases a pdata not yet attached to a context */
+static void network_free_pdata(struct iio_context_pdata *pdata)
+{
+    free(pdata->conns[0]);
+    free(pdata->conns);
+    iio_mutex_destroy(pdata->pool_lock);
+    iiod_client_destroy(pdata->iiod_client);
+    iio_mutex_destroy(pdata->lock);
+    close(pdata->io_ctx.fd);
+    free(pdata);
 }
 
-static ssize_t network_read_data(struct iio_context_pdata *pdata,
-        void *io_data, char *dst, size_t len)
+static int network_setup_devices(struct iio_context *ctx)
 {
-    struct iio_network_io_context *io_ctx = io_data;
+    unsigned int i;
+
+    for (i = 0; i < ctx->nb_devices; i++) {
+        struct iio_device *dev = ctx->devices[i];
+
+        dev->pdata = zalloc(sizeof(*dev->pdata));
+        if (!dev->pdata)
+            return -ENOMEM;
+
+        dev->pdata->io_ctx.fd = -1;
+        dev->pdata->io_ctx.timeout_ms = DEFAULT_TIMEOUT_MS;
+#ifdef WITH_NETWORK_GET_BUFFER
+        dev->pdata->memfd = -1;
+#endif
+
+        dev->pdata->lock = iio_mutex_create();
+        if (!dev->pdata->lock) {
+            free(dev->pdata);
+            dev->pdata = NULL;
+            return -ENOMEM;
+        }
+    }
 
-    return network_recv(io_ctx, dst, len, 0);
+    return 0;
 }
 
-static ssize_t network_read_line(struct iio_context_pdata *pdata,
-        void *io_data, char *dst, size_t len)
+/*
+ * Connects to the server at the given address, and builds the context from
+ * the XML it sends. The given attribute, set to the description, tells how
+ * the server was reached. 'start_ns' is the time the creation started, the
+ * server being looked up since then.
+ */
+static struct iio_context * network_create_context_from_addrinfo(
+        const struct addrinfo *addrinfo, const char *attr,
+        const char *description, uint64_t start_ns)
 {
-    bool found = false;
-    size_t i;
-#ifdef __linux__
-    struct iio_network_io_context *io_ctx = io_data;
-    ssize_t ret;
-    size_t bytes_read = 0;
-
-    do {
-        size_t to_trunc;
+    struct iio_context_profile profile;
+    struct iio_context_pdata *pdata;
+    struct iio_context *ctx;
+    uint64_t setup_ns;
+    int ret;
 
-        ret = network_recv(io_ctx, dst, len, MSG_PEEK);
-        if (ret < 0)
-            return ret;
+    memset(&profile, 0, sizeof(profile));
+    profile.phase_ns[IIO_CONTEXT_PHASE_RESOLVE] = iio_time_ns() - start_ns;
 
-        /* Lookup for the trailing \n */
-        for (i = 0; i < (size_t) ret && dst[i] != '\n'; i++);
-        found = i < (size_t) ret;
+    pdata = network_create_pdata(addrinfo, &profile);
+    if (!pdata)
+        return NULL;
 
-        len -= ret;
-        dst += ret;
+    DEBUG("Creating context...\n");
+    ctx = iiod_client_create_context(pdata->iiod_client, &pdata->io_ctx);
+    if (!ctx) {
+        ret = -errno;
+        network_free_pdata(pdata);
+        errno = -ret;
+        return NULL;
+    }
 
-        if (found)
-            to_trunc = i + 1;
-        else
-            to_trunc = (size_t) ret;
+    /* Override the name and low-level functions of the XML context
+     * with those corresponding to the network context. From now on,
+     * destroying the context releases the pdata as well. */
+    ctx->name = "network";
+    ctx->ops = &network_ops;
+    ctx->pdata = pdata;
+    setup_ns = iio_time_ns();
 
-        /* Advance the read offset to the byte following the \n if
-         * found, or after the last charater read otherwise */
-        if (pdata->msg_trunc_supported)
-            ret = network_recv(io_ctx, NULL, to_trunc, MSG_TRUNC);
-        else
-            ret = network_recv(io_ctx, dst - ret, to_trunc, 0);
-        if (ret < 0)
-            return ret;
+    ret = iio_context_add_attr(ctx, attr, description);
+    if (ret < 0)
+        goto err_destroy_context;
 
-        bytes_read += to_trunc;
-    } while (!found && len);
+    ret = network_setup_devices(ctx);
+    if (ret < 0)
+        goto err_destroy_context;
 
-    if (!found)
-        return -EIO;
-    else
-        return bytes_read;
-#else
-    for (i = 0; i < len - 1; i++) {
-        ssize_t ret = network_read_data(pdata, io_data, dst + i, 1);
+    if (ctx->description) {
+        size_t new_size = strlen(description) +
+            strlen(ctx->description) + 2;
+        char *new_description = malloc(new_size);
+        if (!new_description) {
+            ret = -ENOMEM;
+            goto err_destroy_context;
+        }
 
-        if (ret < 0)
-            return ret;
+        iio_snprintf(new_description, new_size, "%s %s",
+                description, ctx->description);
+        free(ctx->description);
 
-        if (dst[i] != '\n')
-            found = true;
-        else if (found)
-            break;
+        ctx->description = new_description;
+    } else {
+        ctx->description = iio_strdup(description);
+        if (!ctx->description) {
+            ret = -ENOMEM;
+            goto err_destroy_context;
+        }
     }
 
-    if (!found || i == len - 1)
-        return -EIO;
+    iiod_client_set_timeout(pdata->iiod_client, &pdata->io_ctx,
+            calculate_remote_timeout(DEFAULT_TIMEOUT_MS));
 
-    return (ssize_t) i + 1;
-#endif
-}
+    /* The phases of the iiod client are already in the context */
+    ctx->profile.phase_ns[IIO_CONTEXT_PHASE_RESOLVE] =
+        profile.phase_ns[IIO_CONTEXT_PHASE_RESOLVE];
+    ctx->profile.phase_ns[IIO_CONTEXT_PHASE_CONNECT] =
+        profile.phase_ns[IIO_CONTEXT_PHASE_CONNECT];
+    ctx->profile.phase_ns[IIO_CONTEXT_PHASE_HANDSHAKE] =
+        profile.phase_ns[IIO_CONTEXT_PHASE_HANDSHAKE];
+    ctx->profile.phase_ns[IIO_CONTEXT_PHASE_SETUP] = iio_time_ns() - setup_ns;
+    ctx->profile.total_ns = iio_time_ns() - start_ns;
+    return ctx;
 
-static const struct iiod_client_ops network_iiod_client_ops = {
-    .write = network_write_data,
-    .read = network_read_data,
-    .read_line = network_read_line,
-};
+err_destroy_context:
+    iio_context_destroy(ctx);
+    errno = -ret;
+    return NULL;
+}
 
-#ifdef __linux__
-/*
- * As of build 16299, Windows Subsystem for Linux presents a Linux API but
- * without support for MSG_TRUNC. Since WSL allows running native Linux
- * applications this is not something that can be detected at compile time. If
- * we want to support WSL we have to have a runtime workaround.
- */
-static bool msg_trunc_supported(struct iio_network_io_context *io_ctx)
+/* Splits "host[:port]" or "[ipv6][:port]"; a bare IPv6 address, with
+ * several colons, takes no port. 'port' points into 'uri'. */
+static char * network_split_host(const char *uri, const char **port)
 {
-    int ret;
+    const char *end = uri + strlen(uri), *colon;
+    char *host;
 
-    ret = network_recv(io_ctx, NULL, 0, MSG_TRUNC | MSG_DONTWAIT);
+    *port = IIOD_PORT_STR;
 
-    return ret != -EFAULT && ret != -EINVAL;
-}
-#else
-static bool msg_trunc_supported(struct iio_network_io_context *io_ctx)
-{
-    return false;
+    if (uri[0] == '[') {
+        end = strchr(uri, ']');
+        if (!end || (end[1] && end[1] != ':'))
+            goto err_invalid;
+        if (end[1])
+            *port = end + 2;
+        uri++;
+    } else {
+        colon = strchr(uri, ':');
+        if (colon && !strchr(colon + 1, ':')) {
+            end = colon;
+            *port = colon + 1;
+        }
+    }
+
+    if (!**port)
+        goto err_invalid;
+
+    host = malloc((size_t) (end - uri) + 1);
+    if (!host) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    memcpy(host, uri, (size_t) (end - uri));
+    host[end - uri] = '\0';
+    return host;
+
+err_invalid:
+    ERROR("Invalid address, expected host[:port] or [ipv6][:port]\n");
+    errno = EINVAL;
+    return NULL;
 }
-#endif
 
-struct iio_context * network_create_context(const char *host)
+struct iio_context * network_create_context(const char *uri)
 {
+    uint64_t start_ns = iio_time_ns();
     struct addrinfo hints, *res;
-    struct iio_context *ctx;
-    struct iio_context_pdata *pdata;
-    size_t i, len;
-    int fd, ret;
+    struct iio_context *ctx = NULL;
+    const char *port = IIOD_PORT_STR;
+    char *host = NULL;
+    size_t len;
+    int ret;
     char *description;
 
 #ifdef _WIN32
@@ -1432,6 +3366,12 @@ struct iio_context * network_create_context(const char *host)
     }
 #endif
 
+    if (uri) {
+        host = network_split_host(uri, &port);
+        if (!host)
+            return NULL;
+    }
+
     memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_STREAM;
@@ -1460,8 +3400,9 @@ struct iio_context * network_create_context(const char *host)
     } else
 #endif
     {
-        ret = getaddrinfo(host, IIOD_PORT_STR, &hints, &res);
+        ret = getaddrinfo(host, port, &hints, &res);
     }
+    free(host);
 
     if (ret) {
         ERROR("Unable to find host: %s\n", gai_strerror(ret));
@@ -1472,51 +3413,6 @@ struct iio_context * network_create_context(const char *host)
         return NULL;
     }
 
-    fd = create_socket(res, DEFAULT_TIMEOUT_MS);
-    if (fd < 0) {
-        errno = -fd;
-        goto err_free_addrinfo;
-    }
-
-    pdata = zalloc(sizeof(*pdata));
-    if (!pdata) {
-        errno = ENOMEM;
-        goto err_close_socket;
-    }
-
-    pdata->io_ctx.fd = fd;
-    pdata->addrinfo = res;
-    pdata->io_ctx.timeout_ms = DEFAULT_TIMEOUT_MS;
-
-    pdata->lock = iio_mutex_create();
-    if (!pdata->lock) {
-        errno = ENOMEM;
-        goto err_free_pdata;
-    }
-
-    pdata->iiod_client = iiod_client_new(pdata, pdata->lock,
-            &network_iiod_client_ops);
-
-    pdata->msg_trunc_supported = msg_trunc_supported(&pdata->io_ctx);
-    if (pdata->msg_trunc_supported)
-        DEBUG("MSG_TRUNC is supported\n");
-    else
-        DEBUG("MSG_TRUNC is NOT supported\n");
-
-    if (!pdata->iiod_client)
-        goto err_destroy_mutex;
-
-    DEBUG("Creating context...\n");
-    ctx = iiod_client_create_context(pdata->iiod_client, &pdata->io_ctx);
-    if (!ctx)
-        goto err_destroy_iiod_client;
-
-    /* Override the name and low-level functions of the XML context
-     * with those corresponding to the network context */
-    ctx->name = "network";
-    ctx->ops = &network_ops;
-    ctx->pdata = pdata;
-
 #ifdef HAVE_IPV6
     len = INET6_ADDRSTRLEN + IF_NAMESIZE + 2;
 #else
@@ -1525,8 +3421,8 @@ struct iio_context * network_create_context(const char *host)
 
     description = malloc(len);
     if (!description) {
-        ret = -ENOMEM;
-        goto err_network_shutdown;
+        errno = ENOMEM;
+        goto err_free_addrinfo;
     }
 
     description[0] = '\0';
@@ -1544,7 +3440,9 @@ struct iio_context * network_create_context(const char *host)
             if (!ptr) {
                 ret = -errno;
                 ERROR("Unable to lookup interface of IPv6 address\n");
-                goto err_free_description;
+                free(description);
+                errno = -ret;
+                goto err_free_addrinfo;
             }
 
             *(ptr - 1) = '%';
@@ -1561,72 +3459,92 @@ struct iio_context * network_create_context(const char *host)
 #endif
     }
 
-    ret = iio_context_add_attr(ctx, "ip,ip-addr", description);
-    if (ret < 0)
-        goto err_free_description;
-
-    for (i = 0; i < ctx->nb_devices; i++) {
-        struct iio_device *dev = ctx->devices[i];
+    ctx = network_create_context_from_addrinfo(res,
+            "ip,ip-addr", description, start_ns);
+    free(description);
+err_free_addrinfo:
+    freeaddrinfo(res);
+    return ctx;
+}
 
-        dev->pdata = zalloc(sizeof(*dev->pdata));
-        if (!dev->pdata) {
-            ret = -ENOMEM;
-            goto err_free_description;
-        }
+#ifdef WITH_NETWORK_VSOCK
+/* Parses "cid[:port]" */
+struct iio_context * network_create_vsock_context(const char *uri)
+{
+    uint64_t start_ns = iio_time_ns();
+    struct sockaddr_vm addr;
+    struct addrinfo addrinfo;
+    char description[sizeof("4294967295:4294967295")];
+    unsigned long cid, port = IIOD_PORT;
+    char *end;
 
-        dev->pdata->io_ctx.fd = -1;
-        dev->pdata->io_ctx.timeout_ms = DEFAULT_TIMEOUT_MS;
-#ifdef WITH_NETWORK_GET_BUFFER
-        dev->pdata->memfd = -1;
-#endif
+    errno = 0;
+    cid = strtoul(uri, &end, 10);
+    if (end != uri && *end == ':') {
+        uri = end + 1;
+        port = strtoul(uri, &end, 10);
+    }
 
-        dev->pdata->lock = iio_mutex_create();
-        if (!dev->pdata->lock) {
-            ret = -ENOMEM;
-            goto err_free_description;
-        }
+    if (errno || end == uri || *end || cid > UINT32_MAX || port > UINT32_MAX) {
+        ERROR("Invalid vsock address, expected cid[:port]\n");
+        errno = EINVAL;
+        return NULL;
     }
 
-    if (ctx->description) {
-        size_t desc_len = strlen(description);
-        size_t new_size = desc_len + strlen(ctx->description) + 2;
-        char *ptr, *new_description = realloc(description, new_size);
-        if (!new_description) {
-            ret = -ENOMEM;
-            goto err_free_description;
-        }
+    memset(&addr, 0, sizeof(addr));
+    addr.svm_family = AF_VSOCK;
+    addr.svm_cid = (unsigned int) cid;
+    addr.svm_port = (unsigned int) port;
 
-        ptr = strrchr(new_description, '\0');
-        iio_snprintf(ptr, new_size - desc_len, " %s", ctx->description);
-        free(ctx->description);
+    memset(&addrinfo, 0, sizeof(addrinfo));
+    addrinfo.ai_family = AF_VSOCK;
+    addrinfo.ai_socktype = SOCK_STREAM;
+    addrinfo.ai_addrlen = sizeof(addr);
+    addrinfo.ai_addr = (struct sockaddr *) &addr;
 
-        ctx->description = new_description;
-    } else {
-        ctx->description = description;
+    iio_snprintf(description, sizeof(description), "%lu:%lu", cid, port);
+
+    return network_create_context_from_addrinfo(&addrinfo,
+            "vsock,addr", description, start_ns);
+}
+#endif /* WITH_NETWORK_VSOCK */
+
+#ifdef WITH_NETWORK_UNIX
+struct iio_context * network_create_unix_context(const char *path)
+{
+    uint64_t start_ns = iio_time_ns();
+    struct sockaddr_un addr;
+    struct addrinfo addrinfo;
+    size_t len = strlen(path);
+
+    if (!len) {
+        errno = EINVAL;
+        return NULL;
     }
 
-    iiod_client_set_timeout(pdata->iiod_client, &pdata->io_ctx,
-            calculate_remote_timeout(DEFAULT_TIMEOUT_MS));
-    return ctx;
+    if (len >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
 
-err_free_description:
-    free(description);
-err_network_shutdown:
-    close(fd);
-    freeaddrinfo(res);
-    iio_context_destroy(ctx);
-    errno = -ret;
-    return NULL;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, len);
 
-err_destroy_iiod_client:
-    iiod_client_destroy(pdata->iiod_client);
-err_destroy_mutex:
-    iio_mutex_destroy(pdata->lock);
-err_free_pdata:
-    free(pdata);
-err_close_socket:
-    close(fd);
-err_free_addrinfo:
-    freeaddrinfo(res);
-    return NULL;
+    /* Abstract sockets are named by the bytes after a leading NUL,
+     * without any terminating one */
+    if (path[0] == '@')
+        addr.sun_path[0] = '\0';
+    else
+        len++;
+
+    memset(&addrinfo, 0, sizeof(addrinfo));
+    addrinfo.ai_family = AF_UNIX;
+    addrinfo.ai_socktype = SOCK_STREAM;
+    addrinfo.ai_addrlen = offsetof(struct sockaddr_un, sun_path) + len;
+    addrinfo.ai_addr = (struct sockaddr *) &addr;
+
+    return network_create_context_from_addrinfo(&addrinfo,
+            "unix,path", path, start_ns);
 }
+#endif /* WITH_NETWORK_UNIX */
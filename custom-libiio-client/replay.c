@@ -0,0 +1,972 @@
+/*
+ * libiio - Library for interfacing industrial I/O (IIO) devices
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "iio-config.h"
+#include "iio-lock.h"
+#include "iio-private.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+
+/*
+ * Layout of a recording.
+ *
+ * A recording starts with a replay_header, followed by the XML of the
+ * context, then by one record per attribute read or buffer block received
+ * by the application, in the order they completed. Each record is a
+ * replay_record followed by its payload:
+ *
+ *  - REPLAY_ATTR: the name of the attribute (name_len bytes, without '\0'),
+ *    then the value returned by the read;
+ *  - REPLAY_BLOCK: the channel mask of the buffer, one 32-bit word per
+ *    word of the device, then the samples.
+ *
+ * Integers are in the byte order of the recording machine. Timestamps count
+ * the nanoseconds elapsed since the recording started. A record cut short
+ * at the end of the file (the application died while recording) is ignored.
+ */
+
+#define REPLAY_MAGIC 0x524f4949 /* "IIOR" */
+#define REPLAY_VERSION 1
+
+enum replay_record_type {
+    REPLAY_ATTR,
+    REPLAY_BLOCK,
+};
+
+struct replay_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t xml_len;
+    uint32_t reserved;
+};
+
+struct replay_record {
+    uint64_t timestamp_ns;
+    uint32_t len;           /* Length of the payload */
+    uint16_t dev;           /* Index of the device in the context */
+    int16_t chn;            /* ATTR: index of the channel, or -1 */
+    uint8_t type;
+    uint8_t attr_type;      /* ATTR: enum iio_attr_type, for devices */
+    uint16_t name_len;      /* ATTR: length of the attribute's name */
+    uint32_t reserved;
+};
+
+static int replay_device_index(const struct iio_device *dev)
+{
+    const struct iio_context *ctx = dev->ctx;
+    unsigned int i;
+
+    for (i = 0; i < ctx->nb_devices; i++)
+        if (ctx->devices[i] == dev)
+            return (int) i;
+    return -1;
+}
+
+static int replay_channel_index(const struct iio_channel *chn)
+{
+    const struct iio_device *dev = chn->dev;
+    unsigned int i;
+
+    for (i = 0; i < dev->nb_channels; i++)
+        if (dev->channels[i] == chn)
+            return (int) i;
+    return -1;
+}
+
+/* ------------------------------ Recording --------------------------------*/
+
+struct iio_recorder {
+    /* Operations of the context while recording: the ones of the backend,
+     * the reads being wrapped. Must stay first. */
+    struct iio_backend_ops ops;
+    const struct iio_backend_ops *backend;
+
+    struct iio_mutex *lock;
+    FILE *f;
+    uint64_t start_ns;
+};
+
+/* Completion of an asynchronous read made while recording */
+struct recorder_async {
+    struct iio_recorder *rec;
+    const struct iio_device *dev;
+    const struct iio_channel *chn;
+    char *attr; /* NULL for a buffer refill */
+    enum iio_attr_type type;
+    const char *dst;
+    uint32_t *mask;
+
+    void (*done)(ssize_t ret, void *d);
+    void *d;
+};
+
+static struct iio_recorder * get_recorder(const struct iio_context *ctx)
+{
+    return (struct iio_recorder *) ctx->ops;
+}
+
+static bool recorder_write(FILE *f, const void *src, size_t len)
+{
+    return !len || fwrite(src, len, 1, f) == 1;
+}
+
+static void recorder_append(struct iio_recorder *rec,
+        struct replay_record *r, const void *src1, size_t len1,
+        const void *src2, size_t len2)
+{
+    r->len = (uint32_t) (len1 + len2);
+
+    iio_mutex_lock(rec->lock);
+    if (rec->f) {
+        /* Timestamped under the lock, so that they never go backwards */
+        r->timestamp_ns = iio_time_ns() - rec->start_ns;
+
+        if (!recorder_write(rec->f, r, sizeof(*r)) ||
+                !recorder_write(rec->f, src1, len1) ||
+                !recorder_write(rec->f, src2, len2)) {
+            WARNING("Recording stopped: unable to write\n");
+            fclose(rec->f);
+            rec->f = NULL;
+        }
+    }
+    iio_mutex_unlock(rec->lock);
+}
+
+static void recorder_add_attr(struct iio_recorder *rec,
+        const struct iio_device *dev, const struct iio_channel *chn,
+        const char *attr, enum iio_attr_type type,
+        const char *value, size_t len)
+{
+    struct replay_record r;
+    size_t name_len = strlen(attr);
+
+    if (name_len > UINT16_MAX)
+        return;
+
+    memset(&r, 0, sizeof(r));
+    r.type = REPLAY_ATTR;
+    r.dev = (uint16_t) replay_device_index(dev);
+    r.chn = (int16_t) (chn ? replay_channel_index(chn) : -1);
+    r.attr_type = (uint8_t) type;
+    r.name_len = (uint16_t) name_len;
+
+    recorder_append(rec, &r, attr, name_len, value, len);
+}
+
+static void recorder_add_block(struct iio_recorder *rec,
+        const struct iio_device *dev, const uint32_t *mask,
+        const void *data, size_t len)
+{
+    struct replay_record r;
+
+    if (iio_device_is_tx(dev))
+        return;
+
+    memset(&r, 0, sizeof(r));
+    r.type = REPLAY_BLOCK;
+    r.dev = (uint16_t) replay_device_index(dev);
+
+    recorder_append(rec, &r, mask, dev->words * sizeof(*mask), data, len);
+}
+
+static ssize_t recorder_read(const struct iio_device *dev,
+        void *dst, size_t len, uint32_t *mask, size_t words)
+{
+    struct iio_recorder *rec = get_recorder(dev->ctx);
+    ssize_t ret = rec->backend->read(dev, dst, len, mask, words);
+
+    if (ret > 0 && words == dev->words)
+        recorder_add_block(rec, dev, mask, dst, (size_t) ret);
+    return ret;
+}
+
+static ssize_t recorder_get_buffer(const struct iio_device *dev,
+        void **addr_ptr, size_t bytes_used, uint32_t *mask, size_t words)
+{
+    struct iio_recorder *rec = get_recorder(dev->ctx);
+    ssize_t ret = rec->backend->get_buffer(dev, addr_ptr,
+            bytes_used, mask, words);
+
+    if (ret > 0 && addr_ptr && words == dev->words)
+        recorder_add_block(rec, dev, mask, *addr_ptr, (size_t) ret);
+    return ret;
+}
+
+static ssize_t recorder_read_device_attr(const struct iio_device *dev,
+        const char *attr, char *dst, size_t len, enum iio_attr_type type)
+{
+    struct iio_recorder *rec = get_recorder(dev->ctx);
+    ssize_t ret = rec->backend->read_device_attr(dev, attr, dst, len, type);
+
+    if (ret > 0)
+        recorder_add_attr(rec, dev, NULL, attr, type, dst, (size_t) ret);
+    return ret;
+}
+
+static ssize_t recorder_read_channel_attr(const struct iio_channel *chn,
+        const char *attr, char *dst, size_t len)
+{
+    struct iio_recorder *rec = get_recorder(chn->dev->ctx);
+    ssize_t ret = rec->backend->read_channel_attr(chn, attr, dst, len);
+
+    if (ret > 0)
+        recorder_add_attr(rec, chn->dev, chn, attr,
+                IIO_ATTR_TYPE_DEVICE, dst, (size_t) ret);
+    return ret;
+}
+
+static ssize_t recorder_read_attr_handle(const struct iio_attr_handle *handle,
+        char *dst, size_t len)
+{
+    struct iio_recorder *rec = get_recorder(handle->dev->ctx);
+    ssize_t ret = rec->backend->read_attr_handle(handle, dst, len);
+
+    if (ret > 0)
+        recorder_add_attr(rec, handle->dev, handle->chn, handle->attr,
+                handle->type, dst, (size_t) ret);
+    return ret;
+}
+
+static void recorder_async_done(ssize_t ret, void *d)
+{
+    struct recorder_async *op = d;
+
+    if (ret > 0 && op->attr)
+        recorder_add_attr(op->rec, op->dev, op->chn, op->attr,
+                op->type, op->dst, (size_t) ret);
+    else if (ret > 0)
+        recorder_add_block(op->rec, op->dev, op->mask,
+                op->dst, (size_t) ret);
+
+    op->done(ret, op->d);
+    free(op->attr);
+    free(op);
+}
+
+static struct recorder_async * recorder_async_new(
+        const struct iio_device *dev, const struct iio_channel *chn,
+        const char *attr, enum iio_attr_type type, const char *dst,
+        void (*done)(ssize_t ret, void *d), void *d)
+{
+    struct recorder_async *op = zalloc(sizeof(*op));
+
+    if (!op)
+        return NULL;
+
+    /* The name may not outlive the call */
+    if (attr) {
+        op->attr = iio_strdup(attr);
+        if (!op->attr) {
+            free(op);
+            return NULL;
+        }
+    }
+
+    op->rec = get_recorder(dev->ctx);
+    op->dev = dev;
+    op->chn = chn;
+    op->type = type;
+    op->dst = dst;
+    op->done = done;
+    op->d = d;
+    return op;
+}
+
+static int recorder_async_submitted(struct recorder_async *op, int ret)
+{
+    if (ret < 0) {
+        free(op->attr);
+        free(op);
+    }
+    return ret;
+}
+
+static int recorder_read_async(const struct iio_device *dev,
+        void *dst, size_t len, uint32_t *mask, size_t words,
+        void (*done)(ssize_t ret, void *d), void *d)
+{
+    struct recorder_async *op;
+
+    if (words != dev->words)
+        return -EINVAL;
+
+    op = recorder_async_new(dev, NULL, NULL, 0, dst, done, d);
+    if (!op)
+        return -ENOMEM;
+
+    op->mask = mask;
+    return recorder_async_submitted(op, op->rec->backend->read_async(dev,
+                dst, len, mask, words, recorder_async_done, op));
+}
+
+static int recorder_read_attr_async(const struct iio_device *dev,
+        const struct iio_channel *chn, const char *attr,
+        enum iio_attr_type type, char *dst, size_t len,
+        void (*done)(ssize_t ret, void *d), void *d)
+{
+    struct recorder_async *op;
+
+    op = recorder_async_new(dev, chn, attr, type, dst, done, d);
+    if (!op)
+        return -ENOMEM;
+
+    return recorder_async_submitted(op, op->rec->backend->read_attr_async(
+                dev, chn, attr, type, dst, len, recorder_async_done, op));
+}
+
+static int recorder_read_attr_handle_async(
+        const struct iio_attr_handle *handle, char *dst, size_t len,
+        void (*done)(ssize_t ret, void *d), void *d)
+{
+    struct recorder_async *op;
+
+    op = recorder_async_new(handle->dev, handle->chn, handle->attr,
+            handle->type, dst, done, d);
+    if (!op)
+        return -ENOMEM;
+
+    return recorder_async_submitted(op,
+            op->rec->backend->read_attr_handle_async(handle, dst, len,
+                recorder_async_done, op));
+}
+
+static void recorder_shutdown(struct iio_context *ctx)
+{
+    struct iio_recorder *rec = get_recorder(ctx);
+
+    ctx->ops = rec->backend;
+    if (ctx->ops->shutdown)
+        ctx->ops->shutdown(ctx);
+
+    if (rec->f && fclose(rec->f))
+        WARNING("Recording incomplete: unable to write\n");
+
+    iio_mutex_destroy(rec->lock);
+    free(rec);
+}
+
+int iio_context_start_recording(struct iio_context *ctx, const char *path)
+{
+    const char *xml = iio_context_get_xml(ctx);
+    const struct iio_backend_ops *backend = ctx->ops;
+    struct replay_header hdr;
+    struct iio_recorder *rec;
+    int ret;
+
+    if (backend->shutdown == recorder_shutdown)
+        return -EBUSY;
+
+    /* The XML is only generated on request, which can fail */
+    if (!xml)
+        return -ENOMEM;
+
+    rec = zalloc(sizeof(*rec));
+    if (!rec)
+        return -ENOMEM;
+
+    rec->lock = iio_mutex_create();
+    if (!rec->lock) {
+        ret = -ENOMEM;
+        goto err_free_rec;
+    }
+
+    rec->f = fopen(path, "we");
+    if (!rec->f) {
+        ret = -errno;
+        goto err_destroy_mutex;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = REPLAY_MAGIC;
+    hdr.version = REPLAY_VERSION;
+    hdr.xml_len = (uint32_t) strlen(xml);
+
+    if (!recorder_write(rec->f, &hdr, sizeof(hdr)) ||
+            !recorder_write(rec->f, xml, hdr.xml_len)) {
+        ret = -EIO;
+        goto err_close_file;
+    }
+
+    rec->backend = backend;
+    rec->ops = *backend;
+    rec->ops.shutdown = recorder_shutdown;
+
+    if (backend->read)
+        rec->ops.read = recorder_read;
+    if (backend->get_buffer)
+        rec->ops.get_buffer = recorder_get_buffer;
+    if (backend->read_device_attr)
+        rec->ops.read_device_attr = recorder_read_device_attr;
+    if (backend->read_channel_attr)
+        rec->ops.read_channel_attr = recorder_read_channel_attr;
+    if (backend->read_attr_handle)
+        rec->ops.read_attr_handle = recorder_read_attr_handle;
+    if (backend->read_async)
+        rec->ops.read_async = recorder_read_async;
+    if (backend->read_attr_async)
+        rec->ops.read_attr_async = recorder_read_attr_async;
+    if (backend->read_attr_handle_async)
+        rec->ops.read_attr_handle_async = recorder_read_attr_handle_async;
+
+    rec->start_ns = iio_time_ns();
+    ctx->ops = &rec->ops;
+    return 0;
+
+err_close_file:
+    fclose(rec->f);
+    unlink(path);
+err_destroy_mutex:
+    iio_mutex_destroy(rec->lock);
+err_free_rec:
+    free(rec);
+    return ret;
+}
+
+/* -------------------------------- Replay ---------------------------------*/
+
+/* Offsets of the records of a stream, in the order they were recorded */
+struct replay_index {
+    size_t *offsets;
+    unsigned int nb, size, next;
+};
+
+/* The successive values of one attribute */
+struct replay_stream {
+    int chn;
+    enum iio_attr_type type;
+    const char *name;
+    size_t name_len;
+    struct replay_index index;
+};
+
+struct iio_context_pdata {
+    void *base;
+    size_t size;
+    char *uri;
+
+    /* Records are served no earlier than their timestamp divided by the
+     * speed, counted from the creation of the context; 0 disables it */
+    double speed;
+    uint64_t start_ns;
+
+    /* Protects the positions in the streams */
+    struct iio_mutex *lock;
+};
+
+struct iio_device_pdata {
+    struct replay_stream *streams;
+    unsigned int nb_streams;
+    struct replay_index blocks;
+    bool opened, blocking;
+};
+
+static int replay_index_add(struct replay_index *index, size_t offset)
+{
+    if (index->nb == index->size) {
+        unsigned int size = index->size ? index->size * 2 : 16;
+        size_t *offsets = realloc(index->offsets,
+                size * sizeof(*offsets));
+
+        if (!offsets)
+            return -ENOMEM;
+
+        index->offsets = offsets;
+        index->size = size;
+    }
+
+    index->offsets[index->nb++] = offset;
+    return 0;
+}
+
+static const struct replay_record * replay_get_record(
+        const struct iio_context_pdata *pdata, size_t offset,
+        struct replay_record *r)
+{
+    /* Records are not aligned */
+    memcpy(r, (const char *) pdata->base + offset, sizeof(*r));
+    return r;
+}
+
+static const char * replay_get_payload(const struct iio_context_pdata *pdata,
+        size_t offset)
+{
+    return (const char *) pdata->base + offset +
+        sizeof(struct replay_record);
+}
+
+static struct replay_stream * replay_find_stream(
+        const struct iio_device_pdata *pdata, int chn,
+        const char *name, size_t name_len, enum iio_attr_type type)
+{
+    unsigned int i;
+
+    for (i = 0; i < pdata->nb_streams; i++) {
+        struct replay_stream *stream = &pdata->streams[i];
+
+        if (stream->chn == chn && (chn >= 0 || stream->type == type) &&
+                stream->name_len == name_len &&
+                !memcmp(stream->name, name, name_len))
+            return stream;
+    }
+
+    return NULL;
+}
+
+static int replay_add_attr(struct iio_context_pdata *pdata,
+        struct iio_device_pdata *dpdata, const struct replay_record *r,
+        size_t offset)
+{
+    const char *name = replay_get_payload(pdata, offset);
+    enum iio_attr_type type = (enum iio_attr_type) r->attr_type;
+    struct replay_stream *stream;
+
+    stream = replay_find_stream(dpdata, r->chn, name, r->name_len, type);
+    if (!stream) {
+        struct replay_stream *streams = realloc(dpdata->streams,
+                (dpdata->nb_streams + 1) * sizeof(*streams));
+
+        if (!streams)
+            return -ENOMEM;
+
+        dpdata->streams = streams;
+        stream = &streams[dpdata->nb_streams++];
+        memset(stream, 0, sizeof(*stream));
+        stream->chn = r->chn;
+        stream->type = type;
+        stream->name = name;
+        stream->name_len = r->name_len;
+    }
+
+    return replay_index_add(&stream->index, offset);
+}
+
+/* Indexes the records per device and per attribute */
+static int replay_load(struct iio_context *ctx, size_t offset)
+{
+    struct iio_context_pdata *pdata = ctx->pdata;
+    struct replay_record r;
+    int ret;
+
+    while (pdata->size - offset >= sizeof(r)) {
+        const struct iio_device *dev;
+
+        replay_get_record(pdata, offset, &r);
+        if (r.len > pdata->size - offset - sizeof(r))
+            break;
+
+        if (r.dev >= ctx->nb_devices)
+            return -EINVAL;
+        dev = ctx->devices[r.dev];
+
+        switch (r.type) {
+        case REPLAY_ATTR:
+            if (r.name_len > r.len || r.chn < -1 ||
+                    r.chn >= (int) dev->nb_channels)
+                return -EINVAL;
+            ret = replay_add_attr(pdata, dev->pdata, &r, offset);
+            break;
+        case REPLAY_BLOCK:
+            if (r.len < dev->words * sizeof(uint32_t))
+                return -EINVAL;
+            ret = replay_index_add(&dev->pdata->blocks, offset);
+            break;
+        default:
+            return -EINVAL;
+        }
+
+        if (ret < 0)
+            return ret;
+
+        offset += sizeof(r) + r.len;
+    }
+
+    if (offset != pdata->size)
+        WARNING("Ignoring the truncated end of the recording\n");
+    return 0;
+}
+
+/* Waits until the record is due; returns -EAGAIN instead if not blocking */
+static int replay_wait(const struct iio_context_pdata *pdata,
+        const struct replay_record *r, bool blocking)
+{
+    struct timespec ts;
+    uint64_t due;
+
+    if (pdata->speed <= 0)
+        return 0;
+
+    due = pdata->start_ns + (uint64_t) (r->timestamp_ns / pdata->speed);
+    if (iio_time_ns() >= due)
+        return 0;
+    if (!blocking)
+        return -EAGAIN;
+
+    ts.tv_sec = (time_t) (due / 1000000000ULL);
+    ts.tv_nsec = (long) (due % 1000000000ULL);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+    return 0;
+}
+
+/*
+ * Serves the recorded values of an attribute one after the other, each one
+ * when it is due. Once they have all been served, the last one is returned
+ * right away, so that the attributes read only once while recording remain
+ * readable.
+ */
+static ssize_t replay_read_attr(const struct iio_device *dev, int chn,
+        const char *attr, enum iio_attr_type type, char *dst, size_t len)
+{
+    struct iio_context_pdata *pdata = dev->ctx->pdata;
+    struct replay_stream *stream;
+    struct replay_record r;
+    const char *value;
+    size_t offset, value_len;
+    bool last;
+
+    stream = replay_find_stream(dev->pdata, chn, attr, strlen(attr), type);
+    if (!stream)
+        return -ENOENT;
+
+    iio_mutex_lock(pdata->lock);
+    last = stream->index.next == stream->index.nb;
+    if (last)
+        offset = stream->index.offsets[stream->index.nb - 1];
+    else
+        offset = stream->index.offsets[stream->index.next++];
+    iio_mutex_unlock(pdata->lock);
+
+    replay_get_record(pdata, offset, &r);
+    value = replay_get_payload(pdata, offset) + r.name_len;
+    value_len = r.len - r.name_len;
+
+    if (value_len > len)
+        return -EIO;
+
+    if (!last)
+        replay_wait(pdata, &r, true);
+
+    memcpy(dst, value, value_len);
+    if (value_len < len)
+        dst[value_len] = '\0';
+    return (ssize_t) value_len;
+}
+
+static ssize_t replay_read_dev_attr(const struct iio_device *dev,
+        const char *attr, char *dst, size_t len, enum iio_attr_type type)
+{
+    return replay_read_attr(dev, -1, attr, type, dst, len);
+}
+
+static ssize_t replay_read_chn_attr(const struct iio_channel *chn,
+        const char *attr, char *dst, size_t len)
+{
+    return replay_read_attr(chn->dev, replay_channel_index(chn), attr,
+            IIO_ATTR_TYPE_DEVICE, dst, len);
+}
+
+/* Writes are accepted and dropped: the recording holds what was read back */
+static ssize_t replay_write_dev_attr(__notused const struct iio_device *dev,
+        __notused const char *attr, __notused const char *src, size_t len,
+        __notused enum iio_attr_type type)
+{
+    return (ssize_t) len;
+}
+
+static ssize_t replay_write_chn_attr(__notused const struct iio_channel *chn,
+        __notused const char *attr, __notused const char *src, size_t len)
+{
+    return (ssize_t) len;
+}
+
+static int replay_open(const struct iio_device *dev,
+        __notused size_t samples_count, bool cyclic)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+
+    if (cyclic || iio_device_is_tx(dev))
+        return -ENOSYS;
+    if (pdata->opened)
+        return -EBUSY;
+
+    pdata->opened = true;
+    return 0;
+}
+
+static int replay_close(const struct iio_device *dev)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+
+    if (!pdata->opened)
+        return -EBADF;
+
+    pdata->opened = false;
+    return 0;
+}
+
+static int replay_set_blocking_mode(const struct iio_device *dev,
+        bool blocking)
+{
+    dev->pdata->blocking = blocking;
+    return 0;
+}
+
+/* Serves the recorded blocks one after the other, each one when it is due,
+ * and -ENODATA once they have all been served */
+static ssize_t replay_read(const struct iio_device *dev,
+        void *dst, size_t len, uint32_t *mask, size_t words)
+{
+    struct iio_context_pdata *pdata = dev->ctx->pdata;
+    struct replay_index *blocks = &dev->pdata->blocks;
+    struct replay_record r;
+    const char *payload;
+    size_t offset, mask_len = dev->words * sizeof(*mask);
+    int ret;
+
+    if (!dev->pdata->opened)
+        return -EBADF;
+    if (words != dev->words)
+        return -EINVAL;
+
+    iio_mutex_lock(pdata->lock);
+    if (blocks->next == blocks->nb) {
+        iio_mutex_unlock(pdata->lock);
+        return -ENODATA;
+    }
+
+    offset = blocks->offsets[blocks->next];
+    replay_get_record(pdata, offset, &r);
+
+    ret = replay_wait(pdata, &r, false);
+    if (ret < 0 && !dev->pdata->blocking) {
+        iio_mutex_unlock(pdata->lock);
+        return ret;
+    }
+
+    blocks->next++;
+    iio_mutex_unlock(pdata->lock);
+
+    if (ret < 0)
+        replay_wait(pdata, &r, true);
+
+    payload = replay_get_payload(pdata, offset);
+    if (r.len - mask_len < len)
+        len = r.len - mask_len;
+
+    memcpy(mask, payload, mask_len);
+    memcpy(dst, payload + mask_len, len);
+    return (ssize_t) len;
+}
+
+/* The waits only depend on the recording */
+static int replay_set_timeout(__notused struct iio_context *ctx,
+        __notused unsigned int timeout)
+{
+    return 0;
+}
+
+static void replay_shutdown(struct iio_context *ctx)
+{
+    struct iio_context_pdata *pdata = ctx->pdata;
+    unsigned int i, j;
+
+    for (i = 0; i < ctx->nb_devices; i++) {
+        struct iio_device_pdata *dpdata = ctx->devices[i]->pdata;
+
+        if (!dpdata)
+            continue;
+
+        for (j = 0; j < dpdata->nb_streams; j++)
+            free(dpdata->streams[j].index.offsets);
+        free(dpdata->streams);
+        free(dpdata->blocks.offsets);
+        free(dpdata);
+    }
+
+    munmap(pdata->base, pdata->size);
+    iio_mutex_destroy(pdata->lock);
+    free(pdata->uri);
+    free(pdata);
+}
+
+static struct iio_context * replay_clone(const struct iio_context *ctx)
+{
+    return replay_create_context(ctx->pdata->uri);
+}
+
+static const struct iio_backend_ops replay_ops = {
+    .clone = replay_clone,
+    .open = replay_open,
+    .close = replay_close,
+    .read = replay_read,
+    .set_blocking_mode = replay_set_blocking_mode,
+    .read_device_attr = replay_read_dev_attr,
+    .write_device_attr = replay_write_dev_attr,
+    .read_channel_attr = replay_read_chn_attr,
+    .write_channel_attr = replay_write_chn_attr,
+    .shutdown = replay_shutdown,
+    .set_timeout = replay_set_timeout,
+};
+
+/* Splits "path[?speed=factor]" */
+static int replay_parse_uri(char *uri, double *speed)
+{
+    char *opt = strrchr(uri, '?'), *end;
+
+    *speed = 1.0;
+    if (!opt)
+        return 0;
+    if (strncmp(opt + 1, "speed=", sizeof("speed=") - 1))
+        return -EINVAL;
+
+    *speed = strtod(opt + sizeof("?speed=") - 1, &end);
+    if (end == opt + sizeof("?speed=") - 1 || *end || *speed < 0)
+        return -EINVAL;
+
+    *opt = '\0';
+    return 0;
+}
+
+struct iio_context * replay_create_context(const char *uri)
+{
+    const struct replay_header *hdr;
+    struct iio_context_pdata *pdata;
+    struct iio_context *ctx;
+    char *path;
+    struct stat st;
+    unsigned int i;
+    int fd, ret;
+
+    pdata = zalloc(sizeof(*pdata));
+    if (!pdata) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pdata->uri = iio_strdup(uri);
+    path = iio_strdup(uri);
+    if (!pdata->uri || !path) {
+        ret = -ENOMEM;
+        goto err_free_path;
+    }
+
+    ret = replay_parse_uri(path, &pdata->speed);
+    if (ret < 0)
+        goto err_free_path;
+
+    pdata->lock = iio_mutex_create();
+    if (!pdata->lock) {
+        ret = -ENOMEM;
+        goto err_free_path;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ret = -errno;
+        goto err_destroy_mutex;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        ret = -errno;
+        close(fd);
+        goto err_destroy_mutex;
+    }
+
+    pdata->size = (size_t) st.st_size;
+    if (pdata->size < sizeof(*hdr)) {
+        ret = -EINVAL;
+        close(fd);
+        goto err_destroy_mutex;
+    }
+
+    pdata->base = mmap(NULL, pdata->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (pdata->base == MAP_FAILED) {
+        ret = -errno;
+        goto err_destroy_mutex;
+    }
+
+    hdr = pdata->base;
+    if (hdr->magic != REPLAY_MAGIC || hdr->version != REPLAY_VERSION ||
+            hdr->xml_len > pdata->size - sizeof(*hdr)) {
+        ERROR("Invalid recording in %s\n", path);
+        ret = -EINVAL;
+        goto err_unmap;
+    }
+
+    ctx = xml_create_context_mem((const char *) (hdr + 1), hdr->xml_len);
+    if (!ctx) {
+        ret = -errno;
+        goto err_unmap;
+    }
+
+    /* From now on, destroying the context releases the pdata as well */
+    ctx->name = "replay";
+    ctx->ops = &replay_ops;
+    ctx->pdata = pdata;
+
+    for (i = 0; i < ctx->nb_devices; i++) {
+        struct iio_device *dev = ctx->devices[i];
+
+        dev->pdata = zalloc(sizeof(*dev->pdata));
+        if (!dev->pdata) {
+            ret = -ENOMEM;
+            goto err_destroy_context;
+        }
+
+        dev->pdata->blocking = true;
+    }
+
+    ret = replay_load(ctx, sizeof(*hdr) + hdr->xml_len);
+    if (ret < 0) {
+        ERROR("Invalid recording in %s\n", path);
+        goto err_destroy_context;
+    }
+
+    ret = iio_context_add_attr(ctx, "replay,path", path);
+    if (ret < 0)
+        goto err_destroy_context;
+
+    free(path);
+    pdata->start_ns = iio_time_ns();
+    return ctx;
+
+err_destroy_context:
+    free(path);
+    iio_context_destroy(ctx);
+    errno = -ret;
+    return NULL;
+err_unmap:
+    munmap(pdata->base, pdata->size);
+err_destroy_mutex:
+    iio_mutex_destroy(pdata->lock);
+err_free_path:
+    free(path);
+    free(pdata->uri);
+    free(pdata);
+    errno = -ret;
+    return NULL;
+}
@@ -0,0 +1,108 @@
+/*
+ * libiio - Library for interfacing industrial I/O (IIO) devices
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+/*
+ * Layout of the shared memory region read by the shm backend.
+ *
+ * The region starts with a shm_ring_header, followed somewhere by the XML
+ * description of the context (as the IIO Daemon would send it) and by one
+ * shm_ring per device that streams samples, each one pointing to its own
+ * sample array. All offsets are from the start of the region, so that the
+ * producer and the consumer may map it at different addresses, or live in
+ * different virtual machines (ivshmem).
+ *
+ * Each ring has a single producer and a single consumer. The producer only
+ * writes 'head' and the sample slots between 'head' and 'tail' + nb_samples,
+ * the consumer only writes 'tail'. Both are free-running sample counters;
+ * the slot of a counter is its value modulo nb_samples. When the ring is
+ * full, the producer drops the new samples and counts them in 'overruns'.
+ *
+ * Samples are laid out exactly like in an IIO buffer with the channels of
+ * 'mask' enabled, timestamp channel included, so the consumer hands them
+ * over without any conversion.
+ */
+
+#ifndef _SHM_RING_H
+#define _SHM_RING_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define SHM_RING_MAGIC 0x52534949 /* "IISR" */
+#define SHM_RING_VERSION 1
+#define SHM_RING_MAX_WORDS 4
+#define SHM_RING_ID_LEN 32
+
+struct shm_ring_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nb_rings;
+    uint32_t xml_len;
+    uint64_t xml_offset;
+    uint64_t rings_offset; /* Array of nb_rings struct shm_ring */
+};
+
+/* Three cache lines: constant part, producer part, consumer part */
+struct shm_ring {
+    char device_id[SHM_RING_ID_LEN];
+    uint32_t sample_size;
+    uint32_t nb_samples;
+    uint32_t mask[SHM_RING_MAX_WORDS];
+    uint64_t data_offset;
+
+    uint64_t head;
+    uint64_t overruns;
+    uint64_t producer_pad[6];
+
+    uint64_t tail;
+    uint64_t consumer_pad[7];
+};
+
+static inline void * shm_ring_slot(void *base,
+        const struct shm_ring *ring, uint64_t counter)
+{
+    return (char *) base + ring->data_offset +
+        (size_t) (counter % ring->nb_samples) * ring->sample_size;
+}
+
+/*
+ * Producer side: appends up to nb samples to the ring, and publishes them
+ * at once. Returns the number of samples written; the others are dropped.
+ */
+static inline unsigned int shm_ring_write(void *base, struct shm_ring *ring,
+        const void *samples, unsigned int nb)
+{
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint64_t room = ring->nb_samples - (head - tail);
+    unsigned int i;
+
+    if (nb > room) {
+        ring->overruns += nb - room;
+        nb = (unsigned int) room;
+    }
+
+    for (i = 0; i < nb; i++)
+        memcpy(shm_ring_slot(base, ring, head + i),
+                (const char *) samples + (size_t) i * ring->sample_size,
+                ring->sample_size);
+
+    __atomic_store_n(&ring->head, head + nb, __ATOMIC_RELEASE);
+    return nb;
+}
+
+#endif /* _SHM_RING_H */
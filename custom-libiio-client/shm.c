@@ -0,0 +1,408 @@
+/*
+ * libiio - Library for interfacing industrial I/O (IIO) devices
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "iio-config.h"
+#include "iio-private.h"
+#include "shm-ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+
+#define DEFAULT_TIMEOUT_MS 5000
+
+/* An empty ring is first polled without sleeping for WAIT_SPIN_US, then
+ * at an interval doubled from WAIT_MIN_US up to WAIT_MAX_US */
+#define WAIT_SPIN_US 20
+#define WAIT_MIN_US 50
+#define WAIT_MAX_US 1000
+
+struct iio_context_pdata {
+    void *base;
+    size_t size;
+    char *path;
+    unsigned int timeout_ms;
+};
+
+struct iio_device_pdata {
+    struct shm_ring *ring;
+
+    /* Geometry of the ring, copied once validated: the producer may write
+     * anything to the shared one at any time */
+    char *data;
+    uint32_t sample_size, nb_samples;
+    uint32_t mask[SHM_RING_MAX_WORDS];
+
+    /* Next sample to consume; only published to the ring */
+    uint64_t tail;
+
+    bool opened, blocking;
+
+    /* Samples handed over by the last get_buffer(), released by the next */
+    uint32_t pending;
+};
+
+static int shm_open_dev(const struct iio_device *dev,
+        __notused size_t samples_count, bool cyclic)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+    struct shm_ring *ring = pdata->ring;
+
+    if (!ring || cyclic)
+        return -ENOSYS;
+    if (pdata->opened)
+        return -EBUSY;
+    if (dev->words > SHM_RING_MAX_WORDS)
+        return -EINVAL;
+
+    /* The samples have to be usable as they are */
+    if (iio_device_get_sample_size_mask(dev, pdata->mask,
+                dev->words) != pdata->sample_size)
+        return -EINVAL;
+
+    /* Drop what was produced before the buffer existed */
+    pdata->tail = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&ring->tail, pdata->tail, __ATOMIC_RELEASE);
+
+    pdata->pending = 0;
+    pdata->opened = true;
+    return 0;
+}
+
+static void shm_release(struct iio_device_pdata *pdata)
+{
+    if (pdata->pending) {
+        pdata->tail += pdata->pending;
+        __atomic_store_n(&pdata->ring->tail, pdata->tail,
+                __ATOMIC_RELEASE);
+        pdata->pending = 0;
+    }
+}
+
+static int shm_close_dev(const struct iio_device *dev)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+
+    if (!pdata->opened)
+        return -EBADF;
+
+    shm_release(pdata);
+    pdata->opened = false;
+    return 0;
+}
+
+static int shm_set_blocking_mode(const struct iio_device *dev, bool blocking)
+{
+    dev->pdata->blocking = blocking;
+    return 0;
+}
+
+/* Sleeps until the producer publishes samples, or the timeout expires */
+static int shm_wait(const struct iio_device *dev, uint64_t tail,
+        uint64_t *head)
+{
+    struct shm_ring *ring = dev->pdata->ring;
+    unsigned int timeout_ms = dev->ctx->pdata->timeout_ms;
+    int64_t start, now;
+    long wait_us = WAIT_MIN_US;
+
+    *head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (*head != tail)
+        return 0;
+    if (!dev->pdata->blocking)
+        return -EAGAIN;
+
+    /* clock_gettime() doesn't enter the kernel */
+    start = (int64_t) (iio_time_ns() / 1000);
+    do {
+        *head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (*head != tail)
+            return 0;
+        now = (int64_t) (iio_time_ns() / 1000);
+    } while (now - start < WAIT_SPIN_US);
+
+    for (;;) {
+        struct timespec ts;
+
+        if (timeout_ms && now - start >= timeout_ms * 1000LL)
+            return -ETIMEDOUT;
+
+        ts.tv_sec = 0;
+        ts.tv_nsec = wait_us * 1000;
+        nanosleep(&ts, NULL);
+
+        if (wait_us < WAIT_MAX_US)
+            wait_us *= 2;
+
+        *head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (*head != tail)
+            return 0;
+        now = (int64_t) (iio_time_ns() / 1000);
+    }
+}
+
+/*
+ * Hands over the samples available in the ring in place, up to the end of
+ * the sample array; they stay valid until the next call. No system call is
+ * made unless the ring is empty.
+ */
+static ssize_t shm_get_buffer(const struct iio_device *dev,
+        void **addr_ptr, size_t bytes_used,
+        uint32_t *mask, size_t words)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+    uint64_t head, tail, nb, contiguous;
+    int ret;
+
+    if (!addr_ptr)
+        return -EINVAL;
+    if (!pdata->opened)
+        return -EBADF;
+    if (words != dev->words)
+        return -EINVAL;
+
+    shm_release(pdata);
+
+    tail = pdata->tail;
+    ret = shm_wait(dev, tail, &head);
+    if (ret < 0)
+        return ret;
+
+    nb = head - tail;
+    if (nb > pdata->nb_samples)
+        return -EIO;
+
+    contiguous = pdata->nb_samples - tail % pdata->nb_samples;
+    if (nb > contiguous)
+        nb = contiguous;
+    if (nb > bytes_used / pdata->sample_size)
+        nb = bytes_used / pdata->sample_size;
+    if (!nb)
+        return -EINVAL;
+
+    memcpy(mask, pdata->mask, words * sizeof(*mask));
+
+    *addr_ptr = pdata->data +
+        (size_t) (tail % pdata->nb_samples) * pdata->sample_size;
+    pdata->pending = (uint32_t) nb;
+    return (ssize_t) (nb * pdata->sample_size);
+}
+
+static int shm_set_timeout(struct iio_context *ctx, unsigned int timeout)
+{
+    ctx->pdata->timeout_ms = timeout;
+    return 0;
+}
+
+static void shm_shutdown(struct iio_context *ctx)
+{
+    unsigned int i;
+
+    for (i = 0; i < ctx->nb_devices; i++)
+        free(ctx->devices[i]->pdata);
+
+    munmap(ctx->pdata->base, ctx->pdata->size);
+    free(ctx->pdata->path);
+    free(ctx->pdata);
+}
+
+static struct iio_context * shm_clone(const struct iio_context *ctx)
+{
+    return shm_create_context(ctx->pdata->path);
+}
+
+static const struct iio_backend_ops shm_ops = {
+    .clone = shm_clone,
+    .open = shm_open_dev,
+    .close = shm_close_dev,
+    .set_blocking_mode = shm_set_blocking_mode,
+    .get_buffer = shm_get_buffer,
+    .shutdown = shm_shutdown,
+    .set_timeout = shm_set_timeout,
+};
+
+/*
+ * The producer may write to the region at any time: the header and the
+ * geometry of the rings are copied before being checked, and only the
+ * copies are used afterwards.
+ */
+
+/* Checks that everything the header points to lies within the region */
+static int shm_get_header(const void *base, size_t size,
+        struct shm_ring_header *hdr)
+{
+    if (size < sizeof(*hdr))
+        return -EINVAL;
+
+    memcpy(hdr, base, sizeof(*hdr));
+
+    if (hdr->magic != SHM_RING_MAGIC || hdr->version != SHM_RING_VERSION)
+        return -EINVAL;
+
+    if (hdr->xml_offset > size || hdr->xml_len > size - hdr->xml_offset)
+        return -EINVAL;
+
+    if (hdr->rings_offset > size || hdr->rings_offset % 8 ||
+            hdr->nb_rings > (size - hdr->rings_offset) /
+            sizeof(struct shm_ring))
+        return -EINVAL;
+
+    return 0;
+}
+
+/* Checks that the samples of the ring lie within the region */
+static int shm_get_geometry(const struct iio_context_pdata *pdata,
+        const struct shm_ring *ring, struct iio_device_pdata *dpdata)
+{
+    struct shm_ring copy;
+
+    memcpy(&copy, ring, sizeof(copy));
+
+    if (!copy.sample_size || !copy.nb_samples ||
+            copy.data_offset > pdata->size || copy.data_offset % 8 ||
+            (uint64_t) copy.sample_size * copy.nb_samples >
+            pdata->size - copy.data_offset)
+        return -EINVAL;
+
+    dpdata->ring = (struct shm_ring *) ring;
+    dpdata->data = (char *) pdata->base + copy.data_offset;
+    dpdata->sample_size = copy.sample_size;
+    dpdata->nb_samples = copy.nb_samples;
+    memcpy(dpdata->mask, copy.mask, sizeof(dpdata->mask));
+    return 0;
+}
+
+static const struct shm_ring * shm_find_ring(const void *base,
+        const struct shm_ring_header *hdr, const char *id)
+{
+    const struct shm_ring *rings = (const struct shm_ring *)
+        ((const char *) base + hdr->rings_offset);
+    uint32_t i;
+
+    for (i = 0; i < hdr->nb_rings; i++)
+        if (!strncmp(rings[i].device_id, id, SHM_RING_ID_LEN))
+            return &rings[i];
+
+    return NULL;
+}
+
+struct iio_context * shm_create_context(const char *path)
+{
+    struct iio_context_pdata *pdata;
+    struct shm_ring_header hdr;
+    struct iio_context *ctx;
+    struct stat st;
+    unsigned int i;
+    int fd, ret;
+
+    pdata = zalloc(sizeof(*pdata));
+    if (!pdata) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pdata->timeout_ms = DEFAULT_TIMEOUT_MS;
+    pdata->path = iio_strdup(path);
+    if (!pdata->path) {
+        ret = -ENOMEM;
+        goto err_free_pdata;
+    }
+
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        ret = -errno;
+        goto err_free_path;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        ret = -errno;
+        close(fd);
+        goto err_free_path;
+    }
+
+    pdata->size = (size_t) st.st_size;
+    pdata->base = mmap(NULL, pdata->size, PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if (pdata->base == MAP_FAILED) {
+        ret = -errno;
+        goto err_free_path;
+    }
+
+    ret = shm_get_header(pdata->base, pdata->size, &hdr);
+    if (ret < 0) {
+        ERROR("Invalid shared memory layout in %s\n", path);
+        goto err_unmap;
+    }
+
+    ctx = xml_create_context_mem((const char *) pdata->base +
+            hdr.xml_offset, hdr.xml_len);
+    if (!ctx) {
+        ret = -errno;
+        goto err_unmap;
+    }
+
+    /* From now on, destroying the context releases the pdata as well */
+    ctx->name = "shm";
+    ctx->ops = &shm_ops;
+    ctx->pdata = pdata;
+
+    for (i = 0; i < ctx->nb_devices; i++) {
+        struct iio_device *dev = ctx->devices[i];
+        const struct shm_ring *ring;
+
+        dev->pdata = zalloc(sizeof(*dev->pdata));
+        if (!dev->pdata) {
+            ret = -ENOMEM;
+            goto err_destroy_context;
+        }
+
+        dev->pdata->blocking = true;
+
+        ring = shm_find_ring(pdata->base, &hdr, dev->id);
+        if (ring && shm_get_geometry(pdata, ring, dev->pdata) < 0) {
+            ERROR("Invalid shared memory ring for %s\n", dev->id);
+            ret = -EINVAL;
+            goto err_destroy_context;
+        }
+    }
+
+    ret = iio_context_add_attr(ctx, "shm,path", path);
+    if (ret < 0)
+        goto err_destroy_context;
+
+    return ctx;
+
+err_destroy_context:
+    iio_context_destroy(ctx);
+    errno = -ret;
+    return NULL;
+err_unmap:
+    munmap(pdata->base, pdata->size);
+err_free_path:
+    free(pdata->path);
+err_free_pdata:
+    free(pdata);
+    errno = -ret;
+    return NULL;
+}
@@ -0,0 +1,770 @@
+/*
+ * libiio - Library for interfacing industrial I/O (IIO) devices
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "iio-config.h"
+#include "iio-lock.h"
+#include "iio-private.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "debug.h"
+
+/*
+ * Synthetic devices, generated in-process from a configuration string:
+ *
+ *   device[,device...]
+ *   device := name[/channels[t]][:format][@rate][*count]
+ *
+ * Each device gets 'channels' channels (3 by default) in the given scan
+ * format (le:s16/16>>0 by default), and produces 'rate' samples per second
+ * (100 by default; 0 produces them as fast as they are read). '*count'
+ * repeats the device. The type of the channels follows the name of the
+ * device, as in the HAL; accelerometers, and the devices whose channel
+ * count ends with 't', also get a timestamp channel.
+ *
+ * Sample k of a channel is a point of a sine wave, whose frequency grows
+ * with the index of the channel and whose phase depends on the index of
+ * the device, spanning 99% of the range of the format. The values only
+ * depend on k, so that a run can be checked against another one; the
+ * buffers of a device always start at k = 0 when opened. The attributes
+ * "raw" and "input" return the sample due at the time of the read.
+ */
+
+#define SYNTH_TABLE_SIZE 1024
+#define SYNTH_MAX_DEVICES 64
+#define SYNTH_MAX_CHANNELS 32
+#define SYNTH_DEVICE_PHASE 97
+
+/* Processed values ("input") span +/- SYNTH_INPUT_RANGE */
+#define SYNTH_INPUT_RANGE 16.0
+
+/* Nominal period of the timestamps, for devices without a rate */
+#define SYNTH_UNPACED_PERIOD_NS 1000000ULL
+
+struct synth_config {
+    char name[32];
+    unsigned int nb_channels;
+    bool timestamp;
+    char endian, sign;
+    unsigned int bits, length, shift;
+    double rate;
+    unsigned int count;
+};
+
+struct synth_slot {
+    const struct iio_channel *chn;
+    size_t offset;
+    bool timestamp;
+};
+
+struct iio_context_pdata {
+    char *config;
+    double sine[SYNTH_TABLE_SIZE];
+
+    /* Protects the rates and positions of the devices */
+    struct iio_mutex *lock;
+};
+
+struct iio_device_pdata {
+    unsigned int index;
+    double rate;
+
+    /* Sample 'epoch_sample' was produced at 'epoch_ns' */
+    uint64_t epoch_ns, epoch_sample;
+
+    /* Next sample returned by a buffer, or by an attribute without rate */
+    uint64_t next, polled;
+
+    bool opened, blocking;
+    struct synth_slot slots[SYNTH_MAX_CHANNELS + 1];
+    unsigned int nb_slots;
+    size_t sample_size;
+};
+
+/* Number of samples produced at 'now'; only meaningful with a rate */
+static uint64_t synth_produced(const struct iio_device_pdata *pdata,
+        uint64_t now)
+{
+    if (now < pdata->epoch_ns)
+        return pdata->epoch_sample;
+
+    return pdata->epoch_sample +
+        (uint64_t) ((now - pdata->epoch_ns) * pdata->rate / 1e9);
+}
+
+/* Time at which sample k is produced */
+static uint64_t synth_due_ns(const struct iio_device_pdata *pdata,
+        uint64_t k)
+{
+    if (pdata->rate <= 0)
+        return k * SYNTH_UNPACED_PERIOD_NS;
+
+    return pdata->epoch_ns + (uint64_t) ((double) (int64_t)
+            (k + 1 - pdata->epoch_sample) * 1e9 / pdata->rate);
+}
+
+static double synth_amplitude(const struct iio_data_format *fmt)
+{
+    return ldexp(1.0, (int) fmt->bits - 1) * 0.99;
+}
+
+/* Value of sample k of a channel, before masking and shifting */
+static uint64_t synth_value(const struct iio_context_pdata *ctx_pdata,
+        const struct iio_channel *chn, unsigned int dev_index, uint64_t k)
+{
+    const struct iio_data_format *fmt = &chn->format;
+    unsigned int i = (unsigned int) ((k * (uint64_t) (chn->index + 1) +
+            dev_index * SYNTH_DEVICE_PHASE) & (SYNTH_TABLE_SIZE - 1));
+    double val = synth_amplitude(fmt) * ctx_pdata->sine[i];
+
+    if (fmt->is_signed)
+        return (uint64_t) (int64_t) val;
+    else
+        return (uint64_t) (ldexp(1.0, (int) fmt->bits - 1) + val);
+}
+
+static void synth_store(uint8_t *dst, const struct iio_data_format *fmt,
+        uint64_t value)
+{
+    unsigned int i, len = fmt->length / 8;
+
+    if (fmt->bits < 64)
+        value &= (1ULL << fmt->bits) - 1;
+    value <<= fmt->shift;
+
+    for (i = 0; i < len; i++)
+        dst[fmt->is_be ? len - 1 - i : i] = (uint8_t) (value >> (8 * i));
+}
+
+static void synth_fill(const struct iio_device *dev, uint8_t *dst,
+        uint64_t first, uint64_t nb)
+{
+    const struct iio_context_pdata *ctx_pdata = dev->ctx->pdata;
+    const struct iio_device_pdata *pdata = dev->pdata;
+    uint64_t k;
+    unsigned int i;
+
+    for (k = first; k < first + nb; k++) {
+        for (i = 0; i < pdata->nb_slots; i++) {
+            const struct synth_slot *slot = &pdata->slots[i];
+            uint64_t value;
+
+            if (slot->timestamp)
+                value = synth_due_ns(pdata, k);
+            else
+                value = synth_value(ctx_pdata, slot->chn, pdata->index, k);
+
+            synth_store(dst + slot->offset, &slot->chn->format, value);
+        }
+
+        dst += pdata->sample_size;
+    }
+}
+
+/* Lays out the enabled channels the way iio_device_get_sample_size does */
+static int synth_layout(const struct iio_device *dev)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+    long prev_index = -1;
+    size_t size = 0;
+    unsigned int i;
+
+    pdata->nb_slots = 0;
+
+    for (i = 0; i < dev->nb_channels; i++) {
+        const struct iio_channel *chn = dev->channels[i];
+        size_t length = chn->format.length / 8 * chn->format.repeat;
+        struct synth_slot *slot;
+
+        if (chn->index < 0)
+            break;
+        if (!iio_channel_is_enabled(chn) || chn->index == prev_index)
+            continue;
+
+        prev_index = chn->index;
+        if (size % length)
+            size += length - size % length;
+
+        slot = &pdata->slots[pdata->nb_slots++];
+        slot->chn = chn;
+        slot->offset = size;
+        slot->timestamp = !strcmp(chn->id, "timestamp");
+        size += length;
+    }
+
+    if (!size)
+        return -EINVAL;
+
+    pdata->sample_size = size;
+    return 0;
+}
+
+static int synth_open(const struct iio_device *dev,
+        __notused size_t samples_count, bool cyclic)
+{
+    struct iio_context_pdata *ctx_pdata = dev->ctx->pdata;
+    struct iio_device_pdata *pdata = dev->pdata;
+    int ret;
+
+    if (cyclic || iio_device_is_tx(dev))
+        return -ENOSYS;
+    if (pdata->opened)
+        return -EBUSY;
+
+    ret = synth_layout(dev);
+    if (ret < 0)
+        return ret;
+
+    iio_mutex_lock(ctx_pdata->lock);
+    pdata->epoch_ns = iio_time_ns();
+    pdata->epoch_sample = 0;
+    pdata->next = 0;
+    iio_mutex_unlock(ctx_pdata->lock);
+
+    pdata->opened = true;
+    return 0;
+}
+
+static int synth_close(const struct iio_device *dev)
+{
+    struct iio_device_pdata *pdata = dev->pdata;
+
+    if (!pdata->opened)
+        return -EBADF;
+
+    pdata->opened = false;
+    return 0;
+}
+
+static int synth_set_blocking_mode(const struct iio_device *dev,
+        bool blocking)
+{
+    dev->pdata->blocking = blocking;
+    return 0;
+}
+
+/*
+ * Returns as many samples as fit in 'len', once the last one is produced.
+ * If not blocking, the samples produced so far are returned instead, or
+ * -EAGAIN if there are none.
+ */
+static ssize_t synth_read(const struct iio_device *dev,
+        void *dst, size_t len, uint32_t *mask, size_t words)
+{
+    struct iio_context_pdata *ctx_pdata = dev->ctx->pdata;
+    struct iio_device_pdata *pdata = dev->pdata;
+    uint64_t first, nb, due = 0;
+
+    if (!pdata->opened)
+        return -EBADF;
+    if (words != dev->words)
+        return -EINVAL;
+
+    nb = len / pdata->sample_size;
+    if (!nb)
+        return -EINVAL;
+
+    iio_mutex_lock(ctx_pdata->lock);
+    first = pdata->next;
+
+    if (pdata->rate > 0) {
+        uint64_t now = iio_time_ns(),
+                 produced = synth_produced(pdata, now);
+
+        if (produced < first + nb && !pdata->blocking) {
+            if (produced <= first) {
+                iio_mutex_unlock(ctx_pdata->lock);
+                return -EAGAIN;
+            }
+
+            nb = produced - first;
+        } else if (produced < first + nb) {
+            due = synth_due_ns(pdata, first + nb - 1);
+        }
+    }
+
+    pdata->next = first + nb;
+    iio_mutex_unlock(ctx_pdata->lock);
+
+    if (due) {
+        struct timespec ts;
+
+        ts.tv_sec = (time_t) (due / 1000000000ULL);
+        ts.tv_nsec = (long) (due % 1000000000ULL);
+
+        while (clock_nanosleep(CLOCK_MONOTONIC,
+                    TIMER_ABSTIME, &ts, NULL) == EINTR);
+    }
+
+    synth_fill(dev, dst, first, nb);
+    memcpy(mask, dev->mask, words * sizeof(*mask));
+    return (ssize_t) (nb * pdata->sample_size);
+}
+
+static ssize_t synth_read_dev_attr(const struct iio_device *dev,
+        const char *attr, char *dst, size_t len, enum iio_attr_type type)
+{
+    struct iio_context_pdata *ctx_pdata = dev->ctx->pdata;
+    double rate;
+
+    if (type != IIO_ATTR_TYPE_DEVICE || strcmp(attr, "sampling_frequency"))
+        return -ENOENT;
+
+    iio_mutex_lock(ctx_pdata->lock);
+    rate = dev->pdata->rate;
+    iio_mutex_unlock(ctx_pdata->lock);
+
+    iio_snprintf(dst, len, "%g", rate);
+    return (ssize_t) strlen(dst) + 1;
+}
+
+/* Changes the rate from now on, without skipping or repeating samples */
+static ssize_t synth_write_dev_attr(const struct iio_device *dev,
+        const char *attr, const char *src, size_t len,
+        enum iio_attr_type type)
+{
+    struct iio_context_pdata *ctx_pdata = dev->ctx->pdata;
+    struct iio_device_pdata *pdata = dev->pdata;
+    uint64_t now, sample;
+    double rate;
+    char *end;
+
+    if (type != IIO_ATTR_TYPE_DEVICE || strcmp(attr, "sampling_frequency"))
+        return -ENOENT;
+
+    rate = strtod(src, &end);
+    if (end == src || rate < 0 || !isfinite(rate))
+        return -EINVAL;
+
+    iio_mutex_lock(ctx_pdata->lock);
+    now = iio_time_ns();
+    sample = pdata->rate > 0 ? synth_produced(pdata, now) : pdata->next;
+    if (sample < pdata->next)
+        sample = pdata->next;
+
+    pdata->epoch_ns = now;
+    pdata->epoch_sample = sample;
+    pdata->rate = rate;
+    iio_mutex_unlock(ctx_pdata->lock);
+
+    return (ssize_t) len;
+}
+
+static ssize_t synth_read_chn_attr(const struct iio_channel *chn,
+        const char *attr, char *dst, size_t len)
+{
+    const struct iio_device *dev = chn->dev;
+    struct iio_context_pdata *ctx_pdata = dev->ctx->pdata;
+    struct iio_device_pdata *pdata = dev->pdata;
+    const struct iio_data_format *fmt = &chn->format;
+    double scale = SYNTH_INPUT_RANGE / ldexp(1.0, (int) fmt->bits - 1);
+    uint64_t k, value;
+
+    if (!iio_channel_find_attr(chn, attr))
+        return -ENOENT;
+
+    if (!strcmp(attr, "scale")) {
+        iio_snprintf(dst, len, "%.9g", scale);
+        return (ssize_t) strlen(dst) + 1;
+    }
+
+    iio_mutex_lock(ctx_pdata->lock);
+    if (pdata->rate > 0)
+        k = synth_produced(pdata, iio_time_ns());
+    else
+        k = pdata->polled++;
+    iio_mutex_unlock(ctx_pdata->lock);
+
+    value = synth_value(ctx_pdata, chn, pdata->index, k);
+
+    if (!strcmp(attr, "raw")) {
+        if (fmt->is_signed)
+            iio_snprintf(dst, len, "%lld", (long long) (int64_t) value);
+        else
+            iio_snprintf(dst, len, "%llu", (unsigned long long) value);
+    } else {
+        double val = fmt->is_signed ?
+            (double) (int64_t) value : (double) value;
+
+        iio_snprintf(dst, len, "%f", val * scale);
+    }
+
+    return (ssize_t) strlen(dst) + 1;
+}
+
+static ssize_t synth_write_chn_attr(const struct iio_channel *chn,
+        const char *attr, __notused const char *src, __notused size_t len)
+{
+    return iio_channel_find_attr(chn, attr) ? -EACCES : -ENOENT;
+}
+
+static int synth_set_timeout(__notused struct iio_context *ctx,
+        __notused unsigned int timeout)
+{
+    return 0;
+}
+
+static void synth_shutdown(struct iio_context *ctx)
+{
+    struct iio_context_pdata *pdata = ctx->pdata;
+    unsigned int i;
+
+    for (i = 0; i < ctx->nb_devices; i++)
+        free(ctx->devices[i]->pdata);
+
+    iio_mutex_destroy(pdata->lock);
+    free(pdata->config);
+    free(pdata);
+}
+
+static struct iio_context * synth_clone(const struct iio_context *ctx)
+{
+    return synth_create_context(ctx->pdata->config);
+}
+
+static const struct iio_backend_ops synth_ops = {
+    .clone = synth_clone,
+    .open = synth_open,
+    .close = synth_close,
+    .read = synth_read,
+    .set_blocking_mode = synth_set_blocking_mode,
+    .read_device_attr = synth_read_dev_attr,
+    .write_device_attr = synth_write_dev_attr,
+    .read_channel_attr = synth_read_chn_attr,
+    .write_channel_attr = synth_write_chn_attr,
+    .shutdown = synth_shutdown,
+    .set_timeout = synth_set_timeout,
+};
+
+static const struct {
+    const char *prefix, *type;
+    bool timestamp;
+} synth_types[] = {
+    { "accel", "accel", true },
+    { "gyro", "anglvel", false },
+    { "magn", "magn", false },
+    { "geomagnetic", "rot", false },
+    { "dev_rotation", "rot", false },
+    { "relative", "rot", false },
+    { "incli", "incli", false },
+    { "gravity", "gravity", false },
+    { "als", "illuminance", false },
+};
+
+static const char * synth_channel_type(const char *name, bool *timestamp)
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(synth_types); i++) {
+        if (!strncmp(name, synth_types[i].prefix,
+                    strlen(synth_types[i].prefix))) {
+            if (timestamp)
+                *timestamp = synth_types[i].timestamp;
+            return synth_types[i].type;
+        }
+    }
+
+    if (timestamp)
+        *timestamp = false;
+    return "voltage";
+}
+
+/* Parses "name[/channels[t]][:format][@rate][*count]" */
+static int synth_parse_device(const char *str, struct synth_config *cfg)
+{
+    size_t len = strcspn(str, "/:@*");
+    char *end;
+    int n = 0;
+
+    if (!len || len >= sizeof(cfg->name))
+        return -EINVAL;
+
+    memcpy(cfg->name, str, len);
+    cfg->name[len] = '\0';
+    for (end = cfg->name; *end; end++)
+        if (!isalnum((unsigned char) *end) && *end != '_')
+            return -EINVAL;
+
+    synth_channel_type(cfg->name, &cfg->timestamp);
+    cfg->nb_channels = 3;
+    cfg->endian = 'l';
+    cfg->sign = 's';
+    cfg->bits = 16;
+    cfg->length = 16;
+    cfg->shift = 0;
+    cfg->rate = 100.0;
+    cfg->count = 1;
+    str += len;
+
+    if (*str == '/') {
+        cfg->nb_channels = (unsigned int) strtoul(str + 1, &end, 10);
+        if (end == str + 1 || !cfg->nb_channels ||
+                cfg->nb_channels > SYNTH_MAX_CHANNELS)
+            return -EINVAL;
+        str = end;
+
+        if (*str == 't') {
+            cfg->timestamp = true;
+            str++;
+        }
+    }
+
+    if (*str == ':') {
+        if (sscanf(str + 1, "%ce:%c%u/%u>>%u%n", &cfg->endian, &cfg->sign,
+                    &cfg->bits, &cfg->length, &cfg->shift, &n) != 5)
+            return -EINVAL;
+        if ((cfg->endian != 'l' && cfg->endian != 'b') ||
+                (cfg->sign != 's' && cfg->sign != 'u') ||
+                (cfg->length != 8 && cfg->length != 16 &&
+                 cfg->length != 32 && cfg->length != 64) ||
+                !cfg->bits || cfg->shift >= cfg->length ||
+                cfg->bits > cfg->length - cfg->shift)
+            return -EINVAL;
+        str += 1 + n;
+    }
+
+    if (*str == '@') {
+        cfg->rate = strtod(str + 1, &end);
+        if (end == str + 1 || cfg->rate < 0 || !isfinite(cfg->rate))
+            return -EINVAL;
+        str = end;
+    }
+
+    if (*str == '*') {
+        cfg->count = (unsigned int) strtoul(str + 1, &end, 10);
+        if (end == str + 1 || !cfg->count ||
+                cfg->count > SYNTH_MAX_DEVICES)
+            return -EINVAL;
+        str = end;
+    }
+
+    return *str ? -EINVAL : 0;
+}
+
+struct synth_xml {
+    char *buf;
+    size_t len, size;
+};
+
+static int synth_xml_append(struct synth_xml *xml, const char *fmt, ...)
+{
+    va_list ap;
+    int ret;
+
+    for (;;) {
+        va_start(ap, fmt);
+        ret = vsnprintf(xml->buf + xml->len, xml->size - xml->len, fmt, ap);
+        va_end(ap);
+
+        if (ret < 0)
+            return -EINVAL;
+
+        if ((size_t) ret < xml->size - xml->len) {
+            xml->len += (size_t) ret;
+            return 0;
+        } else {
+            size_t size = xml->size * 2 + (size_t) ret;
+            char *buf = realloc(xml->buf, size);
+
+            if (!buf)
+                return -ENOMEM;
+
+            xml->buf = buf;
+            xml->size = size;
+        }
+    }
+}
+
+static int synth_xml_add_device(struct synth_xml *xml,
+        const struct synth_config *cfg, unsigned int id)
+{
+    const char *type = synth_channel_type(cfg->name, NULL);
+    unsigned int i;
+    int ret;
+
+    ret = synth_xml_append(xml, "<device id=\"iio:device%u\" name=\"%s\" >",
+            id, cfg->name);
+
+    for (i = 0; !ret && i < cfg->nb_channels; i++) {
+        char chn_id[32];
+
+        if (cfg->nb_channels == 3)
+            iio_snprintf(chn_id, sizeof(chn_id), "%s_%c", type, 'x' + i);
+        else if (cfg->nb_channels == 1)
+            iio_snprintf(chn_id, sizeof(chn_id), "%s", type);
+        else
+            iio_snprintf(chn_id, sizeof(chn_id), "%s%u", type, i);
+
+        ret = synth_xml_append(xml, "<channel id=\"%s\" type=\"input\" >"
+                "<scan-element index=\"%u\" "
+                "format=\"%ce:%c%u/%u&gt;&gt;%u\" />"
+                "<attribute name=\"raw\" />"
+                "<attribute name=\"scale\" />"
+                "<attribute name=\"input\" />"
+                "</channel>", chn_id, i, cfg->endian, cfg->sign,
+                cfg->bits, cfg->length, cfg->shift);
+    }
+
+    if (!ret && cfg->timestamp)
+        ret = synth_xml_append(xml, "<channel id=\"timestamp\" "
+                "type=\"input\" ><scan-element index=\"%u\" "
+                "format=\"le:s64/64&gt;&gt;0\" /></channel>",
+                cfg->nb_channels);
+    if (!ret)
+        ret = synth_xml_append(xml,
+                "<attribute name=\"sampling_frequency\" /></device>");
+    return ret;
+}
+
+/* Builds the XML of the context, and the rates of the devices */
+static int synth_create_xml(const char *config, struct synth_xml *xml,
+        double *rates, unsigned int *nb_devices)
+{
+    const char *ptr = config;
+    int ret;
+
+    *nb_devices = 0;
+
+    ret = synth_xml_append(xml, "%s<context name=\"synth\" >",
+            iio_xml_header);
+
+    while (!ret) {
+        struct synth_config cfg;
+        size_t len = strcspn(ptr, ",");
+        char token[128];
+        unsigned int i;
+
+        if (len >= sizeof(token))
+            return -EINVAL;
+
+        memcpy(token, ptr, len);
+        token[len] = '\0';
+
+        ret = synth_parse_device(token, &cfg);
+        if (ret < 0)
+            return ret;
+
+        if (*nb_devices + cfg.count > SYNTH_MAX_DEVICES)
+            return -EINVAL;
+
+        for (i = 0; !ret && i < cfg.count; i++) {
+            rates[*nb_devices] = cfg.rate;
+            ret = synth_xml_add_device(xml, &cfg, (*nb_devices)++);
+        }
+
+        if (!ptr[len])
+            break;
+        ptr += len + 1;
+    }
+
+    if (!ret)
+        ret = synth_xml_append(xml, "</context>");
+    return ret;
+}
+
+struct iio_context * synth_create_context(const char *config)
+{
+    struct iio_context_pdata *pdata;
+    struct iio_context *ctx;
+    struct synth_xml xml = { NULL, 0, 0 };
+    double rates[SYNTH_MAX_DEVICES];
+    unsigned int i, nb_devices;
+    uint64_t now;
+    int ret;
+
+    pdata = zalloc(sizeof(*pdata));
+    if (!pdata) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pdata->config = iio_strdup(config);
+    if (!pdata->config) {
+        ret = -ENOMEM;
+        goto err_free_pdata;
+    }
+
+    ret = synth_create_xml(config, &xml, rates, &nb_devices);
+    if (ret < 0) {
+        ERROR("Invalid synthetic context: %s\n", config);
+        goto err_free_xml;
+    }
+
+    for (i = 0; i < SYNTH_TABLE_SIZE; i++)
+        pdata->sine[i] = sin(2.0 * M_PI * i / SYNTH_TABLE_SIZE);
+
+    pdata->lock = iio_mutex_create();
+    if (!pdata->lock) {
+        ret = -ENOMEM;
+        goto err_free_xml;
+    }
+
+    ctx = xml_create_context_mem(xml.buf, xml.len);
+    if (!ctx) {
+        ret = -errno;
+        goto err_destroy_mutex;
+    }
+
+    /* From now on, destroying the context releases the pdata as well */
+    ctx->name = "synth";
+    ctx->ops = &synth_ops;
+    ctx->pdata = pdata;
+
+    now = iio_time_ns();
+    for (i = 0; i < ctx->nb_devices; i++) {
+        struct iio_device *dev = ctx->devices[i];
+
+        dev->pdata = zalloc(sizeof(*dev->pdata));
+        if (!dev->pdata) {
+            ret = -ENOMEM;
+            goto err_destroy_context;
+        }
+
+        dev->pdata->index = i;
+        dev->pdata->rate = rates[i];
+        dev->pdata->epoch_ns = now;
+        dev->pdata->blocking = true;
+    }
+
+    ret = iio_context_add_attr(ctx, "synth,config", config);
+    if (ret < 0)
+        goto err_destroy_context;
+
+    free(xml.buf);
+    return ctx;
+
+err_destroy_context:
+    free(xml.buf);
+    iio_context_destroy(ctx);
+    errno = -ret;
+    return NULL;
+err_destroy_mutex:
+    iio_mutex_destroy(pdata->lock);
+err_free_xml:
+    free(xml.buf);
+    free(pdata->config);
+err_free_pdata:
+    free(pdata);
+    errno = -ret;
+    return NULL;
+}
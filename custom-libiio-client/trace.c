@@ -0,0 +1,327 @@
+/*
+ * libiio - Library for interfacing industrial I/O (IIO) devices
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "iio-config.h"
+#include "iio-private.h"
+
+#include <errno.h>
+
+#ifdef WITH_TRACE
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * Layout of a dump: a trace_file_header, then for each thread a
+ * trace_file_ring followed by its events, oldest first. Integers are in the
+ * byte order of the machine.
+ */
+
+#define TRACE_MAGIC 0x544f4949 /* "IIOT" */
+#define TRACE_VERSION 1
+
+/* Events kept per thread; a power of two */
+#define TRACE_RING_SIZE 4096
+
+struct trace_file_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t pid;
+    uint32_t nb_rings;
+};
+
+struct trace_file_ring {
+    uint32_t tid;
+    uint32_t nb_events;
+};
+
+struct trace_entry {
+    uint64_t timestamp_ns;  /* CLOCK_MONOTONIC */
+    uint16_t event;
+    uint16_t reserved;
+    uint32_t arg;
+};
+
+struct trace_ring {
+    struct trace_ring *next;
+    uint32_t tid;
+
+    /* Number of events ever recorded; only written by the owner */
+    uint64_t head;
+
+    struct trace_entry entries[TRACE_RING_SIZE];
+};
+
+/* The rings of all the threads, never freed so that they can be dumped
+ * after their thread is gone */
+static struct trace_ring *trace_rings;
+static __thread struct trace_ring *trace_ring;
+
+static char trace_signal_path[PATH_MAX];
+
+static const struct {
+    const char *name;
+    char phase;
+} trace_events[] = {
+    [IIO_TRACE_CONNECT_BEGIN] = { "connect", 'B' },
+    [IIO_TRACE_CONNECT_END] = { "connect", 'E' },
+    [IIO_TRACE_COMMAND_SEND] = { "command", 'i' },
+    [IIO_TRACE_RESPONSE] = { "response", 'i' },
+    [IIO_TRACE_PARSE_BEGIN] = { "parse", 'B' },
+    [IIO_TRACE_PARSE_END] = { "parse", 'E' },
+    [IIO_TRACE_POLL_BEGIN] = { "poll", 'B' },
+    [IIO_TRACE_POLL_END] = { "poll", 'E' },
+    [IIO_TRACE_EVENT_EMIT] = { "event", 'i' },
+};
+
+static struct trace_ring * trace_ring_new(void)
+{
+    struct trace_ring *ring = zalloc(sizeof(*ring));
+
+    if (!ring)
+        return NULL;
+
+    ring->tid = (uint32_t) syscall(SYS_gettid);
+
+    ring->next = __atomic_load_n(&trace_rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&trace_rings, &ring->next, ring,
+                true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    return ring;
+}
+
+void iio_trace(enum iio_trace_event event, uint32_t arg)
+{
+    struct trace_ring *ring = trace_ring;
+    struct trace_entry *entry;
+    uint64_t head;
+
+    if (!ring) {
+        ring = trace_ring = trace_ring_new();
+        if (!ring)
+            return;
+    }
+
+    head = ring->head;
+    entry = &ring->entries[head & (TRACE_RING_SIZE - 1)];
+    entry->timestamp_ns = iio_time_ns();
+    entry->event = (uint16_t) event;
+    entry->arg = arg;
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* Only uses async-signal-safe functions */
+static int trace_write(int fd, const void *src, size_t len)
+{
+    const char *ptr = src;
+
+    while (len) {
+        ssize_t ret = write(fd, ptr, len);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+
+        ptr += ret;
+        len -= (size_t) ret;
+    }
+
+    return 0;
+}
+
+static int trace_write_ring(int fd, const struct trace_ring *ring)
+{
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    struct trace_file_ring hdr;
+    size_t first, nb;
+    int ret;
+
+    nb = head < TRACE_RING_SIZE ? (size_t) head : TRACE_RING_SIZE;
+    first = (size_t) ((head - nb) & (TRACE_RING_SIZE - 1));
+
+    hdr.tid = ring->tid;
+    hdr.nb_events = (uint32_t) nb;
+
+    ret = trace_write(fd, &hdr, sizeof(hdr));
+    if (ret < 0)
+        return ret;
+
+    if (first + nb > TRACE_RING_SIZE) {
+        ret = trace_write(fd, &ring->entries[first],
+                (TRACE_RING_SIZE - first) * sizeof(ring->entries[0]));
+        if (ret < 0)
+            return ret;
+
+        nb -= TRACE_RING_SIZE - first;
+        first = 0;
+    }
+
+    return trace_write(fd, &ring->entries[first],
+            nb * sizeof(ring->entries[0]));
+}
+
+int iio_trace_dump(const char *path)
+{
+    struct trace_ring *rings = __atomic_load_n(&trace_rings,
+            __ATOMIC_ACQUIRE), *ring;
+    struct trace_file_header hdr;
+    int fd, ret;
+
+    hdr.magic = TRACE_MAGIC;
+    hdr.version = TRACE_VERSION;
+    hdr.pid = (uint32_t) getpid();
+    hdr.nb_rings = 0;
+    for (ring = rings; ring; ring = ring->next)
+        hdr.nb_rings++;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -errno;
+
+    ret = trace_write(fd, &hdr, sizeof(hdr));
+
+    for (ring = rings; !ret && ring; ring = ring->next)
+        ret = trace_write_ring(fd, ring);
+
+    close(fd);
+    return ret;
+}
+
+static void trace_signal_handler(__notused int signum)
+{
+    int err = errno;
+
+    iio_trace_dump(trace_signal_path);
+    errno = err;
+}
+
+int iio_trace_dump_on_signal(int signum, const char *path)
+{
+    struct sigaction sa;
+
+    if (strlen(path) >= sizeof(trace_signal_path))
+        return -ENAMETOOLONG;
+
+    strcpy(trace_signal_path, path);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = trace_signal_handler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+
+    if (sigaction(signum, &sa, NULL) < 0)
+        return -errno;
+    return 0;
+}
+
+static int trace_convert_ring(FILE *in, FILE *out, uint32_t pid, bool *first)
+{
+    struct trace_file_ring hdr;
+    struct trace_entry entry;
+    uint32_t i;
+
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1)
+        return -EINVAL;
+
+    for (i = 0; i < hdr.nb_events; i++) {
+        if (fread(&entry, sizeof(entry), 1, in) != 1)
+            return -EINVAL;
+
+        /* Events of a newer library */
+        if (entry.event >= ARRAY_SIZE(trace_events))
+            continue;
+
+        fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",%s\"pid\":%u,"
+                "\"tid\":%u,\"ts\":%.3f,\"args\":{\"arg\":%u}}",
+                *first ? "" : ",", trace_events[entry.event].name,
+                trace_events[entry.event].phase,
+                trace_events[entry.event].phase == 'i' ? "\"s\":\"t\"," : "",
+                pid, hdr.tid, entry.timestamp_ns / 1000.0, entry.arg);
+        *first = false;
+    }
+
+    return 0;
+}
+
+int iio_trace_convert_json(const char *dump, const char *json)
+{
+    struct trace_file_header hdr;
+    FILE *in, *out;
+    bool first = true;
+    uint32_t i;
+    int ret = 0;
+
+    in = fopen(dump, "rb");
+    if (!in)
+        return -errno;
+
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1 ||
+            hdr.magic != TRACE_MAGIC || hdr.version != TRACE_VERSION) {
+        ret = -EINVAL;
+        goto out_close_in;
+    }
+
+    out = fopen(json, "w");
+    if (!out) {
+        ret = -errno;
+        goto out_close_in;
+    }
+
+    fprintf(out, "{\"traceEvents\":[");
+
+    for (i = 0; !ret && i < hdr.nb_rings; i++)
+        ret = trace_convert_ring(in, out, hdr.pid, &first);
+
+    fprintf(out, "\n]}\n");
+
+    if (fclose(out) && !ret)
+        ret = -errno;
+out_close_in:
+    fclose(in);
+    return ret;
+}
+
+#else /* WITH_TRACE */
+
+void iio_trace(__notused enum iio_trace_event event, __notused uint32_t arg)
+{
+}
+
+int iio_trace_dump(__notused const char *path)
+{
+    return -ENOSYS;
+}
+
+int iio_trace_dump_on_signal(__notused int signum, __notused const char *path)
+{
+    return -ENOSYS;
+}
+
+int iio_trace_convert_json(__notused const char *dump,
+        __notused const char *json)
+{
+    return -ENOSYS;
+}
+
+#endif /* WITH_TRACE */
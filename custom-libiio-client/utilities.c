@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #if defined(_WIN32) || (defined(__USE_XOPEN2K8) && \
         (!defined(__UCLIBC__) || defined(__UCLIBC_HAS_LOCALE__)))
@@ -212,3 +213,46 @@ char *iio_strdup(const char *str)
     return buf;
 #endif
 }
+
+uint64_t iio_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+int iio_hash_index_init(struct iio_hash_index *idx, unsigned int nb_keys)
+{
+    unsigned int size = 4;
+
+    /* Keep the load factor at or below 50% */
+    while (size < 2 * nb_keys)
+        size <<= 1;
+
+    idx->slots = calloc(size, sizeof(*idx->slots));
+    if (!idx->slots)
+        return -ENOMEM;
+
+    idx->mask = size - 1;
+    return 0;
+}
+
+void iio_hash_index_add(struct iio_hash_index *idx,
+        const char *key, unsigned int index)
+{
+    uint32_t hash = iio_hash_str(key);
+    unsigned int slot = hash;
+
+    while (idx->slots[slot & idx->mask].index)
+        slot++;
+
+    idx->slots[slot & idx->mask].hash = hash;
+    idx->slots[slot & idx->mask].index = index + 1;
+}
+
+void iio_hash_index_free(struct iio_hash_index *idx)
+{
+    free(idx->slots);
+    idx->slots = NULL;
+}
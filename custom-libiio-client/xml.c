@@ -310,7 +310,7 @@ err_free_device:
 
 static struct iio_context * xml_clone(const struct iio_context *ctx)
 {
-    return xml_create_context_mem(ctx->xml, strlen(ctx->xml));
+    return iio_context_clone_metadata(ctx);
 }
 
 static const struct iio_backend_ops xml_ops = {
@@ -336,11 +336,14 @@ static int parse_context_attr(struct iio_context *ctx, xmlNode *n)
         return iio_context_add_attr(ctx, name, value);
 }
 
-static struct iio_context * iio_create_xml_context_helper(xmlDoc *doc)
+/* 'start_ns' is the time the parsing of the document started */
+static struct iio_context * iio_create_xml_context_helper(xmlDoc *doc,
+        uint64_t start_ns)
 {
     unsigned int i;
     xmlNode *root, *n;
     xmlAttr *attr;
+    uint64_t init_ns, end_ns;
     int err = -ENOMEM;
     struct iio_context *ctx = zalloc(sizeof(*ctx));
     if (!ctx)
@@ -409,10 +412,15 @@ static struct iio_context * iio_create_xml_context_helper(xmlDoc *doc)
         ctx->devices = devs;
     }
 
+    init_ns = iio_time_ns();
     err = iio_context_init(ctx);
     if (err)
         goto err_free_devices;
 
+    end_ns = iio_time_ns();
+    ctx->profile.phase_ns[IIO_CONTEXT_PHASE_PARSE] = init_ns - start_ns;
+    ctx->profile.phase_ns[IIO_CONTEXT_PHASE_INIT] = end_ns - init_ns;
+    ctx->profile.total_ns = end_ns - start_ns;
     return ctx;
 
 err_free_devices:
@@ -436,6 +444,7 @@ err_set_errno:
 struct iio_context * xml_create_context(const char *xml_file)
 {
     struct iio_context *ctx;
+    uint64_t start_ns = iio_time_ns();
     xmlDoc *doc;
 
     LIBXML_TEST_VERSION;
@@ -447,7 +456,7 @@ struct iio_context * xml_create_context(const char *xml_file)
         return NULL;
     }
 
-    ctx = iio_create_xml_context_helper(doc);
+    ctx = iio_create_xml_context_helper(doc, start_ns);
     xmlFreeDoc(doc);
     return ctx;
 }
@@ -455,6 +464,7 @@ struct iio_context * xml_create_context(const char *xml_file)
 struct iio_context * xml_create_context_mem(const char *xml, size_t len)
 {
     struct iio_context *ctx;
+    uint64_t start_ns = iio_time_ns();
     xmlDoc *doc;
 
     LIBXML_TEST_VERSION;
@@ -466,7 +476,7 @@ struct iio_context * xml_create_context_mem(const char *xml, size_t len)
         return NULL;
     }
 
-    ctx = iio_create_xml_context_helper(doc);
+    ctx = iio_create_xml_context_helper(doc, start_ns);
     xmlFreeDoc(doc);
     return ctx;
 }
@@ -15,6 +15,7 @@
  *
  */
 
+#include <signal.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <cstdlib>
@@ -39,36 +40,92 @@ struct idMap iM[MAX_SENSOR] = {{"accel_3d", 0, SENSOR_TYPE_ACCELEROMETER},
         {"gyro_3d", 7, SENSOR_TYPE_GYROSCOPE},
         {"als", 8, SENSOR_TYPE_LIGHT}};
 
-iioClient::iioClient()
+iioClient::iioClient() : uri(NULL), sensorList(NULL), sensorCount(0),
+        ctx(NULL), pollList(NULL), pollCount(0), pendingReads(0),
+        asyncPoll(true), asyncRetryNs(0)
 {
+    memset(stats, 0, sizeof(stats));
+    init();
+}
+
+/*
+ * Connects to this URI instead of the one the properties give, e.g. from
+ * a benchmark running on the build host
+ */
+iioClient::iioClient(const char *uri) : uri(uri), sensorList(NULL),
+        sensorCount(0), ctx(NULL), pollList(NULL), pollCount(0),
+        pendingReads(0), asyncPoll(true), asyncRetryNs(0)
+{
+    memset(stats, 0, sizeof(stats));
     init();
-    sensorCount = 0;
-    ctx = NULL;
-    sensorList = NULL;
 }
 
 iioClient::~iioClient()
 {
+    release();
+
     if (ctx)
         iio_context_destroy(ctx);
 
-    if (sensorList)
-        free(sensorList);
+    delete[] sensorList;
 }
 
 int iioClient::init(void)
 {
     char value[PROPERTY_VALUE_MAX] = {0};
 
+    /* Starts over from a new context; destroying the previous one also
+     * closes its recording */
+    release();
+    if (ctx)
+        iio_context_destroy(ctx);
+    delete[] sensorList;
+
     ctx = NULL;
+    sensorList = NULL;
     sensorCount = 0;
-    property_get("vendor.intel.ipaddr", value, " ");
-    ctx = iio_create_network_context(value);
+    asyncRetryNs = 0;
+    /* An explicit URI takes precedence, e.g. "vsock:2" to reach the host
+     * without any IP configuration, or a local stand-in of the IIO Daemon
+     * ("unix:/path") when profiling */
+    property_get(IIO_URI_PROPERTY, value, "");
+    if (uri) {
+        ctx = iio_create_context_from_uri(uri);
+    } else if (value[0]) {
+        ctx = iio_create_context_from_uri(value);
+    } else {
+        property_get("vendor.intel.ipaddr", value, " ");
+        ctx = iio_create_network_context(value);
+    }
     if (!ctx) {
         ALOGE("Sensor: Error in Initializing IIO Client with N/W backend\n");
         return -1;
     }
 
+    struct iio_context_profile profile;
+    iio_context_get_profile(ctx, &profile);
+    ALOGI("Sensor: Context created in %.1f ms: resolve %.1f, connect %.1f, "
+          "handshake %.1f, fetch %.1f, parse %.1f, init %.1f, setup %.1f\n",
+          profile.total_ns / 1e6,
+          profile.phase_ns[IIO_CONTEXT_PHASE_RESOLVE] / 1e6,
+          profile.phase_ns[IIO_CONTEXT_PHASE_CONNECT] / 1e6,
+          profile.phase_ns[IIO_CONTEXT_PHASE_HANDSHAKE] / 1e6,
+          profile.phase_ns[IIO_CONTEXT_PHASE_FETCH] / 1e6,
+          profile.phase_ns[IIO_CONTEXT_PHASE_PARSE] / 1e6,
+          profile.phase_ns[IIO_CONTEXT_PHASE_INIT] / 1e6,
+          profile.phase_ns[IIO_CONTEXT_PHASE_SETUP] / 1e6);
+
+    /* With a library built WITH_TRACE, SIGUSR2 writes the events of the
+     * last polls to this file */
+    property_get(IIO_TRACE_PROPERTY, value, "");
+    if (value[0] && iio_trace_dump_on_signal(SIGUSR2, value) < 0)
+        ALOGW("Sensor: Unable to dump the trace to %s\n", value);
+
+    /* Capture what the sensors return, to be served again with replay: */
+    property_get(IIO_RECORD_PROPERTY, value, "");
+    if (value[0] && iio_context_start_recording(ctx, value) < 0)
+        ALOGW("Sensor: Unable to record to %s\n", value);
+
     int nb_devices = iio_context_get_devices_count(ctx);
     for (int i = 0; i < nb_devices; i++) {
         const struct iio_device *dev = iio_context_get_device(ctx, i);
@@ -79,12 +136,14 @@ int iioClient::init(void)
 
         unsigned int nb_channels = iio_device_get_channels_count(dev);
         if (nb_channels > 0) {
-            sensorCount++;
+            sensorCount = sensorCount + 1;
         }
     }
 
     if (!sensorCount) {
         ALOGE("Sensor:  Found zero sensors");
+        iio_context_destroy(ctx);
+        ctx = NULL;
         return -1;
     } else {
         ALOGI("Sensor: Sensor Count: %u\n", sensorCount);
@@ -100,7 +159,6 @@ int iioClient::init(void)
             continue;
         }
 
-        unsigned int nb_channels = iio_device_get_channels_count(dev);
         int index;
 
         sensorList[j].name = iio_device_get_name(dev);
@@ -129,9 +187,78 @@ int iioClient::init(void)
 
     sensorCount = j;
 
+    return prepare();
+}
+
+/*
+ * Resolves the attribute polled on each channel of each sensor, so that
+ * getPollData() does no lookups nor command formatting
+ */
+int iioClient::prepare(void)
+{
+    pollList = new pollEntry[sensorCount];
+    pollCount = 0;
+
+    for (int i = 0; i < sensorCount; i++) {
+        const struct iio_device *dev = iio_context_get_device(ctx, i);
+        if (!dev) {
+            ALOGE("Failed to get sensor device %d\n", i);
+            continue;
+        }
+
+        int index = compare(iio_device_get_name(dev));
+        if (index < 0)
+            continue;
+
+        unsigned int nb_channels = iio_device_get_channels_count(dev);
+        if (iM[index].type == SENSOR_TYPE_ACCELEROMETER)
+            nb_channels = nb_channels - 1;
+        if (nb_channels > MAX_CHANNEL)
+            nb_channels = MAX_CHANNEL;
+
+        struct pollEntry *entry = &pollList[pollCount];
+        entry->index = index;
+        entry->version = sensorList[pollCount].version;
+        entry->nb_channels = 0;
+
+        for (unsigned int j = 0; j < nb_channels; j++) {
+            const struct iio_channel *ch = iio_device_get_channel(dev, j);
+            const char *attr = ch ? iio_channel_get_attr(ch, 2) : NULL;
+            struct iio_attr_handle *handle = attr ?
+                    iio_channel_attr_prepare(ch, attr) : NULL;
+
+            if (!handle) {
+                ALOGE("Sensor: no attribute to poll on channel %u of %s\n",
+                        j, iM[index].name);
+                break;
+            }
+
+            entry->reads[entry->nb_channels++].attr = handle;
+        }
+
+        if (entry->nb_channels < nb_channels) {
+            for (unsigned int j = 0; j < entry->nb_channels; j++)
+                iio_attr_handle_destroy(entry->reads[j].attr);
+            continue;
+        }
+
+        pollCount++;
+    }
+
     return 0;
 }
 
+void iioClient::release(void)
+{
+    for (int i = 0; i < pollCount; i++)
+        for (unsigned int j = 0; j < pollList[i].nb_channels; j++)
+            iio_attr_handle_destroy(pollList[i].reads[j].attr);
+
+    delete[] pollList;
+    pollList = NULL;
+    pollCount = 0;
+}
+
 sensor_t * iioClient::getSensorList(void)
 {
     return sensorList;
@@ -157,60 +284,330 @@ int iioClient::compare(const char *name)
     return -1;
 }
 
+void iioClient::pollReadDone(ssize_t ret, void *d)
+{
+    struct pollRead *rd = (struct pollRead *) d;
+
+    rd->doneNs = get_timestamp(CLOCK_MONOTONIC);
+    rd->ret = ret;
+    (*rd->pending)--;
+}
+
+/*
+ * Sends the reads of all the channels back to back, then collects the
+ * replies, so that the link to the server is never idle during a poll
+ */
+int iioClient::fetchAsync(void)
+{
+    int64_t deadline = get_timestamp(CLOCK_MONOTONIC) +
+            POLL_TIMEOUT_MS * 1000000LL;
+
+    pendingReads = 0;
+    for (int k = 0; k < pollCount; k++) {
+        struct pollEntry *entry = &pollList[k];
+
+        for (unsigned int j = 0; j < entry->nb_channels; j++) {
+            struct pollRead *rd = &entry->reads[j];
+            int ret;
+
+            rd->pending = &pendingReads;
+            rd->sentNs = get_timestamp(CLOCK_MONOTONIC);
+            ret = iio_attr_handle_read_async(rd->attr, rd->value,
+                    sizeof(rd->value), pollReadDone, rd);
+            if (ret < 0)
+                return ret;
+
+            pendingReads++;
+        }
+    }
+
+    while (pendingReads > 0) {
+        int ret = iio_context_process_async(ctx, POLL_TIMEOUT_MS);
+        if (ret < 0)
+            return ret;
+
+        if (pendingReads > 0 && get_timestamp(CLOCK_MONOTONIC) > deadline)
+            return -ETIMEDOUT;
+    }
+
+    return 0;
+}
+
 /*
  * Receives sensor data from server
  */
 int iioClient::getPollData(sensors_event_t* data)
 {
-    while (!sensorCount || !ctx) {
+    /* init() only keeps the context once it has found sensors */
+    while (!ctx) {
         sleep(1);
         init();
     }
 
-    int k = 0;
-    for (int i = 0; i < sensorCount; i++, k++) {
-        unsigned type;
-        const struct iio_device *dev = iio_context_get_device(ctx, i);
-        if (!dev) {
-            ALOGE("Failed to get sensor device %d\n", i);
-            k -= 1;
-            continue;
+    iio_trace(IIO_TRACE_POLL_BEGIN, 0);
+
+    int64_t start = get_timestamp(CLOCK_MONOTONIC);
+    asyncPoll = start >= asyncRetryNs;
+    if (asyncPoll) {
+        int ret = fetchAsync();
+
+        if (ret < 0) {
+            ALOGW("Sensor: asynchronous reads failed (%d), "
+                  "using blocking reads\n", ret);
+
+            /* Completes the reads still queued, which point into
+             * pollList; the next attempt opens a new connection */
+            iio_context_cancel_async(ctx);
+            asyncPoll = false;
+
+            if (ret == -ENOSYS)
+                asyncRetryNs = INT64_MAX;
+            else
+                asyncRetryNs = start + ASYNC_RETRY_MS * 1000000LL;
         }
+    }
 
-        unsigned int nb_channels = iio_device_get_channels_count(dev);
-        int index = compare(iio_device_get_name(dev));
+    for (int k = 0; k < pollCount; k++) {
+        struct pollEntry *entry = &pollList[k];
 
-        if (index < 0) {
-            k -= 1;
+        data[k].sensor = iM[entry->index].id;
+        data[k].type = iM[entry->index].type;
+        data[k].version = entry->version;
+        data[k].timestamp = get_timestamp(CLOCK_BOOTTIME);
+
+        if (!asyncPoll) {
+            for (unsigned int j = 0; j < entry->nb_channels; j++) {
+                struct pollRead *rd = &entry->reads[j];
+
+                rd->sentNs = get_timestamp(CLOCK_MONOTONIC);
+                rd->ret = iio_attr_handle_read(rd->attr,
+                        rd->value, sizeof(rd->value));
+                rd->doneNs = get_timestamp(CLOCK_MONOTONIC);
+            }
+        }
+
+        entry->parseNs = get_timestamp(CLOCK_MONOTONIC);
+        for (unsigned int j = 0; j < entry->nb_channels; j++) {
+            struct pollRead *rd = &entry->reads[j];
+
+            data[k].data[j] = rd->ret >= 0 ? strtof(rd->value, NULL) : 0.0f;
+        }
+        entry->parsedNs = get_timestamp(CLOCK_MONOTONIC);
+
+        iio_trace(IIO_TRACE_EVENT_EMIT, (uint32_t) data[k].sensor);
+    }
+
+    int64_t now = get_timestamp(CLOCK_MONOTONIC);
+    for (int k = 0; k < pollCount; k++)
+        account(&pollList[k], now);
+
+    iio_trace(IIO_TRACE_POLL_END, (uint32_t) pollCount);
+    return pollCount;
+}
+
+static unsigned int latencyBucket(uint64_t ns)
+{
+    unsigned int order, index;
+
+    if (ns < STATS_SUB_BUCKETS)
+        return (unsigned int) ns;
+
+    order = 63 - __builtin_clzll(ns);
+    index = (order - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS +
+        ((ns >> (order - STATS_SUB_BITS)) & (STATS_SUB_BUCKETS - 1));
+
+    return index < STATS_NB_BUCKETS ? index : STATS_NB_BUCKETS - 1;
+}
+
+/* Smallest duration counted in a bucket */
+static uint64_t latencyBucketStart(unsigned int index)
+{
+    unsigned int order = index / STATS_SUB_BUCKETS + STATS_SUB_BITS - 1;
+
+    if (index < STATS_SUB_BUCKETS)
+        return index;
+
+    return (uint64_t) (STATS_SUB_BUCKETS + index % STATS_SUB_BUCKETS) <<
+        (order - STATS_SUB_BITS);
+}
+
+/* Only called by the polling thread: the counters have a single writer */
+static void latencyRecord(struct latencyHistogram *h, int64_t ns)
+{
+    uint64_t value = ns > 0 ? (uint64_t) ns : 0;
+
+    __atomic_fetch_add(&h->buckets[latencyBucket(value)], 1,
+            __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sumNs, value, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    if (value > h->maxNs)
+        __atomic_store_n(&h->maxNs, value, __ATOMIC_RELAXED);
+}
+
+/*
+ * Accounts for the event just built from this entry. The reads sent
+ * asynchronously wait for the end of the poll before being converted,
+ * which is the time they spend queued.
+ */
+void iioClient::account(struct pollEntry *entry, int64_t deliveredNs)
+{
+    struct sensorStats *st = &stats[entry->index];
+    int64_t firstNs = entry->parseNs;
+    bool failed = false;
+
+    for (unsigned int j = 0; j < entry->nb_channels; j++) {
+        struct pollRead *rd = &entry->reads[j];
+
+        if (rd->sentNs < firstNs)
+            firstNs = rd->sentNs;
+
+        if (rd->ret < 0) {
+            __atomic_fetch_add(&st->readErrors, 1, __ATOMIC_RELAXED);
+            failed = true;
             continue;
         }
 
-        data[k].sensor = iM[index].id;
-        data[k].type = iM[index].type;
-        data[k].version = sensorList[i].version;
-        data[k].timestamp = get_timestamp(CLOCK_BOOTTIME);
-        if (data[k].type == SENSOR_TYPE_ACCELEROMETER) {
-           nb_channels = nb_channels - 1;
+        latencyRecord(&st->latency[LATENCY_RTT], rd->doneNs - rd->sentNs);
+        if (asyncPoll)
+            latencyRecord(&st->latency[LATENCY_QUEUE],
+                    entry->parseNs - rd->doneNs);
+    }
+
+    latencyRecord(&st->latency[LATENCY_PARSE],
+            entry->parsedNs - entry->parseNs);
+    latencyRecord(&st->latency[LATENCY_AGE], deliveredNs - firstNs);
+
+    if (failed)
+        __atomic_fetch_add(&st->dropped, 1, __ATOMIC_RELAXED);
+    if (!st->firstEventNs)
+        __atomic_store_n(&st->firstEventNs, deliveredNs, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->lastEventNs, deliveredNs, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&st->events, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Copies the statistics of the sensor with this handle, while they are
+ * being updated; the fields are consistent one by one, not together.
+ */
+bool iioClient::getStats(int handle, struct sensorStats *out)
+{
+    const struct sensorStats *st = NULL;
+
+    for (int i = 0; i < MAX_SENSOR; i++)
+        if (iM[i].id == handle)
+            st = &stats[i];
+    if (!st)
+        return false;
+
+    out->events = __atomic_load_n(&st->events, __ATOMIC_RELAXED);
+    out->readErrors = __atomic_load_n(&st->readErrors, __ATOMIC_RELAXED);
+    out->dropped = __atomic_load_n(&st->dropped, __ATOMIC_RELAXED);
+    out->firstEventNs = __atomic_load_n(&st->firstEventNs, __ATOMIC_RELAXED);
+    out->lastEventNs = __atomic_load_n(&st->lastEventNs, __ATOMIC_RELAXED);
+
+    for (int i = 0; i < NB_LATENCIES; i++) {
+        const struct latencyHistogram *h = &st->latency[i];
+        struct latencyHistogram *o = &out->latency[i];
+
+        o->count = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+        o->sumNs = __atomic_load_n(&h->sumNs, __ATOMIC_RELAXED);
+        o->maxNs = __atomic_load_n(&h->maxNs, __ATOMIC_RELAXED);
+        for (int j = 0; j < STATS_NB_BUCKETS; j++)
+            o->buckets[j] = __atomic_load_n(&h->buckets[j],
+                    __ATOMIC_RELAXED);
+    }
+
+    return true;
+}
+
+/* Upper bound of the given quantile, in microseconds */
+static double latencyQuantile(const struct latencyHistogram *h, double q)
+{
+    uint64_t rank = (uint64_t) (q * h->count), seen = 0;
+
+    for (unsigned int i = 0; i + 1 < STATS_NB_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen > rank) {
+            uint64_t end = latencyBucketStart(i + 1) - 1;
+
+            return (end < h->maxNs ? end : h->maxNs) / 1000.0;
         }
-        for (int j = 0; j < nb_channels; j++) {
-            struct iio_channel *ch = iio_device_get_channel(dev, j);
-            if (!ch) {
-                k -= 1;
-                continue;
-            }
+    }
 
-            const char *attr = iio_channel_get_attr(ch, 2);
-            if (!attr) {
-                k -= 1;
-                continue;
-            }
+    return h->maxNs / 1000.0;
+}
+
+/*
+ * Writes the counters and latencies of each sensor polled so far, as
+ * text, e.g. for dumpsys or from a test
+ */
+void iioClient::dumpStats(int fd)
+{
+    static const char *names[NB_LATENCIES] = {
+        "rtt", "queue", "parse", "age",
+    };
+    struct sensorStats st;
+
+    for (int i = 0; i < MAX_SENSOR; i++) {
+        if (!getStats(iM[i].id, &st) || !st.events)
+            continue;
+
+        double elapsed = (st.lastEventNs - st.firstEventNs) / 1e9;
 
-            char buf[1024];
+        dprintf(fd, "%s: %llu events, %.1f Hz, %llu read errors, "
+                "%llu dropped\n", iM[i].name,
+                (unsigned long long) st.events,
+                elapsed > 0 ? (st.events - 1) / elapsed : 0.0,
+                (unsigned long long) st.readErrors,
+                (unsigned long long) st.dropped);
 
-            iio_channel_attr_read(ch, attr, buf, sizeof(buf));
-            data[k].data[j] = strtof(buf, NULL);
+        for (int j = 0; j < NB_LATENCIES; j++) {
+            const struct latencyHistogram *h = &st.latency[j];
+
+            if (!h->count)
+                continue;
+
+            dprintf(fd, "  %-5s n=%llu mean=%.1fus p50=%.1fus p99=%.1fus "
+                    "p99.9=%.1fus max=%.1fus\n", names[j],
+                    (unsigned long long) h->count,
+                    h->sumNs / 1000.0 / h->count,
+                    latencyQuantile(h, 0.5), latencyQuantile(h, 0.99),
+                    latencyQuantile(h, 0.999), h->maxNs / 1000.0);
         }
     }
 
-    return k;
+    /* Only with a library built WITH_LOCK_STATS */
+    struct iio_lock_stats locks[32];
+    ssize_t nb_locks = iio_get_lock_stats(locks, 32);
+
+    for (ssize_t i = 0; i < nb_locks && i < 32; i++) {
+        const struct iio_lock_stats *l = &locks[i];
+
+        if (!l->acquisitions)
+            continue;
+
+        dprintf(fd, "lock %s: %llu taken, %llu contended, wait mean=%.1fus "
+                "max=%.1fus, hold mean=%.1fus max=%.1fus\n", l->site,
+                (unsigned long long) l->acquisitions,
+                (unsigned long long) l->contentions,
+                l->contentions ? l->wait_ns / 1000.0 / l->contentions : 0.0,
+                l->max_wait_ns / 1000.0,
+                l->hold_ns / 1000.0 / l->acquisitions,
+                l->max_hold_ns / 1000.0);
+    }
+}
+
+/* Forces the blocking reads, or lets the asynchronous ones be tried again */
+void iioClient::setAsyncPoll(bool enable)
+{
+    asyncRetryNs = enable ? 0 : INT64_MAX;
+}
+
+/* Statistics of the commands sent to the server, see iio_context_get_stats */
+int iioClient::getContextStats(struct iio_context_stats *out)
+{
+    if (!ctx)
+        return -ENODEV;
+
+    return iio_context_get_stats(ctx, out);
 }
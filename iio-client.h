@@ -32,6 +32,13 @@
 #include "custom-libiio-client/iio.h"
 
 #define MAX_SENSOR 9
+#define MAX_CHANNEL 16
+#define MAX_VALUE_LEN 64
+#define POLL_TIMEOUT_MS 5000
+#define ASYNC_RETRY_MS 1000
+#define IIO_URI_PROPERTY "vendor.intel.iio_uri"
+#define IIO_RECORD_PROPERTY "vendor.intel.iio_record"
+#define IIO_TRACE_PROPERTY "vendor.intel.iio_trace"
 
 struct idMap {
     const char *name;
@@ -39,19 +46,85 @@ struct idMap {
     int type;
 };
 
+/* Histogram of durations in nanoseconds, with STATS_SUB_BUCKETS buckets
+ * per power of two up to 2^STATS_MAX_ORDER ns (about 18 minutes) */
+#define STATS_SUB_BITS 2
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BITS)
+#define STATS_MAX_ORDER 40
+#define STATS_NB_BUCKETS (STATS_MAX_ORDER * STATS_SUB_BUCKETS)
+
+struct latencyHistogram {
+    uint64_t count;
+    uint64_t sumNs;
+    uint64_t maxNs;
+    uint64_t buckets[STATS_NB_BUCKETS];
+};
+
+enum sensorLatency {
+    LATENCY_RTT,        /* Read of a channel, from request to reply */
+    LATENCY_QUEUE,      /* Reply of an asynchronous read, until used */
+    LATENCY_PARSE,      /* Conversion of the values of an event */
+    LATENCY_AGE,        /* First request of an event, until delivered */
+    NB_LATENCIES,
+};
+
+/* Only updated by the polling thread; readable from any other thread */
+struct sensorStats {
+    uint64_t events;        /* Events delivered */
+    uint64_t readErrors;    /* Reads of a channel that failed */
+    uint64_t dropped;       /* Events delivered without their values */
+    int64_t firstEventNs;   /* CLOCK_MONOTONIC, to get the rate */
+    int64_t lastEventNs;
+    struct latencyHistogram latency[NB_LATENCIES];
+};
+
+/* Attribute resolved once by prepare(), read on every poll */
+struct pollRead {
+    struct iio_attr_handle *attr;
+    char value[MAX_VALUE_LEN];
+    ssize_t ret;
+    int *pending;
+    int64_t sentNs, doneNs;
+};
+
+struct pollEntry {
+    int index;
+    int version;
+    unsigned int nb_channels;
+    struct pollRead reads[MAX_CHANNEL];
+    int64_t parseNs, parsedNs;
+};
+
 class iioClient {
  public:
     iioClient();
+    explicit iioClient(const char *uri);
     ~iioClient();
     int getPollData(sensors_event_t *);
+    bool getStats(int handle, struct sensorStats *);
+    void dumpStats(int fd);
+    void setAsyncPoll(bool enable);
+    int getContextStats(struct iio_context_stats *);
 
  private:
+    const char *uri;
     sensor_t *sensorList;
     volatile int sensorCount;
     struct iio_context *ctx;
+    struct pollEntry *pollList;
+    int pollCount;
+    int pendingReads;
+    bool asyncPoll;
+    int64_t asyncRetryNs;
+    struct sensorStats stats[MAX_SENSOR];
     int compare(const char *);
-    int64_t get_timestamp(clockid_t);
+    static int64_t get_timestamp(clockid_t);
+    static void pollReadDone(ssize_t, void *);
     sensor_t *getSensorList(void);
     int init(void);
+    int prepare(void);
+    void release(void);
+    int fetchAsync(void);
+    void account(struct pollEntry *, int64_t);
 };
 #endif  /*IIO_CLIENT_H_*/
@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Coroutine facade over the asynchronous functions of the IIO client.
+ *
+ * Acquisition code is written as plain sequential functions returning
+ * iioCoro::Task, which co_await the attribute reads, buffer refills and
+ * delays they need. All the tasks of an Executor run on the thread calling
+ * Executor::run(), which waits for the replies of the in-flight operations
+ * with iio_context_process_async(), so any number of pending operations
+ * share a single thread and a single connection:
+ *
+ *     iioCoro::Task<> acquire(iioCoro::Executor &exec, iio_attr_handle *h)
+ *     {
+ *         char value[64];
+ *
+ *         for (;;) {
+ *             ssize_t ret = co_await exec.readAttr(h, value, sizeof(value));
+ *             if (ret < 0)
+ *                 co_return (int) ret;
+ *             ...
+ *             co_await exec.sleep(10);
+ *         }
+ *     }
+ *
+ *     exec.spawn(acquire(exec, handle));
+ *     exec.run();
+ *
+ * Errors are reported as negative errno codes, like the rest of the client;
+ * the facade never throws. It is only available when building as C++20.
+ */
+
+#ifndef IIO_CORO_H_
+#define IIO_CORO_H_
+
+#if defined(__cplusplus) && __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<coroutine>)
+#define IIO_CORO_AVAILABLE 1
+#endif
+#endif
+
+#ifdef IIO_CORO_AVAILABLE
+
+#include <errno.h>
+#include <time.h>
+#include <algorithm>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "custom-libiio-client/iio.h"
+
+namespace iioCoro {
+
+/* Shortest wait between two attempts of reconnect() */
+constexpr unsigned int MIN_RETRY_MS = 10;
+
+class Executor;
+
+/* Lazily started coroutine producing a value of type T, which is an errno
+ * style int by default. Either co_await'ed by another task, or handed over
+ * to Executor::spawn() */
+template <typename T = int>
+class Task {
+ public:
+    struct promise_type;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<> await_suspend(handle_type h) noexcept;
+        void await_resume() noexcept {}
+    };
+
+    struct promise_type {
+        T value{};
+        std::coroutine_handle<> continuation;
+        Executor *owner = nullptr;
+
+        Task get_return_object()
+        {
+            return Task(handle_type::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_value(T v) { value = std::move(v); }
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    Task(Task &&other) noexcept :
+            handle(std::exchange(other.handle, nullptr)) {}
+    Task(const Task &) = delete;
+    Task & operator=(const Task &) = delete;
+    ~Task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    /* Awaiting a task starts it, and resumes the caller once it returns */
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<> caller) noexcept
+    {
+        handle.promise().continuation = caller;
+        return handle;
+    }
+    T await_resume() { return std::move(handle.promise().value); }
+
+ private:
+    friend class Executor;
+    explicit Task(handle_type h) : handle(h) {}
+    handle_type handle;
+};
+
+/* Runs the tasks of a context on the calling thread */
+class Executor {
+ public:
+    explicit Executor(struct iio_context *ctx = nullptr) : ctx(ctx) {}
+    Executor(const Executor &) = delete;
+    Executor & operator=(const Executor &) = delete;
+
+    struct iio_context * context() const { return ctx; }
+
+    /* Must not be called while operations are in flight on the previous
+     * context, as their tasks would then never be resumed */
+    void attach(struct iio_context *c) { ctx = c; }
+
+    /* Starts a task, which is destroyed by the executor when it returns.
+     * Its return value is discarded. */
+    template <typename T>
+    void spawn(Task<T> task)
+    {
+        typename Task<T>::handle_type h = std::exchange(task.handle, nullptr);
+
+        h.promise().owner = this;
+        live++;
+        schedule(h);
+    }
+
+    /*
+     * Runs the tasks until they have all returned.
+     * Returns 0 on success, the negative errno code returned by
+     * iio_context_process_async() on failure, or -EDEADLK if some tasks are
+     * left waiting for something that can never happen.
+     */
+    int run()
+    {
+        while (live > 0) {
+            while (!ready.empty()) {
+                std::coroutine_handle<> h = ready.front();
+
+                ready.pop_front();
+                h.resume();
+            }
+
+            if (!live)
+                break;
+
+            int timeout_ms = expireTimers();
+            if (!ready.empty())
+                continue;
+
+            if (ctx && inflight > 0) {
+                int ret = iio_context_process_async(ctx, timeout_ms);
+                if (ret < 0)
+                    return ret;
+            } else if (timeout_ms >= 0) {
+                struct timespec ts = {timeout_ms / 1000,
+                        (timeout_ms % 1000) * 1000000L};
+
+                nanosleep(&ts, NULL);
+            } else {
+                return -EDEADLK;
+            }
+        }
+
+        return 0;
+    }
+
+    /* Awaitable completing with the result of an asynchronous operation */
+    class Operation {
+     public:
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            int r;
+
+            waiter = h;
+            r = submit(this);
+            if (r < 0) {
+                ret = r;
+                return false;
+            }
+
+            exec->inflight++;
+            return true;
+        }
+        ssize_t await_resume() const noexcept { return ret; }
+
+     private:
+        friend class Executor;
+        Operation(Executor *exec, std::function<int(Operation *)> submit) :
+                exec(exec), submit(std::move(submit)) {}
+
+        static void done(ssize_t ret, void *d)
+        {
+            Operation *op = static_cast<Operation *>(d);
+
+            op->ret = ret;
+            op->exec->inflight--;
+            op->exec->schedule(op->waiter);
+        }
+
+        static void bufferDone(struct iio_buffer *, ssize_t ret, void *d)
+        {
+            done(ret, d);
+        }
+
+        Executor *exec;
+        std::function<int(Operation *)> submit;
+        std::coroutine_handle<> waiter;
+        ssize_t ret = 0;
+    };
+
+    /* Resumes with the number of bytes read, or a negative errno code */
+    Operation readAttr(const struct iio_attr_handle *handle,
+            char *dst, size_t len)
+    {
+        return Operation(this, [=](Operation *op) {
+            return iio_attr_handle_read_async(handle, dst, len,
+                    Operation::done, op);
+        });
+    }
+
+    Operation readAttr(const struct iio_channel *chn, const char *attr,
+            char *dst, size_t len)
+    {
+        return Operation(this, [=](Operation *op) {
+            return iio_channel_attr_read_async(chn, attr, dst, len,
+                    Operation::done, op);
+        });
+    }
+
+    /* Resumes with the number of bytes written, or a negative errno code */
+    Operation writeAttr(const struct iio_channel *chn, const char *attr,
+            const char *src)
+    {
+        return Operation(this, [=](Operation *op) {
+            return iio_channel_attr_write_async(chn, attr, src,
+                    Operation::done, op);
+        });
+    }
+
+    /* Resumes with the number of bytes read into the buffer, or a negative
+     * errno code */
+    Operation refill(struct iio_buffer *buf)
+    {
+        return Operation(this, [=](Operation *op) {
+            return iio_buffer_refill_async(buf, Operation::bufferDone, op);
+        });
+    }
+
+    /* Resumes after the given delay; the other tasks keep running */
+    class Sleep {
+     public:
+        bool await_ready() const noexcept { return !ms; }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            exec->addTimer(now() + ms * 1000000LL, h);
+        }
+        void await_resume() const noexcept {}
+
+     private:
+        friend class Executor;
+        Sleep(Executor *exec, unsigned int ms) : exec(exec), ms(ms) {}
+
+        Executor *exec;
+        unsigned int ms;
+    };
+
+    Sleep sleep(unsigned int ms) { return Sleep(this, ms); }
+
+ private:
+    template <typename T> friend class Task;
+
+    struct Timer {
+        int64_t deadline;
+        std::coroutine_handle<> h;
+
+        bool operator>(const Timer &other) const
+        {
+            return deadline > other.deadline;
+        }
+    };
+
+    static int64_t now()
+    {
+        struct timespec ts = {0, 0};
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return 1000000000LL * ts.tv_sec + ts.tv_nsec;
+    }
+
+    void schedule(std::coroutine_handle<> h) { ready.push_back(h); }
+
+    void addTimer(int64_t deadline, std::coroutine_handle<> h)
+    {
+        timers.push_back({deadline, h});
+        std::push_heap(timers.begin(), timers.end(), std::greater<Timer>());
+    }
+
+    /* Schedules the tasks whose delay has expired, and returns the time to
+     * wait for the next one in milliseconds, or -1 if there is none */
+    int expireTimers()
+    {
+        int64_t t = now();
+
+        while (!timers.empty() && timers.front().deadline <= t) {
+            std::pop_heap(timers.begin(), timers.end(), std::greater<Timer>());
+            schedule(timers.back().h);
+            timers.pop_back();
+        }
+
+        if (timers.empty())
+            return -1;
+
+        /* Round up, not to wake up right before the deadline */
+        return (int) ((timers.front().deadline - t + 999999) / 1000000);
+    }
+
+    void taskDone() { live--; }
+
+    struct iio_context *ctx;
+    std::deque<std::coroutine_handle<>> ready;
+    std::vector<Timer> timers;
+    unsigned int live = 0;
+    int inflight = 0;
+};
+
+template <typename T>
+std::coroutine_handle<> Task<T>::FinalAwaiter::await_suspend(
+        handle_type h) noexcept
+{
+    promise_type &p = h.promise();
+
+    if (p.continuation)
+        return p.continuation;
+
+    /* Spawned task: nobody holds the frame anymore */
+    if (p.owner) {
+        p.owner->taskDone();
+        h.destroy();
+    }
+
+    return std::noop_coroutine();
+}
+
+/*
+ * Replaces the context of the executor with a new one created from the given
+ * URI, trying again every retry_ms until it succeeds. The old context is
+ * destroyed, so the other tasks must not have any operation in flight.
+ * Creating the context blocks the executor thread, only the waits between
+ * two attempts let the other tasks run. A retry_ms below MIN_RETRY_MS is
+ * raised to it: a zero delay completes at once, and the loop would then
+ * never let the other tasks run.
+ */
+inline Task<> reconnect(Executor &exec, const char *uri, unsigned int retry_ms)
+{
+    struct iio_context *ctx = exec.context();
+
+    retry_ms = std::max(retry_ms, MIN_RETRY_MS);
+
+    exec.attach(nullptr);
+    if (ctx)
+        iio_context_destroy(ctx);
+
+    while (!(ctx = iio_create_context_from_uri(uri)))
+        co_await exec.sleep(retry_ms);
+
+    exec.attach(ctx);
+    co_return 0;
+}
+
+}  // namespace iioCoro
+
+#endif  /* IIO_CORO_AVAILABLE */
+#endif  /* IIO_CORO_H_ */
@@ -302,6 +302,15 @@ static int poll__close(struct hw_device_t *dev)
     return 0;
 }
 
+/*
+ * Writes the counters and latency histograms of each sensor as text, for
+ * the debug command of the sensors service or for a test loading the module
+ */
+extern "C" void sensor_hal_dump_stats(int fd)
+{
+    iioc.dumpStats(fd);
+}
+
 static int open_sensors(const struct hw_module_t* module, const char* id,
                     struct hw_device_t** device)
 {
@@ -313,6 +322,7 @@ static int open_sensors(const struct hw_module_t* module, const char* id,
     dev.common.module = const_cast<hw_module_t *>(module);
     dev.common.close = poll__close;
     dev.activate = poll__activate;
+    dev.setDelay = poll__setDelay;
     dev.poll = poll__poll;
     dev.batch = poll__batch;
     dev.flush = poll__flush;
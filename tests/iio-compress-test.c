@@ -0,0 +1,218 @@
+/*
+ * iio-compress-test - Round trip of the compressed frames
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+/*
+ * Encodes payloads of every kind the server sends (XML, sensor samples,
+ * noise) as frames, with and without the delta filter, and decodes them
+ * back: they must come out intact and never exceed IIO_FRAME_MAX_LEN.
+ * Then feeds the decoder truncated and corrupted frames, which it must
+ * reject without writing past its output.
+ *
+ * Usage: iio-compress-test
+ */
+
+#include "compress.h"
+#include "iio.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_MAX_LEN 65536
+#define TEST_SAMPLE_SIZE 16
+#define TEST_GUARD 0xa5
+
+static uint8_t src[TEST_MAX_LEN], frame[IIO_FRAME_MAX_LEN(TEST_MAX_LEN)];
+static uint8_t dst[TEST_MAX_LEN + 64];
+static uint64_t seed = 0x2545f4914f6cdd1dULL;
+
+static uint32_t test_random(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return (uint32_t) seed;
+}
+
+static void fill_noise(uint8_t *buf, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        buf[i] = (uint8_t) test_random();
+}
+
+static void fill_xml(uint8_t *buf, size_t len)
+{
+    static const char pattern[] = "<channel id=\"accel_x\" type=\"input\" >"
+        "<scan-element index=\"0\" format=\"le:s32/32&gt;&gt;0\" />"
+        "<attribute name=\"raw\" /></channel>";
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        buf[i] = (uint8_t) pattern[i % (sizeof(pattern) - 1)];
+}
+
+/* Slowly changing channels and a timestamp, as a sensor sends them */
+static void fill_samples(uint8_t *buf, size_t len)
+{
+    int32_t sample[TEST_SAMPLE_SIZE / 4] = { 1000, -2000, 9810, 0 };
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        if (!(i % TEST_SAMPLE_SIZE)) {
+            sample[0] += (int32_t) (test_random() % 5) - 2;
+            sample[1] += (int32_t) (test_random() % 3) - 1;
+            sample[3] += 10000;
+        }
+        buf[i] = ((const uint8_t *) sample)[i % TEST_SAMPLE_SIZE];
+    }
+}
+
+static int round_trip(const char *name, size_t len, size_t stride)
+{
+    ssize_t wire_len, ret;
+
+    wire_len = iio_frame_encode(src, len, frame, sizeof(frame), stride);
+    if (wire_len < 0) {
+        fprintf(stderr, "%s: encoding failed: %zd\n", name, wire_len);
+        return -EIO;
+    }
+
+    if ((size_t) wire_len > IIO_FRAME_MAX_LEN(len) ||
+            iio_frame_get_raw_len(frame) != len) {
+        fprintf(stderr, "%s: bad frame of %zd bytes\n", name, wire_len);
+        return -EIO;
+    }
+
+    memset(dst, TEST_GUARD, sizeof(dst));
+    ret = iio_frame_decode(frame, (size_t) wire_len, dst, len, NULL);
+    if (ret != (ssize_t) len || memcmp(src, dst, len) ||
+            dst[len] != TEST_GUARD) {
+        fprintf(stderr, "%s: %zu bytes, stride %zu: corrupted\n",
+                name, len, stride);
+        return -EIO;
+    }
+
+    printf("%s: %zu bytes, stride %zu -> %zd\n", name, len, stride,
+            wire_len);
+    return 0;
+}
+
+static int test_round_trips(void)
+{
+    static const size_t lengths[] = {
+        0, 1, 4, 12, 13, 254, 255, 256, 270, 4096, TEST_MAX_LEN,
+    };
+    unsigned int i;
+    int ret = 0;
+
+    for (i = 0; !ret && i < sizeof(lengths) / sizeof(*lengths); i++) {
+        size_t len = lengths[i];
+
+        memset(src, 0, len);
+        ret = round_trip("zeros", len, 0);
+
+        if (!ret) {
+            fill_noise(src, len);
+            ret = round_trip("noise", len, 0);
+        }
+        if (!ret) {
+            fill_xml(src, len);
+            ret = round_trip("xml", len, 0);
+        }
+        if (!ret) {
+            fill_samples(src, len);
+            ret = round_trip("samples", len, 0);
+        }
+        if (!ret)
+            ret = round_trip("samples", len, TEST_SAMPLE_SIZE);
+    }
+
+    return ret;
+}
+
+/* Every mutation must fail or decode within bounds, never overflow */
+static int test_malformed(void)
+{
+    ssize_t wire_len, ret;
+    size_t len = 4096, i;
+
+    fill_samples(src, len);
+    wire_len = iio_frame_encode(src, len, frame, sizeof(frame),
+            TEST_SAMPLE_SIZE);
+    if (wire_len < 0)
+        return -EIO;
+
+    /* Truncated anywhere, including within the header */
+    for (i = 0; i < (size_t) wire_len; i++) {
+        memset(dst, TEST_GUARD, sizeof(dst));
+        ret = iio_frame_decode(frame, i, dst, len, NULL);
+        if (ret >= 0 || dst[len] != TEST_GUARD) {
+            fprintf(stderr, "Truncated at %zu: %zd\n", i, ret);
+            return -EIO;
+        }
+    }
+
+    /* Announcing more than the output can hold */
+    ret = iio_frame_decode(frame, (size_t) wire_len, dst, len - 1, NULL);
+    if (ret >= 0) {
+        fprintf(stderr, "Frame decoded into a short buffer\n");
+        return -EIO;
+    }
+
+    /* Unknown method and filter */
+    for (i = 4; i < 6; i++) {
+        uint8_t saved = frame[i];
+
+        frame[i] = 0x7f;
+        ret = iio_frame_decode(frame, (size_t) wire_len, dst, len, NULL);
+        frame[i] = saved;
+        if (ret >= 0) {
+            fprintf(stderr, "Byte %zu of the header not checked\n", i);
+            return -EIO;
+        }
+    }
+
+    /* Random bytes in the body: any result but an overflow is fine */
+    for (i = 0; i < 10000; i++) {
+        size_t pos = IIO_FRAME_HEADER_LEN +
+            test_random() % ((size_t) wire_len - IIO_FRAME_HEADER_LEN);
+        uint8_t saved = frame[pos];
+
+        frame[pos] = (uint8_t) test_random();
+        memset(dst, TEST_GUARD, sizeof(dst));
+        ret = iio_frame_decode(frame, (size_t) wire_len, dst, len, NULL);
+        frame[pos] = saved;
+        if (ret > (ssize_t) len || dst[len] != TEST_GUARD) {
+            fprintf(stderr, "Corrupted frame overflowed\n");
+            return -EIO;
+        }
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    if (test_round_trips() || test_malformed())
+        return EXIT_FAILURE;
+
+    printf("PASS\n");
+    return EXIT_SUCCESS;
+}
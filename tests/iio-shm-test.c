@@ -0,0 +1,222 @@
+/*
+ * iio-shm-test - Two-process test of the shm: backend
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+/*
+ * Runs iio-shm-producer in a child process, and reads its samples back
+ * through the shm: backend. Every sample must be intact and in order; the
+ * samples missing must all have been counted as overruns by the producer.
+ *
+ * Usage: iio-shm-test [path to iio-shm-producer]
+ */
+
+#include "iio.h"
+#include "shm-ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SHM_PRODUCER_PATTERN 0x5a5a5a5a
+
+#define TEST_RING_SAMPLES "1024"
+#define TEST_PERIOD_US "20"
+#define TEST_COUNT 50000
+#define TEST_BUFFER_SAMPLES 256
+#define TEST_START_TIMEOUT_MS 2000
+
+static struct iio_context * wait_for_region(const char *uri)
+{
+    struct timespec ts = { 0, 10 * 1000000L };
+    struct iio_context *ctx;
+    unsigned int i;
+
+    /* The region is only usable once the producer wrote its magic */
+    for (i = 0; i < TEST_START_TIMEOUT_MS / 10; i++) {
+        ctx = iio_create_context_from_uri(uri);
+        if (ctx)
+            return ctx;
+        nanosleep(&ts, NULL);
+    }
+
+    return NULL;
+}
+
+static uint64_t read_overruns(const char *path)
+{
+    struct shm_ring_header hdr;
+    struct shm_ring ring;
+    uint64_t overruns = 0;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+
+    if (pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) &&
+            pread(fd, &ring, sizeof(ring), (off_t) hdr.rings_offset) ==
+            sizeof(ring))
+        overruns = ring.overruns;
+
+    close(fd);
+    return overruns;
+}
+
+static int consume(struct iio_context *ctx, unsigned long long *received,
+        unsigned long long *missing)
+{
+    struct iio_device *dev = iio_context_find_device(ctx, "accel_3d");
+    const struct iio_channel *chx, *chy, *chz;
+    long long expected = -1;
+    struct iio_buffer *buf;
+    unsigned int i;
+    int ret = 0;
+
+    if (!dev)
+        return -ENODEV;
+
+    for (i = 0; i < iio_device_get_channels_count(dev); i++)
+        iio_channel_enable(iio_device_get_channel(dev, i));
+
+    chx = iio_device_find_channel(dev, "accel_x", false);
+    chy = iio_device_find_channel(dev, "accel_y", false);
+    chz = iio_device_find_channel(dev, "accel_z", false);
+    if (!chx || !chy || !chz)
+        return -ENODEV;
+
+    buf = iio_device_create_buffer(dev, TEST_BUFFER_SAMPLES, false);
+    if (!buf)
+        return -errno;
+
+    while (expected < TEST_COUNT) {
+        ptrdiff_t step = iio_buffer_step(buf);
+        const char *x, *y, *z, *end;
+        ssize_t nbytes = iio_buffer_refill(buf);
+
+        if (nbytes < 0) {
+            ret = (int) nbytes;
+            break;
+        }
+
+        x = iio_buffer_first(buf, chx);
+        y = iio_buffer_first(buf, chy);
+        z = iio_buffer_first(buf, chz);
+        end = iio_buffer_end(buf);
+
+        for (; x < end; x += step, y += step, z += step) {
+            int32_t vx = *(const int32_t *) x;
+
+            if (*(const int32_t *) y != -vx ||
+                    *(const int32_t *) z != (vx ^ SHM_PRODUCER_PATTERN)) {
+                fprintf(stderr, "Torn sample %d\n", vx);
+                ret = -EIO;
+                goto out_destroy_buffer;
+            }
+
+            if (expected >= 0 && vx < expected) {
+                fprintf(stderr, "Sample %d after %lld\n", vx, expected - 1);
+                ret = -EIO;
+                goto out_destroy_buffer;
+            }
+
+            if (expected >= 0)
+                *missing += (unsigned long long) (vx - expected);
+            expected = (long long) vx + 1;
+            (*received)++;
+        }
+    }
+
+out_destroy_buffer:
+    iio_buffer_destroy(buf);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const char *producer = argc > 1 ? argv[1] : "iio-shm-producer";
+    char path[] = "/tmp/iio-shm-test.XXXXXX", uri[sizeof(path) + 4];
+    unsigned long long received = 0, missing = 0;
+    char count[32];
+    struct iio_context *ctx;
+    uint64_t overruns;
+    int fd, ret, status;
+    pid_t pid;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        perror("Unable to create the region");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+
+    snprintf(uri, sizeof(uri), "shm:%s", path);
+    snprintf(count, sizeof(count), "%d", TEST_COUNT + 1);
+
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        unlink(path);
+        return EXIT_FAILURE;
+    }
+
+    if (!pid) {
+        /* Leaves time to the consumer to open its buffer */
+        execlp(producer, producer, "-s", TEST_RING_SAMPLES, "-n", count,
+                "-p", TEST_PERIOD_US, "-d", "500", path, (char *) NULL);
+        perror(producer);
+        _exit(127);
+    }
+
+    ctx = wait_for_region(uri);
+    if (ctx) {
+        ret = consume(ctx, &received, &missing);
+        iio_context_destroy(ctx);
+    } else {
+        ret = -errno;
+    }
+
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status)) {
+        fprintf(stderr, "The producer failed\n");
+        ret = -ECHILD;
+    }
+
+    overruns = read_overruns(path);
+    unlink(path);
+
+    printf("%llu samples received, %llu missing, %llu overruns\n",
+            received, missing, (unsigned long long) overruns);
+
+    if (ret < 0) {
+        fprintf(stderr, "Unable to read the samples: %s\n", strerror(-ret));
+        return EXIT_FAILURE;
+    }
+
+    if (missing > overruns) {
+        fprintf(stderr, "Samples lost without an overrun\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("PASS\n");
+    return EXIT_SUCCESS;
+}
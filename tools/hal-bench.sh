@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Runs iio-hal-bench on synth:, then against iiod-standin over a unix socket
+# for each round-trip time and jitter given, e.g.:
+#
+#   tools/hal-bench.sh 0/0 200/50 1000/200 > results.jsonl
+#
+# The binaries are looked up in $PATH, as installed by the host build.
+
+set -e
+
+SOCKET=${TMPDIR:-/tmp}/iiod-standin.$$
+ITERATIONS=${ITERATIONS:-2000}
+
+[ $# -gt 0 ] || set -- 0/0
+
+iio-hal-bench -n "$ITERATIONS"
+
+for link in "$@"; do
+	rtt=${link%/*}
+	jitter=${link#*/}
+
+	iiod-standin -U "$SOCKET" -r "$rtt" -j "$jitter" 2>/dev/null &
+	pid=$!
+	trap 'kill $pid 2>/dev/null' EXIT
+
+	while [ ! -S "$SOCKET" ]; do
+		sleep 0.1
+	done
+
+	iio-hal-bench -n "$ITERATIONS" -u "unix:$SOCKET" | \
+		sed "s/^{/{\"rtt_us\":$rtt,\"jitter_us\":$jitter,/"
+
+	kill $pid
+	wait $pid 2>/dev/null || true
+done
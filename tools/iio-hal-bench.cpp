@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2020 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * End-to-end benchmark of the acquisition modes, against any context URI:
+ * typically "unix:path" or "ip:127.0.0.1" served by iiod-standin, whose
+ * round-trip time and jitter can be set, or "synth:" for the client side
+ * alone.
+ *
+ *   sync          iioClient::getPollData() with blocking reads
+ *   async         iioClient::getPollData() with pipelined reads
+ *   refill        iio_buffer_refill() on one device
+ *   refill-async  iio_buffer_refill_async() and iio_context_process_async()
+ *   push          iio_buffer_refill() after iio_buffer_subscribe()
+ *   coro          the reads of the async mode, each one awaited by its own
+ *                 iioCoro::Task, to compare the facade with getPollData()
+ *
+ * One JSON object is printed per mode and per line: events per second,
+ * latency percentiles of a poll or refill, and the system calls and CPU
+ * time per event. An event is a sensor event for the HAL modes, and a
+ * sample for the buffer ones. The system calls are those counted by
+ * iio_context_get_stats(), null when the backend has no server.
+ *
+ * Built as C++20 for the coro mode, which reports ENOSYS otherwise.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "iio-client.h"
+#include "iio-coro.h"
+
+#define DEFAULT_URI "synth:accel_3d@0,gyro_3d@0,magn_3d@0"
+#define DEFAULT_ITERATIONS 2000
+#define DEFAULT_SAMPLES 64
+#define PUSH_PERIOD_US 1000
+
+struct benchResult {
+    const char *mode;
+    int error;
+    uint64_t events;
+    double seconds;
+    double cpuSeconds;
+    bool hasSyscalls;
+    uint64_t syscalls;
+    std::vector<int64_t> latencies;
+};
+
+static int64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000000LL * ts.tv_sec + ts.tv_nsec;
+}
+
+static double cpuSeconds(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+        (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static uint64_t sumSyscalls(const struct iio_context_stats *st)
+{
+    uint64_t sum = st->async_syscalls;
+
+    for (unsigned int i = 0; i < IIO_NB_COMMANDS; i++)
+        sum += st->commands[i].syscalls;
+
+    return sum;
+}
+
+static double percentile(std::vector<int64_t> &v, double p)
+{
+    if (v.empty())
+        return 0.0;
+
+    size_t index = (size_t) (p * (v.size() - 1) + 0.5);
+    return v[index] / 1000.0;
+}
+
+static void printResult(const char *uri, struct benchResult *r)
+{
+    if (r->error) {
+        printf("{\"mode\":\"%s\",\"uri\":\"%s\",\"error\":\"%s\"}\n",
+                r->mode, uri, strerror(-r->error));
+        return;
+    }
+
+    std::sort(r->latencies.begin(), r->latencies.end());
+
+    double events = r->events ? (double) r->events : 1.0;
+
+    printf("{\"mode\":\"%s\",\"uri\":\"%s\",\"iterations\":%zu,"
+           "\"events\":%llu,\"events_per_s\":%.1f,"
+           "\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,",
+           r->mode, uri, r->latencies.size(),
+           (unsigned long long) r->events, r->events / r->seconds,
+           percentile(r->latencies, 0.50), percentile(r->latencies, 0.99),
+           percentile(r->latencies, 0.999));
+
+    if (r->hasSyscalls)
+        printf("\"syscalls_per_event\":%.3f,", r->syscalls / events);
+    else
+        printf("\"syscalls_per_event\":null,");
+
+    printf("\"cpu_us_per_event\":%.3f}\n", r->cpuSeconds * 1e6 / events);
+    fflush(stdout);
+}
+
+static void benchHal(const char *uri, bool async, unsigned int iterations,
+        struct benchResult *r)
+{
+    sensors_event_t data[MAX_SENSOR];
+    struct iio_context_stats before, after;
+    iioClient client(uri);
+
+    client.setAsyncPoll(async);
+
+    /* Connects if needed, and warms up */
+    if (client.getPollData(data) <= 0) {
+        r->error = -ENODEV;
+        return;
+    }
+
+    r->hasSyscalls = !client.getContextStats(&before);
+
+    double cpu = cpuSeconds();
+    int64_t start = nowNs();
+
+    for (unsigned int i = 0; i < iterations; i++) {
+        int64_t t = nowNs();
+        int ret = client.getPollData(data);
+
+        r->latencies.push_back(nowNs() - t);
+        if (ret > 0)
+            r->events += (uint64_t) ret;
+    }
+
+    r->seconds = (nowNs() - start) / 1e9;
+    r->cpuSeconds = cpuSeconds() - cpu;
+
+    if (r->hasSyscalls && !client.getContextStats(&after))
+        r->syscalls = sumSyscalls(&after) - sumSyscalls(&before);
+}
+
+static void refillDone(struct iio_buffer *, ssize_t ret, void *d)
+{
+    *(ssize_t *) d = ret;
+}
+
+static ssize_t refillOnce(struct iio_context *ctx, struct iio_buffer *buf,
+        bool async)
+{
+    ssize_t result = 0;
+    int ret;
+
+    if (!async)
+        return iio_buffer_refill(buf);
+
+    ret = iio_buffer_refill_async(buf, refillDone, &result);
+    if (ret < 0)
+        return ret;
+
+    while (!result) {
+        ret = iio_context_process_async(ctx, POLL_TIMEOUT_MS);
+        if (ret < 0)
+            return ret;
+    }
+
+    return result;
+}
+
+static void benchBuffer(const char *uri, const char *mode,
+        const char *name, unsigned int samples, unsigned int iterations,
+        struct benchResult *r)
+{
+    struct iio_context_stats before, after;
+    struct iio_device *dev = NULL;
+    struct iio_buffer *buf;
+    bool async = !strcmp(mode, "refill-async");
+    struct iio_context *ctx = iio_create_context_from_uri(uri);
+
+    if (!ctx) {
+        r->error = -errno;
+        return;
+    }
+
+    /* The named device, or the first one with samples */
+    for (unsigned int i = 0; !dev && i < iio_context_get_devices_count(ctx);
+            i++) {
+        struct iio_device *d = iio_context_get_device(ctx, i);
+        const char *dname = iio_device_get_name(d);
+
+        if (!name)
+            dev = iio_device_get_channels_count(d) ? d : NULL;
+        else if (!strcmp(iio_device_get_id(d), name) ||
+                (dname && !strcmp(dname, name)))
+            dev = d;
+    }
+
+    if (!dev) {
+        r->error = -ENODEV;
+        goto out_destroy_ctx;
+    }
+
+    for (unsigned int i = 0; i < iio_device_get_channels_count(dev); i++) {
+        struct iio_channel *chn = iio_device_get_channel(dev, i);
+
+        if (iio_channel_is_scan_element(chn))
+            iio_channel_enable(chn);
+    }
+
+    buf = iio_device_create_buffer(dev, samples, false);
+    if (!buf) {
+        r->error = -errno;
+        goto out_destroy_ctx;
+    }
+
+    if (!strcmp(mode, "push")) {
+        r->error = iio_buffer_subscribe(buf, PUSH_PERIOD_US);
+        if (r->error)
+            goto out_destroy_buffer;
+    }
+
+    /* Warms up */
+    r->error = (int) std::min<ssize_t>(refillOnce(ctx, buf, async), 0);
+    if (r->error)
+        goto out_destroy_buffer;
+
+    r->hasSyscalls = !iio_context_get_stats(ctx, &before);
+
+    {
+        size_t step = iio_device_get_sample_size(dev);
+        double cpu = cpuSeconds();
+        int64_t start = nowNs();
+
+        for (unsigned int i = 0; i < iterations; i++) {
+            int64_t t = nowNs();
+            ssize_t ret = refillOnce(ctx, buf, async);
+
+            r->latencies.push_back(nowNs() - t);
+            if (ret < 0) {
+                r->error = (int) ret;
+                break;
+            }
+            r->events += (uint64_t) ret / step;
+        }
+
+        r->seconds = (nowNs() - start) / 1e9;
+        r->cpuSeconds = cpuSeconds() - cpu;
+    }
+
+    if (r->hasSyscalls && !iio_context_get_stats(ctx, &after))
+        r->syscalls = sumSyscalls(&after) - sumSyscalls(&before);
+
+out_destroy_buffer:
+    iio_buffer_destroy(buf);
+out_destroy_ctx:
+    iio_context_destroy(ctx);
+}
+
+#ifdef IIO_CORO_AVAILABLE
+static iioCoro::Task<> coroRead(iioCoro::Executor &exec,
+        const struct iio_attr_handle *handle, int *error)
+{
+    char value[MAX_VALUE_LEN];
+    ssize_t ret = co_await exec.readAttr(handle, value, sizeof(value));
+
+    if (ret < 0) {
+        *error = (int) ret;
+        co_return (int) ret;
+    }
+
+    /* Parsed like in getPollData() */
+    strtof(value, NULL);
+    co_return 0;
+}
+
+/* One poll: all the reads in flight at once, like fetchAsync() */
+static int coroPoll(iioCoro::Executor &exec,
+        std::vector<struct iio_attr_handle *> &handles)
+{
+    int error = 0, ret;
+
+    for (struct iio_attr_handle *handle : handles)
+        exec.spawn(coroRead(exec, handle, &error));
+
+    ret = exec.run();
+    return ret < 0 ? ret : error;
+}
+
+static void benchCoro(const char *uri, unsigned int iterations,
+        struct benchResult *r)
+{
+    struct iio_context_stats before, after;
+    std::vector<struct iio_attr_handle *> handles;
+    unsigned int sensors = 0;
+    struct iio_context *ctx = iio_create_context_from_uri(uri);
+
+    if (!ctx) {
+        r->error = -errno;
+        return;
+    }
+
+    /* The "raw" attribute of every channel; a sensor is a device having
+     * at least one */
+    for (unsigned int i = 0; i < iio_context_get_devices_count(ctx); i++) {
+        struct iio_device *dev = iio_context_get_device(ctx, i);
+        size_t nb = handles.size();
+
+        for (unsigned int j = 0; j < iio_device_get_channels_count(dev);
+                j++) {
+            struct iio_channel *chn = iio_device_get_channel(dev, j);
+            struct iio_attr_handle *handle;
+
+            if (!iio_channel_find_attr(chn, "raw"))
+                continue;
+
+            handle = iio_channel_attr_prepare(chn, "raw");
+            if (handle)
+                handles.push_back(handle);
+        }
+
+        if (handles.size() > nb)
+            sensors++;
+    }
+
+    if (!sensors) {
+        r->error = -ENODEV;
+        goto out_destroy_ctx;
+    }
+
+    {
+        iioCoro::Executor exec(ctx);
+
+        /* Warms up */
+        r->error = coroPoll(exec, handles);
+        if (r->error)
+            goto out_destroy_handles;
+
+        r->hasSyscalls = !iio_context_get_stats(ctx, &before);
+
+        double cpu = cpuSeconds();
+        int64_t start = nowNs();
+
+        for (unsigned int i = 0; i < iterations; i++) {
+            int64_t t = nowNs();
+            int ret = coroPoll(exec, handles);
+
+            r->latencies.push_back(nowNs() - t);
+            if (ret < 0) {
+                r->error = ret;
+                break;
+            }
+            r->events += sensors;
+        }
+
+        r->seconds = (nowNs() - start) / 1e9;
+        r->cpuSeconds = cpuSeconds() - cpu;
+    }
+
+    if (r->hasSyscalls && !iio_context_get_stats(ctx, &after))
+        r->syscalls = sumSyscalls(&after) - sumSyscalls(&before);
+
+out_destroy_handles:
+    for (struct iio_attr_handle *handle : handles)
+        iio_attr_handle_destroy(handle);
+out_destroy_ctx:
+    iio_context_destroy(ctx);
+}
+#else
+static void benchCoro(const char *uri, unsigned int iterations,
+        struct benchResult *r)
+{
+    r->error = -ENOSYS;
+}
+#endif
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-u uri] [-m mode[,mode...]] [-n iterations] "
+            "[-d device] [-s samples]\n"
+            "Modes: sync, async, refill, refill-async, push, coro "
+            "(default: all)\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *uri = DEFAULT_URI, *device = NULL;
+    char modes[256] = "sync,async,refill,refill-async,push,coro";
+    unsigned int iterations = DEFAULT_ITERATIONS, samples = DEFAULT_SAMPLES;
+    char *mode, *saveptr;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "u:m:n:d:s:h")) != -1) {
+        switch (opt) {
+        case 'u':
+            uri = optarg;
+            break;
+        case 'm':
+            snprintf(modes, sizeof(modes), "%s", optarg);
+            break;
+        case 'n':
+            iterations = (unsigned int) strtoul(optarg, NULL, 10);
+            break;
+        case 'd':
+            device = optarg;
+            break;
+        case 's':
+            samples = (unsigned int) strtoul(optarg, NULL, 10);
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    for (mode = strtok_r(modes, ",", &saveptr); mode;
+            mode = strtok_r(NULL, ",", &saveptr)) {
+        struct benchResult r = {};
+
+        r.mode = mode;
+        if (!strcmp(mode, "sync") || !strcmp(mode, "async"))
+            benchHal(uri, !strcmp(mode, "async"), iterations, &r);
+        else if (!strcmp(mode, "refill") || !strcmp(mode, "refill-async") ||
+                !strcmp(mode, "push"))
+            benchBuffer(uri, mode, device, samples, iterations, &r);
+        else if (!strcmp(mode, "coro"))
+            benchCoro(uri, iterations, &r);
+        else
+            r.error = -EINVAL;
+
+        printResult(uri, &r);
+    }
+
+    return EXIT_SUCCESS;
+}
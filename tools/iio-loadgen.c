@@ -0,0 +1,450 @@
+/*
+ * iio-loadgen - Load generator of many network clients against one server
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+/*
+ * Simulates N guests sharing one iiod, for each N given: every client is a
+ * thread creating its own context from the URI, as a guest does at boot,
+ * then polling the "raw" attribute of every channel of the first device
+ * that has some, as fast as it can. The clients all connect at once, and
+ * all start polling once the last one is connected.
+ *
+ * For example, against an iiod listening on a UNIX socket:
+ *
+ *   iio-loadgen -u unix:/tmp/iiod.sock -n 1,2,4,8,16,32
+ *
+ * or over TCP, on a port other than the one of iiod:
+ *
+ *   iio-loadgen -u ip:127.0.0.1:30500 -n 1,2,4,8,16,32
+ *
+ * Prints one JSON object per line: one per client with its setup time and
+ * the percentiles of its poll latency, then one per N with the aggregate
+ * throughput, the setup times, the worst tail latencies of the clients and
+ * their CPU time per poll. With -a, the reads of a poll are pipelined like
+ * in the asynchronous mode of the HAL.
+ *
+ * With -p, the lines also break the setup times down into the phases of
+ * iio_context_get_profile(): per client, then averaged over the clients
+ * that got a context. With -t 0, the clients only create their context:
+ *
+ *   iio-loadgen -u unix:/tmp/iiod.sock -n 32 -t 0 -p
+ */
+
+#include "iio.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_URI "ip:127.0.0.1"
+#define DEFAULT_CLIENTS "1,2,4,8,16"
+#define DEFAULT_DURATION_S 2
+#define MAX_CLIENTS 256
+#define MAX_CHANNELS 16
+#define MAX_VALUE_LEN 64
+#define POLL_TIMEOUT_MS 5000
+
+struct loadgen_config {
+    const char *uri;
+    unsigned int duration_s;
+    bool async;
+    bool summary_only;
+    bool profile;
+};
+
+struct loadgen_client {
+    const struct loadgen_config *cfg;
+    pthread_barrier_t *barrier;
+    pthread_t thread;
+
+    uint64_t setup_ns, cpu_ns;
+    struct iio_context_profile profile;
+    uint64_t *latencies;
+    size_t nb_polls, size;
+    unsigned int nb_reads, errors;
+    int error;
+};
+
+static const char * const phase_names[IIO_CONTEXT_NB_PHASES] = {
+    "resolve", "connect", "handshake", "fetch", "parse", "init", "setup",
+};
+
+struct loadgen_read {
+    char value[MAX_VALUE_LEN];
+    unsigned int *pending;
+    ssize_t ret;
+};
+
+static uint64_t now_ns(clockid_t clock)
+{
+    struct timespec ts = {0, 0};
+
+    clock_gettime(clock, &ts);
+    return 1000000000ULL * ts.tv_sec + ts.tv_nsec;
+}
+
+/* Prints the phases, each divided by 'nb', as a field of a JSON object */
+static void print_phases(const char *field, const uint64_t *phase_ns,
+        unsigned int nb)
+{
+    unsigned int i;
+
+    printf(",\"%s\":{", field);
+    for (i = 0; i < IIO_CONTEXT_NB_PHASES; i++)
+        printf("%s\"%s\":%.3f", i ? "," : "", phase_names[i],
+                nb ? phase_ns[i] / 1e6 / nb : 0.0);
+    printf("}");
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+static double percentile_us(const uint64_t *v, size_t nb, double p)
+{
+    if (!nb)
+        return 0.0;
+
+    return v[(size_t) (p * (nb - 1) + 0.5)] / 1000.0;
+}
+
+static unsigned int prepare_reads(struct iio_context *ctx,
+        struct iio_attr_handle **handles)
+{
+    unsigned int i, j, nb = 0;
+
+    for (i = 0; !nb && i < iio_context_get_devices_count(ctx); i++) {
+        const struct iio_device *dev = iio_context_get_device(ctx, i);
+
+        for (j = 0; nb < MAX_CHANNELS &&
+                j < iio_device_get_channels_count(dev); j++) {
+            const struct iio_channel *chn = iio_device_get_channel(dev, j);
+
+            if (!iio_channel_find_attr(chn, "raw"))
+                continue;
+
+            handles[nb] = iio_channel_attr_prepare(chn, "raw");
+            if (handles[nb])
+                nb++;
+        }
+    }
+
+    return nb;
+}
+
+static void read_done(ssize_t ret, void *d)
+{
+    struct loadgen_read *rd = d;
+
+    rd->ret = ret;
+    (*rd->pending)--;
+}
+
+/* Sends all the reads, then waits for all the replies */
+static int poll_async(struct iio_context *ctx,
+        struct iio_attr_handle **handles, unsigned int nb,
+        struct loadgen_read *reads, unsigned int *errors)
+{
+    unsigned int i, pending = 0;
+    int ret;
+
+    for (i = 0; i < nb; i++) {
+        reads[i].pending = &pending;
+        ret = iio_attr_handle_read_async(handles[i], reads[i].value,
+                sizeof(reads[i].value), read_done, &reads[i]);
+        if (ret < 0)
+            return ret;
+        pending++;
+    }
+
+    while (pending) {
+        ret = iio_context_process_async(ctx, POLL_TIMEOUT_MS);
+        if (ret < 0)
+            return ret;
+    }
+
+    for (i = 0; i < nb; i++)
+        if (reads[i].ret < 0)
+            (*errors)++;
+
+    return 0;
+}
+
+static int add_latency(struct loadgen_client *c, uint64_t ns)
+{
+    if (c->nb_polls == c->size) {
+        size_t size = c->size ? c->size * 2 : 4096;
+        uint64_t *latencies = realloc(c->latencies,
+                size * sizeof(*latencies));
+
+        if (!latencies)
+            return -ENOMEM;
+
+        c->latencies = latencies;
+        c->size = size;
+    }
+
+    c->latencies[c->nb_polls++] = ns;
+    return 0;
+}
+
+static void * client_thread(void *d)
+{
+    struct loadgen_client *c = d;
+    struct iio_attr_handle *handles[MAX_CHANNELS];
+    struct loadgen_read reads[MAX_CHANNELS];
+    struct iio_context *ctx;
+    uint64_t start, end, cpu;
+    unsigned int i;
+
+    start = now_ns(CLOCK_MONOTONIC);
+    ctx = iio_create_context_from_uri(c->cfg->uri);
+    c->setup_ns = now_ns(CLOCK_MONOTONIC) - start;
+
+    if (ctx)
+        iio_context_get_profile(ctx, &c->profile);
+
+    if (!ctx)
+        c->error = -errno;
+    else if (!(c->nb_reads = prepare_reads(ctx, handles)))
+        c->error = -ENODEV;
+
+    /* The clients that failed still have to meet the others */
+    pthread_barrier_wait(c->barrier);
+    if (c->error)
+        goto out_destroy_ctx;
+
+    cpu = now_ns(CLOCK_THREAD_CPUTIME_ID);
+    end = now_ns(CLOCK_MONOTONIC) + c->cfg->duration_s * 1000000000ULL;
+
+    for (;;) {
+        uint64_t t = now_ns(CLOCK_MONOTONIC);
+        int ret = 0;
+
+        if (t >= end)
+            break;
+
+        if (c->cfg->async) {
+            ret = poll_async(ctx, handles, c->nb_reads, reads, &c->errors);
+        } else {
+            for (i = 0; i < c->nb_reads; i++)
+                if (iio_attr_handle_read(handles[i], reads[i].value,
+                            sizeof(reads[i].value)) < 0)
+                    c->errors++;
+        }
+
+        if (!ret)
+            ret = add_latency(c, now_ns(CLOCK_MONOTONIC) - t);
+        if (ret < 0) {
+            c->error = ret;
+            break;
+        }
+    }
+
+    c->cpu_ns = now_ns(CLOCK_THREAD_CPUTIME_ID) - cpu;
+
+    for (i = 0; i < c->nb_reads; i++)
+        iio_attr_handle_destroy(handles[i]);
+out_destroy_ctx:
+    if (ctx)
+        iio_context_destroy(ctx);
+    return NULL;
+}
+
+static int run_step(const struct loadgen_config *cfg, unsigned int nb_clients)
+{
+    struct loadgen_client *clients;
+    pthread_barrier_t barrier;
+    uint64_t polls = 0, reads = 0, cpu_ns = 0, setup_sum = 0, setup_max = 0;
+    uint64_t phases_sum[IIO_CONTEXT_NB_PHASES] = { 0 };
+    double p50_max = 0.0, p99_max = 0.0, p999_max = 0.0;
+    unsigned int i, j, started, failed = 0, errors = 0, profiled = 0;
+    int ret = 0;
+
+    clients = calloc(nb_clients, sizeof(*clients));
+    if (!clients)
+        return -ENOMEM;
+
+    ret = pthread_barrier_init(&barrier, NULL, nb_clients);
+    if (ret) {
+        free(clients);
+        return -ret;
+    }
+
+    for (started = 0; started < nb_clients; started++) {
+        clients[started].cfg = cfg;
+        clients[started].barrier = &barrier;
+
+        ret = pthread_create(&clients[started].thread, NULL,
+                client_thread, &clients[started]);
+        if (ret) {
+            /* The threads started would wait forever at the barrier */
+            fprintf(stderr, "Unable to start client %u: %s\n",
+                    started, strerror(ret));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (i = 0; i < nb_clients; i++) {
+        struct loadgen_client *c = &clients[i];
+        double p50, p99, p999;
+
+        pthread_join(c->thread, NULL);
+
+        qsort(c->latencies, c->nb_polls, sizeof(*c->latencies), compare_u64);
+        p50 = percentile_us(c->latencies, c->nb_polls, 0.50);
+        p99 = percentile_us(c->latencies, c->nb_polls, 0.99);
+        p999 = percentile_us(c->latencies, c->nb_polls, 0.999);
+
+        if (!cfg->summary_only) {
+            printf("{\"clients\":%u,\"client\":%u,\"setup_ms\":%.3f,"
+                    "\"polls\":%zu,\"p50_us\":%.1f,\"p99_us\":%.1f,"
+                    "\"p999_us\":%.1f,\"errors\":%u%s%s%s",
+                    nb_clients, i, c->setup_ns / 1e6, c->nb_polls,
+                    p50, p99, p999, c->errors,
+                    c->error ? ",\"error\":\"" : "",
+                    c->error ? strerror(-c->error) : "",
+                    c->error ? "\"" : "");
+            if (cfg->profile)
+                print_phases("phases_ms", c->profile.phase_ns, 1);
+            printf("}\n");
+        }
+
+        /* The clients without a context have no profile */
+        if (c->profile.total_ns) {
+            for (j = 0; j < IIO_CONTEXT_NB_PHASES; j++)
+                phases_sum[j] += c->profile.phase_ns[j];
+            profiled++;
+        }
+
+        if (c->error)
+            failed++;
+
+        polls += c->nb_polls;
+        reads += (uint64_t) c->nb_polls * c->nb_reads;
+        cpu_ns += c->cpu_ns;
+        setup_sum += c->setup_ns;
+        if (c->setup_ns > setup_max)
+            setup_max = c->setup_ns;
+        if (p50 > p50_max)
+            p50_max = p50;
+        if (p99 > p99_max)
+            p99_max = p99;
+        if (p999 > p999_max)
+            p999_max = p999;
+        errors += c->errors;
+
+        free(c->latencies);
+    }
+
+    printf("{\"clients\":%u,\"uri\":\"%s\",\"async\":%s,"
+            "\"polls_per_s\":%.1f,\"reads_per_s\":%.1f,"
+            "\"setup_ms_avg\":%.3f,\"setup_ms_max\":%.3f,"
+            "\"p50_us_max\":%.1f,\"p99_us_max\":%.1f,\"p999_us_max\":%.1f,"
+            "\"cpu_us_per_poll\":%.3f,\"errors\":%u,\"failed_clients\":%u",
+            nb_clients, cfg->uri, cfg->async ? "true" : "false",
+            cfg->duration_s ? (double) polls / cfg->duration_s : 0.0,
+            cfg->duration_s ? (double) reads / cfg->duration_s : 0.0,
+            setup_sum / 1e6 / nb_clients, setup_max / 1e6,
+            p50_max, p99_max, p999_max,
+            polls ? cpu_ns / 1e3 / polls : 0.0, errors, failed);
+    if (cfg->profile)
+        print_phases("phases_ms_avg", phases_sum, profiled);
+    printf("}\n");
+    fflush(stdout);
+
+    pthread_barrier_destroy(&barrier);
+    free(clients);
+    return failed ? -EIO : 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-u uri] [-n clients[,clients...]] "
+            "[-t seconds] [-a] [-p] [-s]\n"
+            "\t-u  server to load (default: " DEFAULT_URI ")\n"
+            "\t-n  numbers of clients to run (default: "
+            DEFAULT_CLIENTS ")\n"
+            "\t-t  polling time of each step, 0 to only set up "
+            "(default: %u s)\n"
+            "\t-a  pipeline the reads of a poll\n"
+            "\t-p  break the setup times down into phases\n"
+            "\t-s  only print the summary of each step\n",
+            name, DEFAULT_DURATION_S);
+}
+
+int main(int argc, char **argv)
+{
+    struct loadgen_config cfg = {
+        .uri = DEFAULT_URI,
+        .duration_s = DEFAULT_DURATION_S,
+    };
+    char list[256] = DEFAULT_CLIENTS;
+    char *tok, *saveptr;
+    int opt, status = EXIT_SUCCESS;
+
+    while ((opt = getopt(argc, argv, "u:n:t:apsh")) != -1) {
+        switch (opt) {
+        case 'u':
+            cfg.uri = optarg;
+            break;
+        case 'n':
+            snprintf(list, sizeof(list), "%s", optarg);
+            break;
+        case 't':
+            cfg.duration_s = (unsigned int) strtoul(optarg, NULL, 10);
+            break;
+        case 'a':
+            cfg.async = true;
+            break;
+        case 'p':
+            cfg.profile = true;
+            break;
+        case 's':
+            cfg.summary_only = true;
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    for (tok = strtok_r(list, ",", &saveptr); tok;
+            tok = strtok_r(NULL, ",", &saveptr)) {
+        unsigned long n = strtoul(tok, NULL, 10);
+        int ret;
+
+        if (!n || n > MAX_CLIENTS) {
+            fprintf(stderr, "Invalid number of clients: %s\n", tok);
+            return EXIT_FAILURE;
+        }
+
+        ret = run_step(&cfg, (unsigned int) n);
+        if (ret < 0)
+            status = EXIT_FAILURE;
+    }
+
+    return status;
+}
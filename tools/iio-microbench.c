@@ -0,0 +1,993 @@
+/*
+ * iio-microbench - Microbenchmarks of the hot paths of the IIO client
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+/*
+ * Times, in process and without any I/O:
+ *
+ * - iio_channel_convert() and iio_channel_convert_inverse(), per sample,
+ *   iio_channel_read() and iio_channel_read_raw(), per sample,
+ *   iio_buffer_foreach_sample(), per sample and channel,
+ *   iio_buffer_first() and iio_device_get_sample_size_mask(), per call,
+ *   for each scan element format;
+ * - xml_create_context_mem() on a small and a large context;
+ * - the lookups of devices, channels and attributes by name, on the large
+ *   context, and the linear scans they replace;
+ * - the parsing of the replies of iiod to an attribute read and to
+ *   READBUF, in the text and in the binary framing, per read and per
+ *   sample.
+ *
+ * The contexts are generated XML. The buffers are filled by a stub backend
+ * replacing the XML one, which serves a fixed pattern. The replies of iiod
+ * are canned, and served to the iiod client from memory.
+ *
+ * One JSON object is printed per case and per line, with the median time
+ * per operation over BENCH_RUNS runs, and for the replies of iiod the bytes
+ * received per operation. Given the results of a previous run
+ * with -b, the cases slower than that by more than the ratio set with -r
+ * are reported on stderr, and the exit status is then non-zero:
+ *
+ *   iio-microbench > baseline.jsonl
+ *   ...
+ *   iio-microbench -b baseline.jsonl -r 1.2
+ */
+
+#include "iio-private.h"
+#include "iio-lock.h"
+#include "iiod-client.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_RUNS 7
+#define BENCH_SAMPLES 256
+#define DEFAULT_TIME_MS 100
+#define DEFAULT_RATIO 1.25
+
+#define MAX_NAME 128
+#define MAX_BASELINE 1024
+
+#define WIRE_SAMPLES 64
+#define WIRE_VALUE "12.345"
+
+#define LARGE_DEVICES 64
+#define LARGE_CHANNELS 16
+#define LARGE_LAST_DEVICE "iio:device63"
+#define LARGE_LAST_CHANNEL "anglvel15"
+
+static const char * const formats[] = {
+    "le:s8/8>>0",   "le:u8/8>>0",
+    "le:s12/16>>4", "be:s12/16>>4",
+    "le:s16/16>>0", "be:s16/16>>0", "le:u16/16>>0", "be:u16/16>>0",
+    "le:s24/32>>8", "be:s24/32>>8",
+    "le:s32/32>>0", "be:s32/32>>0",
+    "le:s64/64>>0", "be:s64/64>>0",
+};
+
+/* Canned reply of iiod, served again for each request */
+struct bench_wire {
+    char *reply;
+    size_t len, pos;
+    bool binary;
+};
+
+struct baseline_entry {
+    char name[MAX_NAME];
+    double ns_per_op;
+};
+
+struct bench_state {
+    unsigned int time_ms;
+    const char *filter;
+    double ratio;
+    struct baseline_entry *baseline;
+    unsigned int nb_baseline;
+    unsigned int regressions;
+};
+
+/* Everything a case needs, on the buffer of one format or on a context */
+struct bench_data {
+    struct iio_context *ctx;
+    struct iio_device *dev;
+    struct iio_channel *chn;
+    struct iio_buffer *buf;
+    uint32_t mask[4];
+    size_t words;
+    const char *xml;
+    size_t xml_len;
+    uint64_t samples[BENCH_SAMPLES * 2];
+    uint64_t converted[BENCH_SAMPLES * 2];
+
+    /* Replies of iiod: the client parsing them, and their size */
+    struct iiod_client *client;
+    struct bench_wire wire;
+    size_t wire_len;
+    double bytes_per_op;
+};
+
+struct bench_xml {
+    char *buf;
+    size_t len, size;
+};
+
+/* Keeps the compiler from dropping the results */
+static volatile uint64_t sink;
+
+static struct iio_backend_ops bench_ops;
+
+typedef void (*bench_fn)(struct bench_data *d, unsigned long n);
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts = {0, 0};
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000000ULL * ts.tv_sec + ts.tv_nsec;
+}
+
+static int bench_open(__notused const struct iio_device *dev,
+        __notused size_t samples_count, __notused bool cyclic)
+{
+    return 0;
+}
+
+static int bench_close(__notused const struct iio_device *dev)
+{
+    return 0;
+}
+
+static ssize_t bench_read_samples(__notused const struct iio_device *dev,
+        void *dst, size_t len, __notused uint32_t *mask,
+        __notused size_t words)
+{
+    uint8_t *ptr = dst;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        ptr[i] = (uint8_t) (i * 131 + 7);
+
+    return (ssize_t) len;
+}
+
+static ssize_t wire_write(__notused struct iio_context_pdata *pdata,
+        __notused void *desc, __notused const char *src, size_t len)
+{
+    return (ssize_t) len;
+}
+
+static ssize_t wire_read(__notused struct iio_context_pdata *pdata,
+        void *desc, char *dst, size_t len)
+{
+    struct bench_wire *wire = desc;
+    size_t n = wire->len - wire->pos;
+
+    if (n > len)
+        n = len;
+
+    memcpy(dst, wire->reply + wire->pos, n);
+    wire->pos += n;
+    if (wire->pos == wire->len)
+        wire->pos = 0;
+
+    return (ssize_t) n;
+}
+
+static ssize_t wire_read_line(__notused struct iio_context_pdata *pdata,
+        void *desc, char *dst, size_t len)
+{
+    struct bench_wire *wire = desc;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        dst[i] = wire->reply[wire->pos++];
+        if (wire->pos == wire->len)
+            wire->pos = 0;
+        if (dst[i] == '\n')
+            return (ssize_t) i + 1;
+    }
+
+    return -EIO;
+}
+
+static bool wire_is_binary(__notused struct iio_context_pdata *pdata,
+        void *desc)
+{
+    return ((struct bench_wire *) desc)->binary;
+}
+
+static const struct iiod_client_ops wire_ops = {
+    .write = wire_write,
+    .read = wire_read,
+    .read_line = wire_read_line,
+    .is_binary = wire_is_binary,
+};
+
+/* Appends a length or a mask word, as a decimal line or a 32-bit word */
+static size_t wire_put_int(char *dst, bool binary, uint32_t value,
+        bool hex)
+{
+    if (binary) {
+        dst[0] = (char) value;
+        dst[1] = (char) (value >> 8);
+        dst[2] = (char) (value >> 16);
+        dst[3] = (char) (value >> 24);
+        return 4;
+    }
+
+    return (size_t) sprintf(dst, hex ? "%08" PRIx32 "\n" : "%" PRIu32 "\n",
+            value);
+}
+
+/* The reply to the read of an attribute worth WIRE_VALUE */
+static int wire_attr_reply(struct bench_wire *wire, bool binary)
+{
+    size_t len = sizeof(WIRE_VALUE);
+
+    wire->reply = malloc(len + 16);
+    if (!wire->reply)
+        return -ENOMEM;
+
+    wire->binary = binary;
+    wire->pos = 0;
+    wire->len = wire_put_int(wire->reply, binary, (uint32_t) len, false);
+    memcpy(wire->reply + wire->len, WIRE_VALUE, len);
+    wire->len += len;
+    if (!binary)
+        wire->reply[wire->len++] = '\n';
+
+    return 0;
+}
+
+/* The reply to READBUF: length, mask and 'len' bytes of samples */
+static int wire_readbuf_reply(struct bench_wire *wire, bool binary,
+        uint32_t mask, size_t len)
+{
+    wire->reply = malloc(len + 32);
+    if (!wire->reply)
+        return -ENOMEM;
+
+    wire->binary = binary;
+    wire->pos = 0;
+    wire->len = wire_put_int(wire->reply, binary, (uint32_t) len, false);
+    wire->len += wire_put_int(wire->reply + wire->len, binary, mask, true);
+    memset(wire->reply + wire->len, 0x5a, len);
+    wire->len += len;
+
+    return 0;
+}
+
+static int xml_append(struct bench_xml *xml, const char *fmt, ...)
+{
+    va_list ap;
+    int ret;
+
+    for (;;) {
+        va_start(ap, fmt);
+        ret = vsnprintf(xml->buf + xml->len, xml->size - xml->len, fmt, ap);
+        va_end(ap);
+
+        if (ret < 0)
+            return -EINVAL;
+
+        if ((size_t) ret < xml->size - xml->len) {
+            xml->len += (size_t) ret;
+            return 0;
+        } else {
+            size_t size = xml->size * 2 + (size_t) ret + 1;
+            char *buf = realloc(xml->buf, size);
+
+            if (!buf)
+                return -ENOMEM;
+
+            xml->buf = buf;
+            xml->size = size;
+        }
+    }
+}
+
+/* A device of 'nb' channels in the given format, and a timestamp */
+static int xml_append_device(struct bench_xml *xml, unsigned int id,
+        const char *name, const char *type, unsigned int nb,
+        const char *format)
+{
+    char fmt[32], *gt;
+    unsigned int i;
+    int ret;
+
+    /* ">>" becomes "&gt;&gt;" */
+    gt = strchr(format, '>');
+    iio_snprintf(fmt, sizeof(fmt), "%.*s&gt;&gt;%s",
+            (int) (gt - format), format, gt + 2);
+
+    ret = xml_append(xml, "<device id=\"iio:device%u\" name=\"%s\" >",
+            id, name);
+
+    for (i = 0; !ret && i < nb; i++)
+        ret = xml_append(xml, "<channel id=\"%s%u\" type=\"input\" >"
+                "<scan-element index=\"%u\" format=\"%s\" />"
+                "<attribute name=\"raw\" />"
+                "<attribute name=\"scale\" />"
+                "<attribute name=\"input\" />"
+                "</channel>", type, i, i, fmt);
+
+    if (!ret)
+        ret = xml_append(xml, "<channel id=\"timestamp\" type=\"input\" >"
+                "<scan-element index=\"%u\" format=\"le:s64/64&gt;&gt;0\" />"
+                "</channel>"
+                "<attribute name=\"sampling_frequency\" />"
+                "</device>", nb);
+    return ret;
+}
+
+static int xml_generate(struct bench_xml *xml, unsigned int nb_devices,
+        unsigned int nb_channels, const char *format)
+{
+    unsigned int i;
+    int ret;
+
+    xml->len = 0;
+    ret = xml_append(xml, "%s<context name=\"bench\" >", iio_xml_header);
+
+    for (i = 0; !ret && i < nb_devices; i++)
+        ret = xml_append_device(xml, i, "gyro_3d", "anglvel",
+                nb_channels, format);
+
+    if (!ret)
+        ret = xml_append(xml, "</context>");
+    return ret;
+}
+
+static void bench_convert(struct bench_data *d, unsigned long n)
+{
+    ptrdiff_t step = iio_buffer_step(d->buf);
+    const char *end = iio_buffer_end(d->buf);
+    uint64_t acc = 0;
+
+    while (n--) {
+        const char *src = iio_buffer_first(d->buf, d->chn);
+
+        for (; src < end; src += step) {
+            uint64_t value = 0;
+
+            iio_channel_convert(d->chn, &value, src);
+            acc += value;
+        }
+    }
+
+    sink = acc;
+}
+
+static void bench_convert_inverse(struct bench_data *d, unsigned long n)
+{
+    size_t len = iio_channel_get_data_format(d->chn)->length / 8;
+    char *dst = (char *) d->samples;
+    unsigned int i;
+
+    while (n--) {
+        const char *src = (const char *) d->converted;
+
+        for (i = 0; i < BENCH_SAMPLES; i++, src += len)
+            iio_channel_convert_inverse(d->chn, dst + i * len, src);
+    }
+
+    sink = d->samples[0];
+}
+
+static void bench_read(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = iio_channel_read(d->chn, d->buf,
+                d->samples, sizeof(d->samples));
+}
+
+static void bench_read_raw(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = iio_channel_read_raw(d->chn, d->buf,
+                d->samples, sizeof(d->samples));
+}
+
+static ssize_t count_sample(__notused const struct iio_channel *chn,
+        void *src, size_t bytes, void *d)
+{
+    *(uint64_t *) d += *(const uint8_t *) src;
+    return (ssize_t) bytes;
+}
+
+static void bench_foreach_sample(struct bench_data *d, unsigned long n)
+{
+    uint64_t acc = 0;
+
+    while (n--)
+        iio_buffer_foreach_sample(d->buf, count_sample, &acc);
+
+    sink = acc;
+}
+
+static void bench_first(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = (uintptr_t) iio_buffer_first(d->buf, d->chn);
+}
+
+static void bench_sample_size_mask(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = (uint64_t) iio_device_get_sample_size_mask(d->dev,
+                d->mask, d->words);
+}
+
+static void bench_xml(struct bench_data *d, unsigned long n)
+{
+    while (n--) {
+        struct iio_context *ctx = xml_create_context_mem(d->xml, d->xml_len);
+
+        sink = (uintptr_t) ctx;
+        if (ctx)
+            iio_context_destroy(ctx);
+    }
+}
+
+/* The lookups as they were before the indexes, for comparison */
+static const struct iio_device * linear_find_device(
+        const struct iio_context *ctx, const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < ctx->nb_devices; i++) {
+        const struct iio_device *dev = ctx->devices[i];
+
+        if (!strcmp(dev->id, name) || (dev->name && !strcmp(dev->name, name)))
+            return dev;
+    }
+
+    return NULL;
+}
+
+static const struct iio_channel * linear_find_channel(
+        const struct iio_device *dev, const char *name, bool output)
+{
+    unsigned int i;
+
+    for (i = 0; i < dev->nb_channels; i++) {
+        const struct iio_channel *chn = dev->channels[i];
+
+        if (chn->is_output == output && (!strcmp(chn->id, name) ||
+                    (chn->name && !strcmp(chn->name, name))))
+            return chn;
+    }
+
+    return NULL;
+}
+
+static void bench_find_device_by_id(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = (uintptr_t) iio_context_find_device(d->ctx, LARGE_LAST_DEVICE);
+}
+
+static void bench_find_device_by_name(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = (uintptr_t) iio_context_find_device(d->ctx, "gyro_3d");
+}
+
+static void bench_find_device_missing(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = (uintptr_t) iio_context_find_device(d->ctx, "missing");
+}
+
+static void bench_find_channel(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = (uintptr_t) iio_device_find_channel(d->dev,
+                LARGE_LAST_CHANNEL, false);
+}
+
+static void bench_linear_device_by_id(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = (uintptr_t) linear_find_device(d->ctx, LARGE_LAST_DEVICE);
+}
+
+static void bench_linear_device_by_name(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = (uintptr_t) linear_find_device(d->ctx, "gyro_3d");
+}
+
+static void bench_linear_device_missing(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = (uintptr_t) linear_find_device(d->ctx, "missing");
+}
+
+static void bench_linear_channel(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = (uintptr_t) linear_find_channel(d->dev,
+                LARGE_LAST_CHANNEL, false);
+}
+
+static void bench_find_channel_attr(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = (uintptr_t) iio_channel_find_attr(d->chn, "input");
+}
+
+static void bench_find_device_attr(struct bench_data *d, unsigned long n)
+{
+    while (n--)
+        sink = (uintptr_t) iio_device_find_attr(d->dev, "sampling_frequency");
+}
+
+static void bench_wire_read_attr(struct bench_data *d, unsigned long n)
+{
+    static const char cmd[] = "READ iio:device0 INPUT anglvel0 raw\r\n";
+    char value[64];
+
+    while (n--)
+        sink = (uint64_t) iiod_client_read_attr_cmd(d->client, &d->wire,
+                cmd, sizeof(cmd) - 1, value, sizeof(value));
+}
+
+static void bench_wire_readbuf(struct bench_data *d, unsigned long n)
+{
+    uint32_t mask[4];
+
+    while (n--)
+        sink = (uint64_t) iiod_client_read_unlocked(d->client, &d->wire,
+                d->dev, d->samples, d->wire_len, mask, d->words);
+}
+
+static double baseline_find(const struct bench_state *st, const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < st->nb_baseline; i++)
+        if (!strcmp(st->baseline[i].name, name))
+            return st->baseline[i].ns_per_op;
+
+    return 0.0;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Finds a number of calls taking about time_ms / BENCH_RUNS, then times
+ * BENCH_RUNS batches of it. Prints the median time per operation, 'ops'
+ * being the number of operations done by one call.
+ */
+static void bench_run(struct bench_state *st, const char *name,
+        const char *variant, bench_fn fn, struct bench_data *d,
+        unsigned long ops)
+{
+    uint64_t batch_ns = (uint64_t) st->time_ms * 1000000ULL / BENCH_RUNS;
+    double runs[BENCH_RUNS], ns_per_op, base;
+    char full[MAX_NAME];
+    unsigned long n = 1;
+    unsigned int i;
+
+    if (variant)
+        iio_snprintf(full, sizeof(full), "%s/%s", name, variant);
+    else
+        iio_snprintf(full, sizeof(full), "%s", name);
+
+    if (st->filter && !strstr(full, st->filter))
+        return;
+
+    /* Warms up the caches, and sizes the batches */
+    for (;;) {
+        uint64_t start = bench_now_ns(), elapsed;
+
+        fn(d, n);
+        elapsed = bench_now_ns() - start;
+        if (elapsed >= batch_ns / 4 || n >= (1UL << 30))
+            break;
+
+        n *= elapsed ? (unsigned long) (batch_ns / elapsed) / 2 + 2 : 16;
+    }
+
+    for (i = 0; i < BENCH_RUNS; i++) {
+        uint64_t start = bench_now_ns();
+
+        fn(d, n);
+        runs[i] = (double) (bench_now_ns() - start) / ((double) n * ops);
+    }
+
+    qsort(runs, BENCH_RUNS, sizeof(*runs), compare_doubles);
+    ns_per_op = runs[BENCH_RUNS / 2];
+
+    printf("{\"name\":\"%s\",\"ns_per_op\":%.3f,\"min_ns_per_op\":%.3f,"
+            "\"ops\":%lu", full, ns_per_op, runs[0], n * ops * BENCH_RUNS);
+    if (d->bytes_per_op > 0.0)
+        printf(",\"bytes_per_op\":%.2f", d->bytes_per_op);
+    printf("}\n");
+    fflush(stdout);
+
+    base = baseline_find(st, full);
+    if (base > 0.0 && ns_per_op > base * st->ratio) {
+        fprintf(stderr, "%s: %.3f ns/op, %.3f ns/op in the baseline\n",
+                full, ns_per_op, base);
+        st->regressions++;
+    }
+}
+
+/* Creates a context from the XML, whose buffers are served by bench_ops */
+static struct iio_context * bench_create_context(struct bench_xml *xml)
+{
+    struct iio_context *ctx = xml_create_context_mem(xml->buf, xml->len);
+
+    if (!ctx)
+        return NULL;
+
+    if (!bench_ops.read) {
+        bench_ops = *ctx->ops;
+        bench_ops.open = bench_open;
+        bench_ops.close = bench_close;
+        bench_ops.read = bench_read_samples;
+    }
+
+    ctx->ops = &bench_ops;
+    return ctx;
+}
+
+static int bench_format(struct bench_state *st, const char *format)
+{
+    struct bench_xml xml = { NULL, 0, 0 };
+    struct bench_data *d;
+    unsigned int i, nb_channels;
+    int ret;
+
+    d = calloc(1, sizeof(*d));
+    if (!d)
+        return -ENOMEM;
+
+    ret = xml_generate(&xml, 1, 3, format);
+    if (ret < 0)
+        goto out_free;
+
+    d->ctx = bench_create_context(&xml);
+    if (!d->ctx) {
+        ret = -errno;
+        goto out_free;
+    }
+
+    d->dev = iio_context_get_device(d->ctx, 0);
+    nb_channels = iio_device_get_channels_count(d->dev);
+    for (i = 0; i < nb_channels; i++) {
+        iio_channel_enable(iio_device_get_channel(d->dev, i));
+        d->mask[i / 32] |= 1u << (i % 32);
+    }
+    d->words = (nb_channels + 31) / 32;
+    d->chn = iio_device_find_channel(d->dev, "anglvel0", false);
+
+    d->buf = iio_device_create_buffer(d->dev, BENCH_SAMPLES, false);
+    if (!d->buf) {
+        ret = -errno;
+        goto out_destroy_ctx;
+    }
+
+    ret = (int) iio_buffer_refill(d->buf);
+    if (ret < 0)
+        goto out_destroy_buffer;
+    ret = 0;
+
+    /* The input of the inverse conversion */
+    iio_channel_read(d->chn, d->buf, d->converted, sizeof(d->converted));
+
+    bench_run(st, "iio_channel_convert", format,
+            bench_convert, d, BENCH_SAMPLES);
+    bench_run(st, "iio_channel_convert_inverse", format,
+            bench_convert_inverse, d, BENCH_SAMPLES);
+    bench_run(st, "iio_channel_read", format, bench_read, d, BENCH_SAMPLES);
+    bench_run(st, "iio_channel_read_raw", format,
+            bench_read_raw, d, BENCH_SAMPLES);
+    bench_run(st, "iio_buffer_foreach_sample", format,
+            bench_foreach_sample, d, BENCH_SAMPLES * nb_channels);
+    bench_run(st, "iio_buffer_first", format, bench_first, d, 1);
+    bench_run(st, "iio_device_get_sample_size_mask", format,
+            bench_sample_size_mask, d, 1);
+
+out_destroy_buffer:
+    iio_buffer_destroy(d->buf);
+out_destroy_ctx:
+    iio_context_destroy(d->ctx);
+out_free:
+    free(xml.buf);
+    free(d);
+    return ret;
+}
+
+static int bench_xml_context(struct bench_state *st,
+        unsigned int nb_devices, const char *variant)
+{
+    struct bench_xml xml = { NULL, 0, 0 };
+    struct bench_data *d;
+    int ret;
+
+    d = calloc(1, sizeof(*d));
+    if (!d)
+        return -ENOMEM;
+
+    ret = xml_generate(&xml, nb_devices, LARGE_CHANNELS, "le:s16/16>>0");
+    if (ret < 0)
+        goto out_free;
+
+    d->xml = xml.buf;
+    d->xml_len = xml.len;
+
+    bench_run(st, "xml_create_context_mem", variant, bench_xml, d, 1);
+
+out_free:
+    free(xml.buf);
+    free(d);
+    return ret;
+}
+
+static int bench_lookups(struct bench_state *st)
+{
+    struct bench_xml xml = { NULL, 0, 0 };
+    struct bench_data *d;
+    int ret;
+
+    d = calloc(1, sizeof(*d));
+    if (!d)
+        return -ENOMEM;
+
+    ret = xml_generate(&xml, LARGE_DEVICES, LARGE_CHANNELS, "le:s16/16>>0");
+    if (ret < 0)
+        goto out_free;
+
+    d->ctx = xml_create_context_mem(xml.buf, xml.len);
+    if (!d->ctx) {
+        ret = -errno;
+        goto out_free;
+    }
+
+    d->dev = iio_context_find_device(d->ctx, LARGE_LAST_DEVICE);
+    d->chn = d->dev ? iio_device_find_channel(d->dev,
+            LARGE_LAST_CHANNEL, false) : NULL;
+    if (!d->chn) {
+        ret = -ENODEV;
+        goto out_destroy_ctx;
+    }
+
+    bench_run(st, "iio_context_find_device", "id",
+            bench_find_device_by_id, d, 1);
+    bench_run(st, "iio_context_find_device", "name",
+            bench_find_device_by_name, d, 1);
+    bench_run(st, "iio_context_find_device", "missing",
+            bench_find_device_missing, d, 1);
+    bench_run(st, "iio_device_find_channel", NULL, bench_find_channel, d, 1);
+    bench_run(st, "linear_find_device", "id",
+            bench_linear_device_by_id, d, 1);
+    bench_run(st, "linear_find_device", "name",
+            bench_linear_device_by_name, d, 1);
+    bench_run(st, "linear_find_device", "missing",
+            bench_linear_device_missing, d, 1);
+    bench_run(st, "linear_find_channel", NULL, bench_linear_channel, d, 1);
+    bench_run(st, "iio_channel_find_attr", NULL,
+            bench_find_channel_attr, d, 1);
+    bench_run(st, "iio_device_find_attr", NULL, bench_find_device_attr, d, 1);
+
+out_destroy_ctx:
+    iio_context_destroy(d->ctx);
+out_free:
+    free(xml.buf);
+    free(d);
+    return ret;
+}
+
+/* The replies of iiod to a poll of an attribute and to READBUF, as parsed
+ * by the iiod client in each framing */
+static int bench_wire(struct bench_state *st, bool binary)
+{
+    const char *variant = binary ? "binary" : "text";
+    struct bench_xml xml = { NULL, 0, 0 };
+    struct iio_mutex *lock;
+    struct bench_data *d;
+    unsigned int i;
+    int ret;
+
+    d = calloc(1, sizeof(*d));
+    if (!d)
+        return -ENOMEM;
+
+    lock = iio_mutex_create();
+    if (!lock) {
+        ret = -ENOMEM;
+        goto out_free;
+    }
+
+    d->client = iiod_client_new(NULL, lock, &wire_ops);
+    if (!d->client) {
+        ret = -errno;
+        goto out_destroy_lock;
+    }
+
+    ret = xml_generate(&xml, 1, 3, "le:s16/16>>0");
+    if (ret < 0)
+        goto out_destroy_client;
+
+    d->ctx = xml_create_context_mem(xml.buf, xml.len);
+    if (!d->ctx) {
+        ret = -errno;
+        goto out_destroy_client;
+    }
+
+    d->dev = iio_context_get_device(d->ctx, 0);
+    for (i = 0; i < iio_device_get_channels_count(d->dev); i++)
+        iio_channel_enable(iio_device_get_channel(d->dev, i));
+    d->words = 1;
+    d->wire_len = WIRE_SAMPLES * (size_t) iio_device_get_sample_size(d->dev);
+
+    ret = wire_attr_reply(&d->wire, binary);
+    if (ret < 0)
+        goto out_destroy_ctx;
+
+    d->bytes_per_op = (double) d->wire.len;
+    bench_run(st, "iiod_client_read_attr_cmd", variant,
+            bench_wire_read_attr, d, 1);
+    free(d->wire.reply);
+
+    ret = wire_readbuf_reply(&d->wire, binary,
+            (1u << iio_device_get_channels_count(d->dev)) - 1,
+            d->wire_len);
+    if (ret < 0)
+        goto out_destroy_ctx;
+
+    d->bytes_per_op = (double) d->wire.len / WIRE_SAMPLES;
+    bench_run(st, "iiod_client_read_unlocked", variant,
+            bench_wire_readbuf, d, WIRE_SAMPLES);
+    free(d->wire.reply);
+
+out_destroy_ctx:
+    iio_context_destroy(d->ctx);
+out_destroy_client:
+    iiod_client_destroy(d->client);
+out_destroy_lock:
+    iio_mutex_destroy(lock);
+out_free:
+    free(xml.buf);
+    free(d);
+    return ret;
+}
+
+/* Reads the name and the time per operation of each line of a previous run */
+static int load_baseline(struct bench_state *st, const char *path)
+{
+    char line[512];
+    FILE *f = fopen(path, "re");
+
+    if (!f)
+        return -errno;
+
+    st->baseline = calloc(MAX_BASELINE, sizeof(*st->baseline));
+    if (!st->baseline) {
+        fclose(f);
+        return -ENOMEM;
+    }
+
+    while (st->nb_baseline < MAX_BASELINE && fgets(line, sizeof(line), f)) {
+        struct baseline_entry *e = &st->baseline[st->nb_baseline];
+        const char *ns = strstr(line, "\"ns_per_op\":");
+
+        if (ns && sscanf(line, "{\"name\":\"%127[^\"]\"", e->name) == 1 &&
+                sscanf(ns, "\"ns_per_op\":%lf", &e->ns_per_op) == 1)
+            st->nb_baseline++;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-t ms] [-f filter] [-b baseline] [-r ratio]\n"
+            "\t-t  time spent on each case (default: %u ms)\n"
+            "\t-f  only the cases whose name contains this string\n"
+            "\t-b  results of a previous run to compare with\n"
+            "\t-r  slowdown reported as a regression (default: %.2f)\n",
+            name, DEFAULT_TIME_MS, DEFAULT_RATIO);
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_state st = {
+        .time_ms = DEFAULT_TIME_MS,
+        .ratio = DEFAULT_RATIO,
+    };
+    const char *baseline = NULL;
+    unsigned int i;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "t:f:b:r:h")) != -1) {
+        switch (opt) {
+        case 't':
+            st.time_ms = (unsigned int) strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            st.filter = optarg;
+            break;
+        case 'b':
+            baseline = optarg;
+            break;
+        case 'r':
+            st.ratio = strtod(optarg, NULL);
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (baseline) {
+        ret = load_baseline(&st, baseline);
+        if (ret < 0) {
+            fprintf(stderr, "Unable to read %s: %s\n",
+                    baseline, strerror(-ret));
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (i = 0; i < ARRAY_SIZE(formats); i++) {
+        ret = bench_format(&st, formats[i]);
+        if (ret < 0)
+            goto err_print;
+    }
+
+    ret = bench_xml_context(&st, 1, "small");
+    if (ret < 0)
+        goto err_print;
+
+    ret = bench_xml_context(&st, LARGE_DEVICES, "large");
+    if (ret < 0)
+        goto err_print;
+
+    ret = bench_lookups(&st);
+    if (ret < 0)
+        goto err_print;
+
+    ret = bench_wire(&st, false);
+    if (ret < 0)
+        goto err_print;
+
+    ret = bench_wire(&st, true);
+    if (ret < 0)
+        goto err_print;
+
+    free(st.baseline);
+    return st.regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+
+err_print:
+    fprintf(stderr, "Unable to set up the benchmark: %s\n", strerror(-ret));
+    free(st.baseline);
+    return EXIT_FAILURE;
+}
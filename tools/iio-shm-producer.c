@@ -0,0 +1,223 @@
+/*
+ * iio-shm-producer - Reference producer for the shm: backend
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+/*
+ * Lays out a shared memory region as described in shm-ring.h, with one
+ * accelerometer streaming through a ring, and appends samples to it at a
+ * fixed period. The samples follow a pattern that lets a consumer detect
+ * torn or missing ones:
+ *   accel_x = n, accel_y = -n, accel_z = n ^ SHM_PRODUCER_PATTERN
+ * where n is the index of the sample, and timestamp is CLOCK_MONOTONIC.
+ */
+
+#include "shm-ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SHM_PRODUCER_PATTERN 0x5a5a5a5a
+
+#define DEFAULT_NB_SAMPLES 4096
+#define DEFAULT_PERIOD_US 1000
+
+#define XML_OFFSET 4096
+#define RINGS_OFFSET 512
+#define DATA_OFFSET 16384
+
+struct shm_producer_sample {
+    int32_t x, y, z, pad;
+    int64_t timestamp;
+};
+
+static const char xml[] = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+"<!DOCTYPE context ["
+"<!ELEMENT context (device | context-attribute)*>"
+"<!ELEMENT context-attribute EMPTY>"
+"<!ELEMENT device (channel | attribute | debug-attribute | buffer-attribute)*>"
+"<!ELEMENT channel (scan-element?, attribute*)>"
+"<!ELEMENT attribute EMPTY>"
+"<!ELEMENT scan-element EMPTY>"
+"<!ELEMENT debug-attribute EMPTY>"
+"<!ELEMENT buffer-attribute EMPTY>"
+"<!ATTLIST context name CDATA #REQUIRED description CDATA #IMPLIED>"
+"<!ATTLIST context-attribute name CDATA #REQUIRED value CDATA #REQUIRED>"
+"<!ATTLIST device id CDATA #REQUIRED name CDATA #IMPLIED>"
+"<!ATTLIST channel id CDATA #REQUIRED type (input|output) #REQUIRED name CDATA #IMPLIED>"
+"<!ATTLIST scan-element index CDATA #REQUIRED format CDATA #REQUIRED scale CDATA #IMPLIED>"
+"<!ATTLIST attribute name CDATA #REQUIRED filename CDATA #IMPLIED>"
+"<!ATTLIST debug-attribute name CDATA #REQUIRED>"
+"<!ATTLIST buffer-attribute name CDATA #REQUIRED>"
+"]>"
+"<context name=\"shm\" >"
+"<device id=\"iio:device0\" name=\"accel_3d\" >"
+"<channel id=\"accel_x\" type=\"input\" >"
+"<scan-element index=\"0\" format=\"le:s32/32&gt;&gt;0\" /></channel>"
+"<channel id=\"accel_y\" type=\"input\" >"
+"<scan-element index=\"1\" format=\"le:s32/32&gt;&gt;0\" /></channel>"
+"<channel id=\"accel_z\" type=\"input\" >"
+"<scan-element index=\"2\" format=\"le:s32/32&gt;&gt;0\" /></channel>"
+"<channel id=\"timestamp\" type=\"input\" >"
+"<scan-element index=\"3\" format=\"le:s64/64&gt;&gt;0\" /></channel>"
+"</device></context>";
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-s ring_samples] [-n count] "
+            "[-p period_us] [-d delay_ms] <path>\n"
+            "Writes count samples (0: forever) to the region at path, "
+            "one every period_us,\nstarting delay_ms after the region "
+            "is laid out.\n", name);
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000000LL * ts.tv_sec + ts.tv_nsec;
+}
+
+static void sleep_until(int64_t deadline_ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t) (deadline_ns / 1000000000LL);
+    ts.tv_nsec = (long) (deadline_ns % 1000000000LL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+            EINTR);
+}
+
+/* The magic number is written last, once the region is consistent */
+static void * shm_producer_layout(const char *path, uint32_t nb_samples,
+        size_t *size)
+{
+    struct shm_ring_header *hdr;
+    struct shm_ring *ring;
+    void *base;
+    int fd;
+
+    *size = DATA_OFFSET +
+        (size_t) nb_samples * sizeof(struct shm_producer_sample);
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return NULL;
+
+    if (ftruncate(fd, (off_t) *size) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    base = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    memcpy((char *) base + XML_OFFSET, xml, sizeof(xml) - 1);
+
+    ring = (struct shm_ring *) ((char *) base + RINGS_OFFSET);
+    strncpy(ring->device_id, "iio:device0", SHM_RING_ID_LEN);
+    ring->sample_size = sizeof(struct shm_producer_sample);
+    ring->nb_samples = nb_samples;
+    ring->mask[0] = 0xf;
+    ring->data_offset = DATA_OFFSET;
+
+    hdr = base;
+    hdr->version = SHM_RING_VERSION;
+    hdr->nb_rings = 1;
+    hdr->xml_len = sizeof(xml) - 1;
+    hdr->xml_offset = XML_OFFSET;
+    hdr->rings_offset = RINGS_OFFSET;
+    __atomic_store_n(&hdr->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+
+    return base;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long nb_samples = DEFAULT_NB_SAMPLES, period_us =
+        DEFAULT_PERIOD_US, delay_ms = 0;
+    unsigned long long count = 0, n;
+    struct shm_ring *ring;
+    int64_t deadline;
+    size_t size;
+    void *base;
+    int c;
+
+    while ((c = getopt(argc, argv, "s:n:p:d:h")) != -1) {
+        switch (c) {
+        case 's':
+            nb_samples = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            count = strtoull(optarg, NULL, 0);
+            break;
+        case 'p':
+            period_us = strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            delay_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+            return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc - 1 || !nb_samples || nb_samples > UINT32_MAX) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    base = shm_producer_layout(argv[optind], (uint32_t) nb_samples, &size);
+    if (!base) {
+        perror("Unable to lay out the region");
+        return EXIT_FAILURE;
+    }
+
+    ring = (struct shm_ring *) ((char *) base + RINGS_OFFSET);
+    deadline = now_ns() + delay_ms * 1000000LL;
+
+    for (n = 0; !count || n < count; n++) {
+        struct shm_producer_sample sample;
+
+        sleep_until(deadline);
+        deadline += period_us * 1000LL;
+
+        sample.x = (int32_t) n;
+        sample.y = (int32_t) -n;
+        sample.z = (int32_t) (n ^ SHM_PRODUCER_PATTERN);
+        sample.pad = 0;
+        sample.timestamp = now_ns();
+
+        shm_ring_write(base, ring, &sample, 1);
+    }
+
+    printf("%llu samples, %llu overruns\n", count,
+            (unsigned long long) ring->overruns);
+
+    munmap(base, size);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,1124 @@
+/*
+ * iiod-standin - Local stand-in of the IIO Daemon, for benchmarks
+ *
+ * Copyright (C) 2020 Intel Corporation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+/*
+ * Serves a context over the text protocol of iiod, on a unix socket or on
+ * a TCP port of the loopback interface. The context comes from any URI the
+ * library opens: "synth:" generates the sensor values and samples, and a
+ * context without attributes or buffers, e.g. "xml:file", gets synthetic
+ * values from a counter. Each client gets its own clone of the context.
+ *
+ * Every reply is held back by the round-trip time and a random jitter, in
+ * the order of the requests: pipelined requests overlap as they would on a
+ * real link. A script can change the link over time, one command per line:
+ *
+ *   <ms> rtt <us>      round-trip time from then on
+ *   <ms> jitter <us>   jitter, uniform in [0, us), from then on
+ *   <ms> hold <ms>     no reply for that long
+ *   <ms> drop          disconnect all the clients
+ *
+ * where <ms> is the time since the start. Lines starting with '#' are
+ * ignored.
+ *
+ * BINARY, COMPRESS and SUBSCRIBE are supported. Compressed blocks use the
+ * delta filter over the sample size when that makes them smaller.
+ */
+
+#include "compress.h"
+#include "iio.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_URI "synth:accel_3d@0,gyro_3d@0,magn_3d@0"
+#define DEFAULT_PORT 30431
+
+#define MAX_LINE 1024
+#define MAX_SCRIPT_LINES 256
+
+/* Length and mask of a block, for up to 512 channels */
+#define BLOCK_HEADER_MAX (16 + 8 * 16)
+
+struct standin_reply {
+    struct standin_reply *next;
+    uint64_t due_ns;
+    size_t len;
+    char data[];
+};
+
+struct standin_client {
+    struct standin_client *next;
+    int fd;
+    struct iio_context *ctx;
+    pthread_t reader, sender, pusher;
+    bool pushing, closing;
+
+    /* Integers sent as 32-bit words, and no \n after payloads */
+    bool binary;
+
+    /* Payloads of PRINT and READBUF sent as frames */
+    bool compressed;
+
+    /* Replies waiting for their due time, in order */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct standin_reply *head, *tail;
+    uint64_t last_due_ns;
+    uint64_t seed;
+
+    /* Received data not yet parsed */
+    char rx[MAX_LINE * 4];
+    size_t rx_start, rx_end;
+
+    /* Buffers opened with OPEN, one per device */
+    struct iio_buffer **buffers;
+    uint64_t counter;
+
+    /* Subscription */
+    struct iio_device *push_dev;
+    size_t push_len;
+    unsigned int push_period_us;
+};
+
+struct standin_event {
+    uint64_t at_ms;
+    char cmd[16];
+    unsigned long arg;
+};
+
+static struct iio_context *backing;
+static const char *xml;
+static size_t xml_len;
+
+static unsigned int rtt_us, jitter_us;
+static uint64_t hold_until_ns;
+static uint64_t start_ns;
+
+static pthread_mutex_t clients_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct standin_client *clients;
+
+static volatile sig_atomic_t stop;
+
+static struct standin_event events[MAX_SCRIPT_LINES];
+static unsigned int nb_events;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000000ULL * ts.tv_sec + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline_ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t) (deadline_ns / 1000000000ULL);
+    ts.tv_nsec = (long) (deadline_ns % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+            EINTR && !stop);
+}
+
+static ssize_t write_all(int fd, const char *src, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t ret = send(fd, src + done, len - done, MSG_NOSIGNAL);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        done += (size_t) ret;
+    }
+
+    return (ssize_t) done;
+}
+
+/* xorshift64*, one generator per client */
+static unsigned int client_random(struct standin_client *c, unsigned int n)
+{
+    c->seed ^= c->seed >> 12;
+    c->seed ^= c->seed << 25;
+    c->seed ^= c->seed >> 27;
+    return n ? (unsigned int) ((c->seed * 2685821657736338717ULL) >> 33) % n
+        : 0;
+}
+
+/*
+ * Sends a reply once the round-trip time and the jitter have elapsed, and
+ * after the replies before it. Without any delay, it is sent right away.
+ */
+static int client_reply(struct standin_client *c, const void *data,
+        size_t len)
+{
+    unsigned int rtt = __atomic_load_n(&rtt_us, __ATOMIC_RELAXED);
+    unsigned int jitter = __atomic_load_n(&jitter_us, __ATOMIC_RELAXED);
+    uint64_t hold = __atomic_load_n(&hold_until_ns, __ATOMIC_RELAXED);
+    struct standin_reply *reply;
+    uint64_t now = now_ns(), due;
+    int ret = 0;
+
+    pthread_mutex_lock(&c->lock);
+
+    due = now + 1000ULL * (rtt + client_random(c, jitter));
+    if (due < hold)
+        due = hold;
+    if (due < c->last_due_ns)
+        due = c->last_due_ns;
+    c->last_due_ns = due;
+
+    if (due <= now && !c->head) {
+        ret = (int) write_all(c->fd, data, len);
+        pthread_mutex_unlock(&c->lock);
+        return ret < 0 ? ret : 0;
+    }
+
+    reply = malloc(sizeof(*reply) + len);
+    if (!reply) {
+        pthread_mutex_unlock(&c->lock);
+        return -ENOMEM;
+    }
+
+    reply->next = NULL;
+    reply->due_ns = due;
+    reply->len = len;
+    memcpy(reply->data, data, len);
+
+    if (c->tail)
+        c->tail->next = reply;
+    else
+        c->head = reply;
+    c->tail = reply;
+
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+    return 0;
+}
+
+/* Formats a return code or a length, in the framing of the client */
+static size_t format_int(const struct standin_client *c, char *dst,
+        int32_t value)
+{
+    uint32_t word = (uint32_t) value;
+
+    if (!c->binary)
+        return (size_t) sprintf(dst, "%" PRIi32 "\n", value);
+
+    dst[0] = (char) word;
+    dst[1] = (char) (word >> 8);
+    dst[2] = (char) (word >> 16);
+    dst[3] = (char) (word >> 24);
+    return 4;
+}
+
+static int client_reply_int(struct standin_client *c, int value)
+{
+    char buf[16];
+
+    return client_reply(c, buf, format_int(c, buf, value));
+}
+
+static void * client_sender(void *d)
+{
+    struct standin_client *c = d;
+
+    pthread_mutex_lock(&c->lock);
+    while (!c->closing) {
+        struct standin_reply *reply = c->head;
+
+        if (!reply) {
+            pthread_cond_wait(&c->cond, &c->lock);
+            continue;
+        }
+
+        if (reply->due_ns > now_ns()) {
+            pthread_mutex_unlock(&c->lock);
+            sleep_until(reply->due_ns);
+            pthread_mutex_lock(&c->lock);
+            continue;
+        }
+
+        /* Sent under the lock, so that nothing overtakes it */
+        write_all(c->fd, reply->data, reply->len);
+
+        c->head = reply->next;
+        if (!c->head)
+            c->tail = NULL;
+        free(reply);
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    return NULL;
+}
+
+/* Returns a line without its end, or NULL once the peer is gone */
+static char * client_read_line(struct standin_client *c)
+{
+    for (;;) {
+        char *start = c->rx + c->rx_start;
+        char *eol = memchr(start, '\n', c->rx_end - c->rx_start);
+        ssize_t ret;
+
+        if (eol) {
+            c->rx_start += (size_t) (eol - start) + 1;
+            if (eol > start && eol[-1] == '\r')
+                eol--;
+            *eol = '\0';
+            return start;
+        }
+
+        if (c->rx_start) {
+            memmove(c->rx, start, c->rx_end - c->rx_start);
+            c->rx_end -= c->rx_start;
+            c->rx_start = 0;
+        }
+
+        if (c->rx_end == sizeof(c->rx) - 1)
+            return NULL;
+
+        ret = recv(c->fd, c->rx + c->rx_end, sizeof(c->rx) - 1 - c->rx_end,
+                0);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return NULL;
+        c->rx_end += (size_t) ret;
+    }
+}
+
+/* Reads the payload of a WRITE, which follows its command line */
+static int client_read_raw(struct standin_client *c, char *dst, size_t len)
+{
+    while (len) {
+        size_t avail = c->rx_end - c->rx_start;
+        ssize_t ret;
+
+        if (avail) {
+            size_t n = avail < len ? avail : len;
+
+            if (dst) {
+                memcpy(dst, c->rx + c->rx_start, n);
+                dst += n;
+            }
+            c->rx_start += n;
+            len -= n;
+            continue;
+        }
+
+        c->rx_start = c->rx_end = 0;
+        ret = recv(c->fd, c->rx, sizeof(c->rx) - 1, 0);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return -EPIPE;
+        c->rx_end = (size_t) ret;
+    }
+
+    return 0;
+}
+
+static int split(char *line, char **argv, int max)
+{
+    int argc = 0;
+    char *saveptr, *tok;
+
+    for (tok = strtok_r(line, " ", &saveptr); tok && argc < max;
+            tok = strtok_r(NULL, " ", &saveptr))
+        argv[argc++] = tok;
+
+    return argc;
+}
+
+static int device_index(const struct iio_context *ctx,
+        const struct iio_device *dev)
+{
+    unsigned int i;
+
+    for (i = 0; i < iio_context_get_devices_count(ctx); i++)
+        if (iio_context_get_device(ctx, i) == dev)
+            return (int) i;
+
+    return -1;
+}
+
+static unsigned int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return (unsigned int) (c - '0');
+    if (c >= 'a' && c <= 'f')
+        return (unsigned int) (c - 'a' + 10);
+    if (c >= 'A' && c <= 'F')
+        return (unsigned int) (c - 'A' + 10);
+    return 0;
+}
+
+/* Parses "[INPUT|OUTPUT chn|DEBUG|BUFFER] attr" */
+static int parse_attr(struct iio_device *dev, int argc, char **argv,
+        struct iio_channel **chn, const char **attr, char *type)
+{
+    *chn = NULL;
+    *type = 'd';
+
+    if (argc == 1) {
+        *attr = argv[0];
+        return 0;
+    }
+
+    if (argc == 2 && (!strcmp(argv[0], "DEBUG") ||
+                !strcmp(argv[0], "BUFFER"))) {
+        *type = argv[0][0] == 'D' ? 'g' : 'b';
+        *attr = argv[1];
+        return 0;
+    }
+
+    if (argc == 3 && (!strcmp(argv[0], "INPUT") ||
+                !strcmp(argv[0], "OUTPUT"))) {
+        *chn = iio_device_find_channel(dev, argv[1], argv[0][0] == 'O');
+        *attr = argv[2];
+        return *chn ? 0 : -ENODEV;
+    }
+
+    return -EINVAL;
+}
+
+static int handle_read(struct standin_client *c, struct iio_device *dev,
+        int argc, char **argv)
+{
+    struct iio_channel *chn;
+    const char *attr;
+    char value[MAX_LINE], reply[MAX_LINE + 32];
+    ssize_t ret;
+    size_t len;
+    char type;
+
+    ret = parse_attr(dev, argc, argv, &chn, &attr, &type);
+    if (ret < 0)
+        return client_reply_int(c, (int) ret);
+
+    if (chn)
+        ret = iio_channel_attr_read(chn, attr, value, sizeof(value));
+    else if (type == 'g')
+        ret = iio_device_debug_attr_read(dev, attr, value, sizeof(value));
+    else if (type == 'b')
+        ret = iio_device_buffer_attr_read(dev, attr, value, sizeof(value));
+    else
+        ret = iio_device_attr_read(dev, attr, value, sizeof(value));
+
+    /* Without a value from the context, make one up */
+    if (ret < 0)
+        snprintf(value, sizeof(value), "%.3f",
+                (double) (c->counter++ % 2000) / 100.0 - 10.0);
+
+    len = format_int(c, reply, (int32_t) strlen(value) + 1);
+    memcpy(reply + len, value, strlen(value) + 1);
+    len += strlen(value) + 1;
+    if (!c->binary)
+        reply[len++] = '\n';
+
+    return client_reply(c, reply, len);
+}
+
+static int handle_write(struct standin_client *c, struct iio_device *dev,
+        int argc, char **argv)
+{
+    struct iio_channel *chn;
+    const char *attr;
+    unsigned long len;
+    char *value;
+    ssize_t ret;
+    char type;
+
+    if (argc < 2)
+        return client_reply_int(c, -EINVAL);
+
+    len = strtoul(argv[argc - 1], NULL, 10);
+    value = malloc(len + 1);
+    if (!value)
+        return -ENOMEM;
+
+    ret = client_read_raw(c, value, len);
+    if (ret < 0) {
+        free(value);
+        return (int) ret;
+    }
+    value[len] = '\0';
+
+    ret = parse_attr(dev, argc - 1, argv, &chn, &attr, &type);
+    if (!ret) {
+        if (chn)
+            ret = iio_channel_attr_write(chn, attr, value);
+        else if (type == 'g')
+            ret = iio_device_debug_attr_write(dev, attr, value);
+        else if (type == 'b')
+            ret = iio_device_buffer_attr_write(dev, attr, value);
+        else
+            ret = iio_device_attr_write(dev, attr, value);
+
+        /* The attributes without a backing store accept anything */
+        if (ret < 0)
+            ret = (ssize_t) len;
+    }
+
+    free(value);
+    return client_reply_int(c, (int) ret);
+}
+
+static int handle_open(struct standin_client *c, struct iio_device *dev,
+        int argc, char **argv)
+{
+    unsigned int i, nb = iio_device_get_channels_count(dev);
+    int index = device_index(c->ctx, dev);
+    unsigned long samples;
+    size_t mask_len;
+
+    if (argc < 2)
+        return client_reply_int(c, -EINVAL);
+
+    samples = strtoul(argv[0], NULL, 10);
+    mask_len = strlen(argv[1]);
+
+    if (c->buffers[index]) {
+        iio_buffer_destroy(c->buffers[index]);
+        c->buffers[index] = NULL;
+    }
+
+    /* The mask is in hexadecimal, last word first */
+    for (i = 0; i < nb; i++) {
+        struct iio_channel *chn = iio_device_get_channel(dev, i);
+        size_t digit = i / 4;
+        unsigned int nibble = 0;
+
+        if (digit < mask_len)
+            nibble = hex_digit(argv[1][mask_len - 1 - digit]);
+
+        if (nibble & (1u << (i % 4)))
+            iio_channel_enable(chn);
+        else
+            iio_channel_disable(chn);
+    }
+
+    /* Without buffer support in the context, samples are made up */
+    c->buffers[index] = iio_device_create_buffer(dev, samples, false);
+    return client_reply_int(c, 0);
+}
+
+/*
+ * Formats the header of a block of samples: length and mask. The words of
+ * the mask are in hexadecimal, last word first, on one line; or 32-bit
+ * words, first word first, in binary.
+ */
+static size_t block_header(const struct standin_client *c,
+        struct iio_device *dev, char *dst, size_t len)
+{
+    unsigned int i, nb = iio_device_get_channels_count(dev);
+    unsigned int words = (nb + 31) / 32;
+    size_t pos = format_int(c, dst, (int32_t) len);
+
+    for (i = 0; i < words; i++) {
+        unsigned int j, index = c->binary ? i : words - 1 - i;
+        uint32_t word = 0;
+
+        for (j = index * 32; j < nb && j < (index + 1) * 32; j++)
+            if (iio_channel_is_enabled(iio_device_get_channel(dev, j)))
+                word |= 1u << (j % 32);
+
+        if (c->binary)
+            pos += format_int(c, dst + pos, (int32_t) word);
+        else
+            pos += (size_t) sprintf(dst + pos, "%08" PRIx32, word);
+    }
+
+    if (!c->binary)
+        dst[pos++] = '\n';
+    return pos;
+}
+
+/* Fills a block of samples from the buffer of the device */
+static int fill_block(struct standin_client *c, struct iio_device *dev,
+        char *dst, size_t len)
+{
+    struct iio_buffer *buf = c->buffers[device_index(c->ctx, dev)];
+    size_t done = 0;
+
+    while (buf && done < len) {
+        ssize_t ret = iio_buffer_refill(buf);
+        size_t n;
+
+        if (ret <= 0)
+            break;
+
+        n = (size_t) ret < len - done ? (size_t) ret : len - done;
+        memcpy(dst + done, iio_buffer_start(buf), n);
+        done += n;
+    }
+
+    for (; done < len; done++)
+        dst[done] = (char) (c->counter++ * 7);
+
+    return 0;
+}
+
+/* Encodes a block as a frame, with the delta filter if it does better */
+static ssize_t compress_block(struct iio_device *dev, const char *src,
+        size_t len, char *dst)
+{
+    ssize_t sample_size = iio_device_get_sample_size(dev), ret;
+    char *delta;
+
+    ret = iio_frame_encode(src, len, dst, IIO_FRAME_MAX_LEN(len), 0);
+    if (ret < 0 || sample_size <= 0)
+        return ret;
+
+    delta = malloc(IIO_FRAME_MAX_LEN(len));
+    if (!delta)
+        return ret;
+
+    sample_size = iio_frame_encode(src, len, delta, IIO_FRAME_MAX_LEN(len),
+            (size_t) sample_size);
+    if (sample_size > 0 && sample_size < ret) {
+        memcpy(dst, delta, (size_t) sample_size);
+        ret = sample_size;
+    }
+
+    free(delta);
+    return ret;
+}
+
+static int send_block(struct standin_client *c, struct iio_device *dev,
+        size_t len)
+{
+    char *block = malloc(BLOCK_HEADER_MAX + len), *frame = NULL, *payload;
+    char hdr[BLOCK_HEADER_MAX];
+    ssize_t wire_len = (ssize_t) len;
+    size_t hdr_len;
+    int ret;
+
+    if (!block)
+        return -ENOMEM;
+
+    payload = block + BLOCK_HEADER_MAX;
+    ret = fill_block(c, dev, payload, len);
+    if (ret)
+        goto out_free;
+
+    if (c->compressed) {
+        frame = malloc(BLOCK_HEADER_MAX + IIO_FRAME_MAX_LEN(len));
+        if (!frame) {
+            ret = -ENOMEM;
+            goto out_free;
+        }
+
+        wire_len = compress_block(dev, payload, len,
+                frame + BLOCK_HEADER_MAX);
+        if (wire_len < 0) {
+            ret = (int) wire_len;
+            goto out_free;
+        }
+        payload = frame + BLOCK_HEADER_MAX;
+    }
+
+    /* The header announces the payload as sent, and goes right before it */
+    hdr_len = block_header(c, dev, hdr, (size_t) wire_len);
+    memcpy(payload - hdr_len, hdr, hdr_len);
+    ret = client_reply(c, payload - hdr_len, hdr_len + (size_t) wire_len);
+
+out_free:
+    free(frame);
+    free(block);
+    return ret;
+}
+
+static void * client_pusher(void *d)
+{
+    struct standin_client *c = d;
+    uint64_t next = now_ns();
+
+    while (!__atomic_load_n(&c->closing, __ATOMIC_ACQUIRE) && !stop) {
+        if (send_block(c, c->push_dev, c->push_len) < 0)
+            break;
+
+        next += 1000ULL * c->push_period_us;
+        sleep_until(next);
+    }
+
+    return NULL;
+}
+
+static int handle_command(struct standin_client *c, char *line)
+{
+    char *argv[16];
+    struct iio_device *dev = NULL;
+    int argc = split(line, argv, 16);
+
+    if (!argc)
+        return 0;
+
+    if (!strcmp(argv[0], "EXIT"))
+        return -EPIPE;
+    if (!strcmp(argv[0], "VERSION"))
+        return client_reply(c, "0.18.standin\n", 13);
+    if (!strcmp(argv[0], "TIMEOUT"))
+        return client_reply_int(c, 0);
+    if (!strcmp(argv[0], "PRINT")) {
+        char *reply = malloc(IIO_FRAME_MAX_LEN(xml_len) + 32);
+        char payload[16];
+        ssize_t wire_len = (ssize_t) xml_len;
+        size_t len;
+        int ret;
+
+        if (!reply)
+            return -ENOMEM;
+
+        /* The length goes first: encode the frame past the longest one */
+        if (c->compressed) {
+            wire_len = iio_frame_encode(xml, xml_len, reply + 16,
+                    IIO_FRAME_MAX_LEN(xml_len), 0);
+            if (wire_len < 0) {
+                free(reply);
+                return (int) wire_len;
+            }
+        } else {
+            memcpy(reply + 16, xml, xml_len);
+        }
+
+        len = format_int(c, payload, (int32_t) wire_len);
+        memcpy(reply + 16 - len, payload, len);
+        if (!c->binary)
+            reply[16 + wire_len] = '\n';
+        ret = client_reply(c, reply + 16 - len,
+                len + (size_t) wire_len + !c->binary);
+        free(reply);
+        return ret;
+    }
+    if (!strcmp(argv[0], "BINARY")) {
+        /* The reply itself is still in text */
+        int ret = client_reply_int(c, 0);
+
+        c->binary = true;
+        return ret;
+    }
+    if (!strcmp(argv[0], "COMPRESS")) {
+        c->compressed = true;
+        return client_reply_int(c, 0);
+    }
+
+    if (argc > 1)
+        dev = iio_context_find_device(c->ctx, argv[1]);
+
+    if (!strcmp(argv[0], "WRITE")) {
+        if (!dev) {
+            /* The payload must be consumed all the same */
+            client_read_raw(c, NULL, strtoul(argv[argc - 1], NULL, 10));
+            return client_reply_int(c, -ENODEV);
+        }
+        return handle_write(c, dev, argc - 2, argv + 2);
+    }
+
+    if (!dev)
+        return client_reply_int(c, argc > 1 ? -ENODEV : -EINVAL);
+
+    if (!strcmp(argv[0], "READ"))
+        return handle_read(c, dev, argc - 2, argv + 2);
+    if (!strcmp(argv[0], "OPEN"))
+        return handle_open(c, dev, argc - 2, argv + 2);
+    if (!strcmp(argv[0], "CLOSE")) {
+        int index = device_index(c->ctx, dev);
+
+        if (c->buffers[index]) {
+            iio_buffer_destroy(c->buffers[index]);
+            c->buffers[index] = NULL;
+        }
+        return client_reply_int(c, 0);
+    }
+    if (!strcmp(argv[0], "READBUF") && argc == 3)
+        return send_block(c, dev, strtoul(argv[2], NULL, 10));
+    if (!strcmp(argv[0], "SUBSCRIBE") && argc == 4 && !c->pushing) {
+        int ret;
+
+        c->push_dev = dev;
+        c->push_len = strtoul(argv[2], NULL, 10);
+        c->push_period_us = (unsigned int) strtoul(argv[3], NULL, 10);
+
+        ret = client_reply_int(c, 0);
+        if (!ret && !pthread_create(&c->pusher, NULL, client_pusher, c))
+            c->pushing = true;
+        return ret;
+    }
+    if (!strcmp(argv[0], "SET"))
+        return client_reply_int(c, 0);
+
+    /* GETTRIG, SETTRIG... */
+    return client_reply_int(c, -EINVAL);
+}
+
+static void client_free(struct standin_client *c)
+{
+    struct standin_reply *reply, *next;
+    unsigned int i;
+
+    pthread_mutex_lock(&c->lock);
+    __atomic_store_n(&c->closing, true, __ATOMIC_RELEASE);
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+
+    pthread_join(c->sender, NULL);
+    if (c->pushing)
+        pthread_join(c->pusher, NULL);
+
+    for (reply = c->head; reply; reply = next) {
+        next = reply->next;
+        free(reply);
+    }
+
+    for (i = 0; i < iio_context_get_devices_count(c->ctx); i++)
+        if (c->buffers[i])
+            iio_buffer_destroy(c->buffers[i]);
+
+    free(c->buffers);
+    iio_context_destroy(c->ctx);
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->lock);
+    close(c->fd);
+    free(c);
+}
+
+static void * client_reader(void *d)
+{
+    struct standin_client *c = d, **ptr;
+    char *line;
+
+    while (!stop && (line = client_read_line(c)) != NULL)
+        if (handle_command(c, line) < 0)
+            break;
+
+    pthread_mutex_lock(&clients_lock);
+    for (ptr = &clients; *ptr; ptr = &(*ptr)->next) {
+        if (*ptr == c) {
+            *ptr = c->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&clients_lock);
+
+    client_free(c);
+    return NULL;
+}
+
+static int client_new(int fd)
+{
+    struct standin_client *c = calloc(1, sizeof(*c));
+    int ret = -ENOMEM;
+
+    if (!c)
+        goto err_close;
+
+    c->fd = fd;
+    c->seed = now_ns() | 1;
+    c->ctx = iio_context_clone(backing);
+    if (!c->ctx) {
+        ret = -errno;
+        goto err_free;
+    }
+
+    c->buffers = calloc(iio_context_get_devices_count(c->ctx),
+            sizeof(*c->buffers));
+    if (!c->buffers)
+        goto err_destroy_ctx;
+
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->cond, NULL);
+
+    ret = -pthread_create(&c->sender, NULL, client_sender, c);
+    if (ret)
+        goto err_destroy_lock;
+
+    pthread_mutex_lock(&clients_lock);
+    c->next = clients;
+    clients = c;
+
+    ret = -pthread_create(&c->reader, NULL, client_reader, c);
+    if (ret) {
+        clients = c->next;
+        pthread_mutex_unlock(&clients_lock);
+        client_free(c);
+        return ret;
+    }
+
+    pthread_detach(c->reader);
+    pthread_mutex_unlock(&clients_lock);
+    return 0;
+
+err_destroy_lock:
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->lock);
+    free(c->buffers);
+err_destroy_ctx:
+    iio_context_destroy(c->ctx);
+err_free:
+    free(c);
+err_close:
+    close(fd);
+    return ret;
+}
+
+static int parse_script(const char *path)
+{
+    char line[MAX_LINE];
+    FILE *f = fopen(path, "re");
+
+    if (!f)
+        return -errno;
+
+    while (fgets(line, sizeof(line), f) && nb_events < MAX_SCRIPT_LINES) {
+        struct standin_event *ev = &events[nb_events];
+        int n;
+
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        ev->arg = 0;
+        n = sscanf(line, "%" SCNu64 " %15s %lu", &ev->at_ms, ev->cmd,
+                &ev->arg);
+        if (n < 2) {
+            fclose(f);
+            return -EINVAL;
+        }
+
+        nb_events++;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static void * script_run(__notused void *d)
+{
+    unsigned int i;
+
+    for (i = 0; i < nb_events && !stop; i++) {
+        const struct standin_event *ev = &events[i];
+        struct standin_client *c;
+
+        sleep_until(start_ns + ev->at_ms * 1000000ULL);
+
+        if (!strcmp(ev->cmd, "rtt")) {
+            __atomic_store_n(&rtt_us, (unsigned int) ev->arg,
+                    __ATOMIC_RELAXED);
+        } else if (!strcmp(ev->cmd, "jitter")) {
+            __atomic_store_n(&jitter_us, (unsigned int) ev->arg,
+                    __ATOMIC_RELAXED);
+        } else if (!strcmp(ev->cmd, "hold")) {
+            __atomic_store_n(&hold_until_ns,
+                    now_ns() + ev->arg * 1000000ULL, __ATOMIC_RELAXED);
+        } else if (!strcmp(ev->cmd, "drop")) {
+            pthread_mutex_lock(&clients_lock);
+            for (c = clients; c; c = c->next)
+                shutdown(c->fd, SHUT_RDWR);
+            pthread_mutex_unlock(&clients_lock);
+        } else {
+            fprintf(stderr, "Unknown script command: %s\n", ev->cmd);
+        }
+    }
+
+    return NULL;
+}
+
+static int listen_on(const char *unix_path, unsigned int port)
+{
+    int fd, ret, yes = 1;
+
+    if (unix_path) {
+        struct sockaddr_un sun;
+
+        memset(&sun, 0, sizeof(sun));
+        sun.sun_family = AF_UNIX;
+        if (strlen(unix_path) >= sizeof(sun.sun_path))
+            return -ENAMETOOLONG;
+        strcpy(sun.sun_path, unix_path);
+        unlink(unix_path);
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -errno;
+        ret = bind(fd, (struct sockaddr *) &sun, sizeof(sun));
+    } else {
+        struct sockaddr_in sin;
+
+        memset(&sin, 0, sizeof(sin));
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons((uint16_t) port);
+        sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -errno;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        ret = bind(fd, (struct sockaddr *) &sin, sizeof(sin));
+    }
+
+    if (ret < 0 || listen(fd, 128) < 0) {
+        ret = -errno;
+        close(fd);
+        return ret;
+    }
+
+    return fd;
+}
+
+static void on_signal(__notused int sig)
+{
+    stop = 1;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-u uri] [-U socket | -p port] [-r rtt_us] "
+            "[-j jitter_us] [-s script] [-t seconds]\n"
+            "Serves the context of uri (default \"%s\") like iiod, on "
+            "the unix socket\nor on the TCP port of 127.0.0.1 (default "
+            "%u), for that many seconds.\n", name, DEFAULT_URI,
+            DEFAULT_PORT);
+}
+
+int main(int argc, char **argv)
+{
+    const char *uri = DEFAULT_URI, *unix_path = NULL, *script = NULL;
+    unsigned int port = DEFAULT_PORT, seconds = 0;
+    struct sigaction sa;
+    pthread_t script_thread;
+    int fd, opt, ret;
+
+    while ((opt = getopt(argc, argv, "u:U:p:r:j:s:t:h")) != -1) {
+        switch (opt) {
+        case 'u':
+            uri = optarg;
+            break;
+        case 'U':
+            unix_path = optarg;
+            break;
+        case 'p':
+            port = (unsigned int) strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            rtt_us = (unsigned int) strtoul(optarg, NULL, 10);
+            break;
+        case 'j':
+            jitter_us = (unsigned int) strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            script = optarg;
+            break;
+        case 't':
+            seconds = (unsigned int) strtoul(optarg, NULL, 10);
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (script) {
+        ret = parse_script(script);
+        if (ret < 0) {
+            fprintf(stderr, "Unable to read %s: %s\n", script,
+                    strerror(-ret));
+            return EXIT_FAILURE;
+        }
+    }
+
+    backing = iio_create_context_from_uri(uri);
+    if (!backing) {
+        perror("Unable to create the context");
+        return EXIT_FAILURE;
+    }
+
+    xml = iio_context_get_xml(backing);
+    if (!xml) {
+        perror("Unable to get the XML of the context");
+        iio_context_destroy(backing);
+        return EXIT_FAILURE;
+    }
+    xml_len = strlen(xml);
+
+    fd = listen_on(unix_path, port);
+    if (fd < 0) {
+        fprintf(stderr, "Unable to listen: %s\n", strerror(-fd));
+        iio_context_destroy(backing);
+        return EXIT_FAILURE;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGALRM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    if (seconds)
+        alarm(seconds);
+
+    start_ns = now_ns();
+    if (nb_events && !pthread_create(&script_thread, NULL, script_run, NULL))
+        pthread_detach(script_thread);
+
+    if (unix_path)
+        fprintf(stderr, "Serving %s on unix:%s\n", uri, unix_path);
+    else
+        fprintf(stderr, "Serving %s on ip:127.0.0.1:%u\n", uri, port);
+
+    while (!stop) {
+        int client = accept(fd, NULL, NULL);
+
+        if (client < 0)
+            continue;
+
+        if (!unix_path) {
+            int yes = 1;
+
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        }
+
+        ret = client_new(client);
+        if (ret < 0)
+            fprintf(stderr, "Unable to serve a client: %s\n",
+                    strerror(-ret));
+    }
+
+    close(fd);
+    if (unix_path)
+        unlink(unix_path);
+
+    /* The clients still connected are not waited for */
+    return EXIT_SUCCESS;
+}